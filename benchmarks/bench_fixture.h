@@ -0,0 +1,64 @@
+#pragma once
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Plist.h"
+#include "Symbol.h"
+#include "logging.h"
+#include "spdlog/spdlog.h"
+
+// The batch target shared by the micro benchmarks: a large plist and the IDs received for it
+namespace fyber::bench {
+
+namespace fs = std::filesystem;
+using fyber::Symbol;
+using std::map;
+using std::string;
+using std::vector;
+
+/// A plist with many SKAdNetwork IDs already
+inline fs::path target_plist()
+{
+  return fs::path(SKAD_RESOURCES_DIR) / "full.Info.plist";
+}
+
+/// IDs of existing networks, some of them new, and of a network the plist doesn't have yet
+inline map<Symbol, vector<Symbol>> target_ids()
+{
+  const map<string, vector<string>> catalog = {
+      {"AdColony", {"4PFYVQ9L8R.skadnetwork", "YCLNXRL5PM.skadnetwork"}},
+      {"ChartboostSDK", {"blskdfjl2e3.skadnetwork"}},
+      {"Google-Mobile-Ads-SDK", {"cstr6suwn9.skadnetwork"}},
+      {"Synthetic", {"new1.skadnetwork", "new2.skadnetwork", "new3.skadnetwork", "new4.skadnetwork"}}};
+
+  map<Symbol, vector<Symbol>> received;
+  for (const auto& [network, ids] : catalog) {
+    auto& symbols = received[Symbol(network)];
+    for (const auto& id : ids) symbols.emplace_back(id);
+  }
+  return received;
+}
+
+/// Parse, diff and serialize [plist_path] once, as a single target of a batch run would
+/// \param logged whether to log what a run of `skad_updater` logs meanwhile
+inline void process_target(const fs::path& plist_path, const map<Symbol, vector<Symbol>>& received, bool logged)
+{
+  Plist plist(plist_path.string());
+  if (logged) spdlog::info("Existing SKAdNetworks: {}", plist.existing_sk_ad_network_items_str());
+
+  plist.set_sk_ad_network_items_for_update(received);
+  if (logged) {
+    spdlog::info("New SKAdNetworks: {}", plist.new_sk_ad_network_items_str());
+    spdlog::info("Updating `{}`", plist.file_path());
+  }
+
+  const auto& content = plist.build_plist_SKAdNetworkItems();
+  if (logged) {
+    SKAD_DEBUG("Printing modified `{}`", plist.file_path());
+    SKAD_DEBUG(content);
+  }
+}
+
+}  // namespace fyber::bench
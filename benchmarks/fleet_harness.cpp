@@ -0,0 +1,348 @@
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cxxopts.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MockServer.h"
+
+extern char** environ;
+
+namespace fyber::bench {
+
+namespace fs = std::filesystem;
+using std::string;
+using std::vector;
+using Metrics = std::map<string, double>;
+
+/// A single skad_updater invocation and the resources it consumed
+struct RunResult
+{
+  int exit_code = -1;
+  double wall_ms = 0;
+  double cpu_ms = 0;
+  long max_rss_kb = 0;
+  long syscalls = 0;
+};
+
+/// Deterministic synthetic catalog: `Network<k>SDK` -> [`n<k>id<j>.skadnetwork`, ...]
+vector<std::pair<string, vector<string>>> make_catalog(int networks)
+{
+  vector<std::pair<string, vector<string>>> catalog;
+  std::mt19937 rng(42);
+
+  for (int k = 0; k < networks; ++k) {
+    vector<string> ids;
+    int count = 1 + static_cast<int>(rng() % 8);
+    for (int j = 0; j < count; ++j) ids.push_back("n" + std::to_string(k) + "id" + std::to_string(j) + ".skadnetwork");
+    catalog.emplace_back("Network" + std::to_string(k) + "SDK", ids);
+  }
+  return catalog;
+}
+
+string catalog_to_json(const vector<std::pair<string, vector<string>>>& catalog)
+{
+  std::stringstream json;
+  json << "{";
+  for (size_t k = 0; k < catalog.size(); ++k) {
+    json << (k ? "," : "") << "\"" << catalog[k].first << "\":[";
+    for (size_t j = 0; j < catalog[k].second.size(); ++j)
+      json << (j ? "," : "") << "\"" << catalog[k].second[j] << "\"";
+    json << "]";
+  }
+  json << "}";
+  return json.str();
+}
+
+/// Generate a plist with typical application keys and a subset of the catalog's IDs already present
+void write_plist(const fs::path& path, const vector<std::pair<string, vector<string>>>& catalog, std::mt19937& rng)
+{
+  std::ofstream plist(path);
+  plist << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+           "<!DOCTYPE plist PUBLIC \"-//Apple//DTD PLIST 1.0//EN\" "
+           "\"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n"
+           "<plist version=\"1.0\">\n<dict>\n";
+
+  for (int key = 0; key < 40; ++key) {
+    plist << "\t<key>CFBundleSyntheticKey" << key << "</key>\n\t<string>$(SYNTHETIC_VALUE_" << key << ")</string>\n";
+  }
+  plist << "\t<key>UISupportedInterfaceOrientations</key>\n\t<array>\n"
+           "\t\t<string>UIInterfaceOrientationPortrait</string>\n"
+           "\t\t<string>UIInterfaceOrientationLandscapeLeft</string>\n\t</array>\n";
+
+  plist << "\t<key>SKAdNetworkItems</key>\n\t<array>\n";
+  for (const auto& [network, ids] : catalog) {
+    if (rng() % 2) continue;
+    for (const auto& id : ids) {
+      plist << "\t\t<dict>\n\t\t\t<key>SKAdNetworkIdentifier</key>\n\t\t\t<string>" << id << "</string>\n\t\t</dict>\n";
+    }
+  }
+  plist << "\t</array>\n</dict>\n</plist>\n";
+}
+
+/// Generate a Podfile with helper `def` blocks, several targets and a mix of catalog and unrelated pods
+void write_podfile(const fs::path& path, const vector<std::pair<string, vector<string>>>& catalog, std::mt19937& rng)
+{
+  std::ofstream podfile(path);
+  podfile << "source 'https://github.com/CocoaPods/Specs.git'\nplatform :ios, '12.0'\n\ndef mediation_sdks\n";
+
+  for (const auto& [network, ids] : catalog) {
+    if (rng() % 3 == 0) podfile << "  pod '" << network << "', '" << rng() % 10 << "." << rng() % 10 << ".0'\n";
+  }
+  podfile << "end\n\ndef tools\n";
+  for (int pod = 0; pod < 20; ++pod) podfile << "  pod 'SyntheticTool" << pod << "', '1.0." << pod << "'\n";
+  podfile << "end\n\n";
+
+  for (const char* target : {"App Dev", "App Prod", "App Tests"}) {
+    podfile << "target '" << target << "' do\n  use_frameworks!\n  mediation_sdks\n  tools\nend\n\n";
+  }
+}
+
+/// Generate [apps] synthetic applications under [root]
+vector<fs::path> generate_repository(const fs::path& root, int apps,
+                                     const vector<std::pair<string, vector<string>>>& catalog)
+{
+  fs::remove_all(root);
+
+  vector<fs::path> app_dirs;
+  for (int app = 0; app < apps; ++app) {
+    std::mt19937 rng(app);
+    fs::path dir = root / ("App" + std::to_string(app));
+    fs::create_directories(dir);
+    write_plist(dir / "Info.plist", catalog, rng);
+    write_podfile(dir / "Podfile", catalog, rng);
+    app_dirs.push_back(dir);
+  }
+  return app_dirs;
+}
+
+/// Parse the total number of calls from an `strace -c` summary
+long parse_strace_total(const fs::path& summary)
+{
+  std::ifstream in(summary);
+  string line;
+  long total = 0;
+  while (std::getline(in, line)) {
+    if (line.find("total") == string::npos) continue;
+    std::stringstream columns(line);
+    string percent, seconds, usecs, calls;
+    columns >> percent >> seconds >> usecs >> calls;
+    total = std::atol(calls.c_str());
+  }
+  return total;
+}
+
+RunResult run_updater(const string& binary, const fs::path& app_dir, const string& server_url, bool count_syscalls)
+{
+  const fs::path strace_out = app_dir / "strace.txt";
+  vector<string> args;
+  if (count_syscalls) args = {"strace", "-f", "-c", "-o", strace_out.string()};
+  args.insert(args.end(), {binary, "--plist_file_path", (app_dir / "Info.plist").string(), "--pod_file_path",
+                           (app_dir / "Podfile").string()});
+
+  vector<char*> argv;
+  for (auto& arg : args) argv.push_back(arg.data());
+  argv.push_back(nullptr);
+
+  vector<string> env_storage = {"FYBER_SKAD_NETWORKS_SERVER_HOST=" + server_url};
+  for (char** env = environ; *env != nullptr; ++env) env_storage.emplace_back(*env);
+  vector<char*> envp;
+  for (auto& env : env_storage) envp.push_back(env.data());
+  envp.push_back(nullptr);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+  posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+  RunResult result;
+  auto start = std::chrono::steady_clock::now();
+
+  pid_t pid;
+  int spawned = count_syscalls ? posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), envp.data())
+                               : posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), envp.data());
+  posix_spawn_file_actions_destroy(&actions);
+  if (spawned != 0) return result;
+
+  int status = 0;
+  rusage usage{};
+  wait4(pid, &status, 0, &usage);
+
+  result.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  result.exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+  result.cpu_ms = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 +
+                  (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+#ifdef __APPLE__
+  result.max_rss_kb = usage.ru_maxrss / 1024;
+#else
+  result.max_rss_kb = usage.ru_maxrss;
+#endif
+  if (count_syscalls) result.syscalls = parse_strace_total(strace_out);
+
+  return result;
+}
+
+double percentile(vector<double> values, double p)
+{
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1, static_cast<size_t>(p * static_cast<double>(values.size())))];
+}
+
+/// \return the metrics of [path], or nothing if it can't be read, is malformed or is empty
+std::optional<Metrics> read_metrics(const fs::path& path)
+{
+  std::ifstream in(path);
+  if (!in.is_open()) return std::nullopt;
+
+  Metrics metrics;
+  string name;
+  double value;
+  while (in >> name >> value) metrics[name] = value;
+
+  if (!in.eof() or metrics.empty()) return std::nullopt;
+  return metrics;
+}
+
+void write_metrics(const fs::path& path, const Metrics& metrics)
+{
+  std::ofstream out(path);
+  for (const auto& [name, value] : metrics) out << name << " " << std::fixed << std::setprecision(3) << value << "\n";
+}
+
+/// Compare [current] against [baseline]. Every metric is "lower is better".
+/// \return the number of metrics that regressed by more than [threshold_pct] percent, or that are missing from
+/// [current]
+int compare_to_baseline(const Metrics& current, const Metrics& baseline, double threshold_pct)
+{
+  int regressions = 0;
+  for (const auto& [name, base] : baseline) {
+    auto found = current.find(name);
+    if (found == current.end()) {
+      std::cout << std::left << std::setw(18) << name << std::right << std::setw(14) << base << " -> " << std::setw(14)
+                << "-"
+                << "   MISSING\n";
+      regressions++;
+      continue;
+    }
+
+    const double limit = base * (1 + threshold_pct / 100);
+    const bool regressed = found->second > limit and found->second - base > 1e-9;
+    std::cout << std::left << std::setw(18) << name << std::right << std::setw(14) << base << " -> " << std::setw(14)
+              << found->second << (regressed ? "   REGRESSION" : "") << "\n";
+    regressions += regressed ? 1 : 0;
+  }
+  return regressions;
+}
+
+}  // namespace fyber::bench
+
+int main(int argc, char** argv)
+{
+  using namespace fyber::bench;
+
+  cxxopts::Options options("fleet_harness", "Run skad_updater over a synthetic repository of many applications");
+  // clang-format off
+  options.add_options()
+      ("apps", "Number of synthetic applications", cxxopts::value<int>()->default_value("500"))
+      ("networks", "Number of networks in the served catalog", cxxopts::value<int>()->default_value("40"))
+      ("jobs", "Number of concurrent updater processes", cxxopts::value<int>()->default_value("1"))
+      ("workdir", "Where the synthetic repository is generated", cxxopts::value<string>()->default_value("fleet_repo"))
+      ("binary", "The skad_updater binary", cxxopts::value<string>()->default_value(skad_updater_BIN "/skad_updater"))
+      ("baseline", "Baseline metrics file to compare against", cxxopts::value<string>())
+      ("threshold", "Allowed regression in percent", cxxopts::value<double>()->default_value("10"))
+      ("write_baseline", "Write the measured metrics to the baseline file instead of comparing")
+      ("count_syscalls", "Count system calls with `strace -f -c` (Linux only)")
+      ("h,help", "Print usage");
+  // clang-format on
+
+  auto args = options.parse(argc, argv);
+  if (args.count("help")) {
+    std::cout << options.help() << std::endl;
+    return 0;
+  }
+
+  const int apps = args["apps"].as<int>();
+  const int jobs = std::max(1, args["jobs"].as<int>());
+  const bool count_syscalls = args["count_syscalls"].as<bool>();
+
+  auto catalog = make_catalog(args["networks"].as<int>());
+  auto app_dirs = generate_repository(args["workdir"].as<string>(), apps, catalog);
+
+  fyber::test::MockServer server(catalog_to_json(catalog));
+  server.start();
+
+  vector<RunResult> results(app_dirs.size());
+  std::atomic<size_t> next{0};
+  auto start = std::chrono::steady_clock::now();
+
+  vector<std::thread> workers;
+  for (int job = 0; job < jobs; ++job) {
+    workers.emplace_back([&] {
+      for (size_t i = next++; i < app_dirs.size(); i = next++) {
+        results[i] = run_updater(args["binary"].as<string>(), app_dirs[i], server.url(), count_syscalls);
+      }
+    });
+  }
+  for (auto& worker : workers) worker.join();
+
+  const double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  server.stop();
+
+  Metrics metrics;
+  vector<double> latencies;
+  for (const auto& result : results) {
+    metrics["cpu_ms"] += result.cpu_ms;
+    metrics["peak_rss_kb"] = std::max(metrics["peak_rss_kb"], static_cast<double>(result.max_rss_kb));
+    metrics["failed_runs"] += result.exit_code == 0 ? 0 : 1;
+    if (count_syscalls) metrics["syscalls"] += static_cast<double>(result.syscalls);
+    latencies.push_back(result.wall_ms);
+  }
+  metrics["wall_ms"] = wall_ms;
+  metrics["run_p50_ms"] = percentile(latencies, 0.5);
+  metrics["run_p99_ms"] = percentile(latencies, 0.99);
+  metrics["requests"] = static_cast<double>(server.requests());
+
+  std::cout << "Fleet run: " << apps << " apps, " << jobs << " jobs\n";
+  for (const auto& [name, value] : metrics) {
+    std::cout << std::left << std::setw(18) << name << std::right << std::fixed << std::setprecision(3) << std::setw(14)
+              << value << "\n";
+  }
+
+  if (args.count("baseline")) {
+    const string baseline = args["baseline"].as<string>();
+
+    if (args["write_baseline"].as<bool>()) {
+      write_metrics(baseline, metrics);
+      std::cout << "Baseline written to " << baseline << std::endl;
+    } else {
+      auto baseline_metrics = read_metrics(baseline);
+      if (!baseline_metrics.has_value()) {
+        std::cerr << "Baseline " << baseline << " is missing, unreadable or has no metrics" << std::endl;
+        return 3;
+      }
+
+      std::cout << "\nComparing with " << baseline << " (threshold " << args["threshold"].as<double>() << "%)\n";
+      if (compare_to_baseline(metrics, baseline_metrics.value(), args["threshold"].as<double>()) > 0) return 1;
+    }
+  }
+
+  return metrics["failed_runs"] > 0 ? 2 : 0;
+}
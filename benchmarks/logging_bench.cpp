@@ -0,0 +1,64 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+#include "bench_fixture.h"
+#include "logging.h"
+#include "spdlog/async.h"
+#include "spdlog/sinks/null_sink.h"
+#include "spdlog/spdlog.h"
+
+namespace fyber::bench {
+
+/// Microseconds per run with [logger] as the default logger at [level]
+double run(const std::shared_ptr<spdlog::logger>& logger, spdlog::level::level_enum level, const fs::path& plist_path,
+           const map<Symbol, vector<Symbol>>& received, int iterations)
+{
+  spdlog::set_default_logger(logger);
+  spdlog::set_level(level);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) process_target(plist_path, received, true);
+  logger->flush();
+
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+}  // namespace fyber::bench
+
+/// \code logging_bench [iterations]
+int main(int argc, char** argv)
+{
+  using namespace fyber::bench;
+
+  const int iterations = argc > 1 ? std::atoi(argv[1]) : 2000;
+  const fs::path plist_path = target_plist();
+  const auto received = target_ids();
+
+  // Logs are discarded, so only the cost of producing them is measured
+  auto sink = std::make_shared<spdlog::sinks::null_sink_mt>();
+  auto sync_logger = std::make_shared<spdlog::logger>("sync", sink);
+  spdlog::init_thread_pool(fyber::logging::queue_size, 1);
+  auto async_logger = std::make_shared<spdlog::async_logger>("async", sink, spdlog::thread_pool(),
+                                                             spdlog::async_overflow_policy::block);
+
+  std::cout << "Logging cost of updating `" << plist_path.filename().string() << "`, " << iterations
+            << " iterations, debug logs " << (fyber::logging::debug_compiled ? "compiled in" : "stripped") << "\n";
+  std::cout << std::left << std::setw(16) << "logs" << std::right << std::setw(14) << "us/run"
+            << "\n";
+
+  auto print = [](const string& name, double us_per_run) {
+    std::cout << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(1) << std::setw(14)
+              << us_per_run << "\n";
+  };
+
+  print("off", run(sync_logger, spdlog::level::off, plist_path, received, iterations));
+  print("info", run(sync_logger, spdlog::level::info, plist_path, received, iterations));
+  print("debug", run(sync_logger, spdlog::level::debug, plist_path, received, iterations));
+  print("debug async", run(async_logger, spdlog::level::debug, plist_path, received, iterations));
+
+  spdlog::shutdown();
+  return 0;
+}
@@ -0,0 +1,124 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+#include "AllocStats.h"
+#include "Arena.h"
+#include "bench_fixture.h"
+#include "spdlog/spdlog.h"
+
+#ifdef SKAD_ALLOC_STATS
+
+namespace {
+
+// libskad replaces operator new already, its counts include the malloc-level allocations of pugixml and arenas
+size_t new_calls_so_far()
+{
+  return fyber::memory::alloc_stats::total().allocations;
+}
+
+}  // namespace
+
+#else
+
+namespace {
+
+std::atomic<size_t> new_calls{0};
+
+size_t new_calls_so_far()
+{
+  return new_calls;
+}
+
+}  // namespace
+
+void* operator new(size_t size)
+{
+  new_calls++;
+  if (void* ptr = std::malloc(size)) return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+  std::free(ptr);
+}
+
+#endif
+
+namespace fyber::bench {
+
+struct Sample
+{
+  double ns_per_iteration;
+  double new_calls_per_iteration;
+  double pugixml_heap_per_iteration;
+  double pugixml_arena_per_iteration;
+};
+
+Sample run(const fs::path& plist_path, const map<Symbol, vector<Symbol>>& received, int iterations, bool use_arena)
+{
+  memory::Arena arena;
+
+  auto pugixml_before = memory::pugixml_allocations();
+  size_t new_calls_before = new_calls_so_far();
+  auto start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < iterations; ++i) {
+    if (use_arena) {
+      {
+        memory::ArenaScope scope(arena);
+        process_target(plist_path, received, false);
+      }
+      arena.reset();
+    } else {
+      process_target(plist_path, received, false);
+    }
+  }
+
+  auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  auto pugixml_after = memory::pugixml_allocations();
+
+  return Sample{elapsed / iterations, static_cast<double>(new_calls_so_far() - new_calls_before) / iterations,
+                static_cast<double>(pugixml_after.heap - pugixml_before.heap) / iterations,
+                static_cast<double>(pugixml_after.arena - pugixml_before.arena) / iterations};
+}
+
+void print(const string& name, const Sample& sample)
+{
+  std::cout << std::left << std::setw(8) << name << std::right << std::fixed << std::setprecision(1) << std::setw(14)
+            << sample.ns_per_iteration / 1000 << std::setw(14) << sample.new_calls_per_iteration << std::setw(16)
+            << sample.pugixml_heap_per_iteration << std::setw(16) << sample.pugixml_arena_per_iteration << "\n";
+}
+
+}  // namespace fyber::bench
+
+/// \code plist_bench [iterations]
+int main(int argc, char** argv)
+{
+  using namespace fyber::bench;
+
+  spdlog::set_level(spdlog::level::warn);
+
+  const int iterations = argc > 1 ? std::atoi(argv[1]) : 2000;
+  const fs::path plist_path = target_plist();
+  const auto received = target_ids();
+
+  std::cout << "Parse + diff + serialize `" << plist_path.filename().string() << "`, " << iterations << " iterations\n";
+  std::cout << std::left << std::setw(8) << "mode" << std::right << std::setw(14) << "us/iter" << std::setw(14)
+            << "new/iter" << std::setw(16) << "pugi heap/iter" << std::setw(16) << "pugi arena/iter"
+            << "\n";
+
+  print("heap", run(plist_path, received, iterations, false));
+  print("arena", run(plist_path, received, iterations, true));
+
+  return 0;
+}
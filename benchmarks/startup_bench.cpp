@@ -0,0 +1,157 @@
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cxxopts.hpp>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "MockServer.h"
+
+extern char** environ;
+
+namespace fyber::bench {
+
+namespace fs = std::filesystem;
+using std::string;
+using std::vector;
+
+/// A way of starting skad_updater that ends without anything to do, and the median wall time it's allowed
+struct Scenario
+{
+  string name;
+  vector<string> args;
+  double budget_ms;
+};
+
+/// Run [binary] with [args], stdout and stderr discarded
+/// \return the exit code and the wall time of the run, in milliseconds
+std::pair<int, double> run_updater(const string& binary, vector<string> args, const string& server_url)
+{
+  args.insert(args.begin(), binary);
+  vector<char*> argv;
+  for (auto& arg : args) argv.push_back(arg.data());
+  argv.push_back(nullptr);
+
+  vector<string> env_storage = {"FYBER_SKAD_NETWORKS_SERVER_HOST=" + server_url};
+  for (char** env = environ; *env != nullptr; ++env) env_storage.emplace_back(*env);
+  vector<char*> envp;
+  for (auto& env : env_storage) envp.push_back(env.data());
+  envp.push_back(nullptr);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+  posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+  auto start = std::chrono::steady_clock::now();
+
+  pid_t pid;
+  int spawned = posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), envp.data());
+  posix_spawn_file_actions_destroy(&actions);
+  if (spawned != 0) return {-1, 0};
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+
+  const double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  return {WIFEXITED(status) ? WEXITSTATUS(status) : -1, wall_ms};
+}
+
+double percentile(vector<double> values, double p)
+{
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1, static_cast<size_t>(p * static_cast<double>(values.size())))];
+}
+
+}  // namespace fyber::bench
+
+int main(int argc, char** argv)
+{
+  using namespace fyber::bench;
+
+  cxxopts::Options options("startup_bench", "Time the runs of skad_updater that have nothing to do");
+  // clang-format off
+  options.add_options()
+      ("runs", "Number of measured runs of each scenario", cxxopts::value<int>()->default_value("20"))
+      ("workdir", "Where the plists and the cache are written", cxxopts::value<string>()->default_value("startup"))
+      ("binary", "The skad_updater binary", cxxopts::value<string>()->default_value(skad_updater_BIN "/skad_updater"))
+      ("help_budget_ms", "Median allowed to `--help`", cxxopts::value<double>()->default_value("50"))
+      ("offline_budget_ms", "Median allowed to an up to date plist with `--offline`", cxxopts::value<double>()->default_value("100"))
+      ("cached_budget_ms", "Median allowed to an up to date plist with a cached catalog", cxxopts::value<double>()->default_value("100"))
+      ("h,help", "Print usage");
+  // clang-format on
+
+  auto args = options.parse(argc, argv);
+  if (args.count("help")) {
+    std::cout << options.help() << std::endl;
+    return 0;
+  }
+
+  const string binary = args["binary"].as<string>();
+  const int runs = std::max(1, args["runs"].as<int>());
+  const fs::path workdir = args["workdir"].as<string>();
+
+  fs::remove_all(workdir);
+  fs::create_directories(workdir);
+  fs::copy_file(fs::path(SKAD_RESOURCES_DIR) / "Info.plist", workdir / "offline.Info.plist");
+  fs::copy_file(fs::path(SKAD_RESOURCES_DIR) / "Info.plist", workdir / "cached.Info.plist");
+  const string cache_dir = (workdir / "cache").string();
+
+  const vector<Scenario> scenarios = {
+      {"help", {"--help"}, args["help_budget_ms"].as<double>()},
+      {"offline",
+       {"--offline", "--network_list", "Google-Mobile-Ads-SDK", "--plist_file_path",
+        (workdir / "offline.Info.plist").string()},
+       args["offline_budget_ms"].as<double>()},
+      {"cached",
+       {"--cache_dir", cache_dir, "--network_list", "Network0SDK", "--plist_file_path",
+        (workdir / "cached.Info.plist").string()},
+       args["cached_budget_ms"].as<double>()},
+  };
+
+  // The first runs update the plists and fill the cache, later ones have nothing to do
+  fyber::test::MockServer server(R"({"Network0SDK":["n0id0.skadnetwork","n0id1.skadnetwork"]})");
+  server.start();
+  for (const auto& scenario : scenarios) {
+    if (run_updater(binary, scenario.args, server.url()).first != 0) {
+      std::cerr << "Unable to prepare the `" << scenario.name << "` scenario" << std::endl;
+      return 2;
+    }
+  }
+  const string server_url = server.url();
+  server.stop();
+
+  // None of the measured runs may reach the service, it's gone
+  int over_budget = 0;
+  std::cout << std::left << std::setw(10) << "scenario" << std::right << std::setw(10) << "p50_ms" << std::setw(10)
+            << "p90_ms" << std::setw(10) << "budget"
+            << "\n";
+  for (const auto& scenario : scenarios) {
+    vector<double> wall_ms;
+    for (int run = 0; run < runs; ++run) {
+      auto [exit_code, elapsed_ms] = run_updater(binary, scenario.args, server_url);
+      if (exit_code != 0) {
+        std::cerr << "The `" << scenario.name << "` scenario failed with " << exit_code << std::endl;
+        return 2;
+      }
+      wall_ms.push_back(elapsed_ms);
+    }
+
+    const double median = percentile(wall_ms, 0.5);
+    const bool over = median > scenario.budget_ms;
+    std::cout << std::left << std::setw(10) << scenario.name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << median << std::setw(10) << percentile(wall_ms, 0.9) << std::setw(10)
+              << scenario.budget_ms << (over ? "   OVER BUDGET" : "") << "\n";
+    over_budget += over ? 1 : 0;
+  }
+
+  return over_budget > 0 ? 1 : 0;
+}
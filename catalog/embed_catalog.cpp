@@ -0,0 +1,150 @@
+/// Generates the header of the catalog compiled into `skad_updater` from a snapshot of the service. <br/>
+/// The snapshot is a response of `/plist` for every network, e.g. `{"AdColony": ["4pfyvq9l8r.skadnetwork"], ...}`.
+/// The header defines the entries in the order of the snapshot, and a perfect-hash table from network names to
+/// entries, so that lookups need neither parsing nor allocation at runtime.
+///
+/// Usage: embed_catalog <snapshot.json> <header>
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "catalog_hash.h"
+#include "rapidjson/document.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+using Catalog = vector<std::pair<string, vector<string>>>;
+
+Catalog read_snapshot(const string& path)
+{
+  std::ifstream file(path);
+  if (!file.is_open()) throw std::runtime_error("Unable to open the catalog snapshot `" + path + "`");
+
+  std::stringstream content;
+  content << file.rdbuf();
+
+  rapidjson::Document doc;
+  doc.Parse(content.str().c_str());
+  if (doc.HasParseError() or !doc.IsObject()) throw std::runtime_error("Invalid catalog snapshot `" + path + "`");
+
+  Catalog catalog;
+  for (auto& network : doc.GetObject()) {
+    if (!network.value.IsArray()) {
+      throw std::runtime_error("The IDs of `" + string(network.name.GetString()) + "` aren't an array");
+    }
+
+    vector<string> ids;
+    for (auto& id : network.value.GetArray()) ids.emplace_back(id.GetString(), id.GetStringLength());
+    catalog.emplace_back(string(network.name.GetString(), network.name.GetStringLength()), std::move(ids));
+  }
+  return catalog;
+}
+
+/// The slots of a table of [slot_count] slots for [catalog], empty when [seed] makes two names collide
+vector<int32_t> place(const Catalog& catalog, size_t slot_count, uint32_t seed)
+{
+  vector<int32_t> slots(slot_count, -1);
+  for (size_t i = 0; i < catalog.size(); ++i) {
+    auto& slot = slots[fyber::catalog::hash(catalog[i].first, seed) & (slot_count - 1)];
+    if (slot >= 0) return {};
+    slot = static_cast<int32_t>(i);
+  }
+  return slots;
+}
+
+/// [text] as a C++ string literal
+string literal(const string& text)
+{
+  string quoted = "\"";
+  for (char c : text) {
+    if (c == '"' or c == '\\') quoted += '\\';
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+void write_header(const Catalog& catalog, const vector<int32_t>& slots, uint32_t seed, std::ostream& out)
+{
+  out << "// Generated by embed_catalog from the catalog snapshot, do not edit\n"
+         "#pragma once\n"
+         "#include \"catalog_hash.h\"\n\n"
+         "namespace fyber::catalog::embedded {\n\n";
+
+  size_t id_count = 0;
+  for (const auto& [network, ids] : catalog) id_count += ids.size();
+
+  // A zero-sized array isn't valid C++, an unused element is emitted for an empty catalog
+  out << "inline constexpr std::string_view ids[] = {\n";
+  for (const auto& [network, ids] : catalog) {
+    for (const auto& id : ids) out << "    " << literal(id) << ",\n";
+  }
+  if (id_count == 0) out << "    \"\",\n";
+  out << "};\n\n";
+
+  out << "inline constexpr Entry entries[] = {\n";
+  size_t offset = 0;
+  for (const auto& [network, ids] : catalog) {
+    out << "    {" << literal(network) << ", ids + " << offset << ", " << ids.size() << "},\n";
+    offset += ids.size();
+  }
+  if (catalog.empty()) out << "    {\"\", ids, 0},\n";
+  out << "};\n\n";
+
+  out << "inline constexpr size_t entry_count = " << catalog.size() << ";\n\n";
+
+  out << "inline constexpr uint32_t seed = " << seed << "u;\n\n";
+
+  out << "inline constexpr int32_t slots[] = {";
+  for (size_t i = 0; i < slots.size(); ++i) out << (i % 16 == 0 ? "\n    " : " ") << slots[i] << ",";
+  out << "\n};\n\n";
+
+  out << "inline constexpr size_t slot_count = " << (catalog.empty() ? 0 : slots.size()) << ";\n\n"
+      << "}  // namespace fyber::catalog::embedded\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  if (argc != 3) {
+    std::cerr << "Usage: embed_catalog <snapshot.json> <header>" << std::endl;
+    return 1;
+  }
+
+  try {
+    auto catalog = read_snapshot(argv[1]);
+
+    // Twice as many slots as names keeps the search for a seed short, the table is grown if none is found
+    size_t slot_count = 1;
+    while (slot_count < catalog.size() * 2) slot_count *= 2;
+
+    uint32_t seed = 0;
+    vector<int32_t> slots;
+    while ((slots = place(catalog, slot_count, seed)).empty()) {
+      if (++seed == 1u << 20) {
+        seed = 0;
+        slot_count *= 2;
+      }
+    }
+
+    std::ofstream header(argv[2]);
+    if (!header.is_open()) throw std::runtime_error(string("Unable to write `") + argv[2] + "`");
+    write_header(catalog, slots, seed, header);
+
+    std::cout << "Embedded " << catalog.size() << " networks in " << slot_count << " slots (seed " << seed << ")"
+              << std::endl;
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,14 @@
+#!/usr/bin/env bash
+# Pins the catalog compiled into skad_updater to the current response of the service, for every supported network.
+# Usage: catalog/update_snapshot.sh [server-host]
+set -euo pipefail
+
+host="${1:-${FYBER_SKAD_NETWORKS_SERVER_HOST:-https://network-setup.fyber.com}}"
+snapshot="$(dirname "$0")/snapshot.json"
+
+networks=$(curl -fsS "$host/networks" | sed -e 's/.*\[//' -e 's/\].*//' -e 's/[" ]//g')
+
+curl -fsS -G --data-urlencode "network_list=$networks" "$host/plist" >"$snapshot.tmp"
+mv "$snapshot.tmp" "$snapshot"
+
+echo "Pinned $(echo "$networks" | tr ',' '\n' | wc -l | tr -d ' ') networks in $snapshot"
@@ -0,0 +1,525 @@
+#include "Mirror.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <optional>
+
+#include "ManagerApi.h"
+#include "exit_message.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include "spdlog/spdlog.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace fyber::mirror {
+
+namespace {
+
+/// Requests are a request line, a few headers and the network names of a POST, anything longer is dropped
+constexpr size_t max_request_size = 256 * 1024;
+
+string url_decode(std::string_view text)
+{
+  string decoded;
+  decoded.reserve(text.size());
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (text[i] == '%' and i + 2 < text.size() and std::isxdigit(text[i + 1]) and std::isxdigit(text[i + 2])) {
+      decoded += static_cast<char>(std::stoi(string(text.substr(i + 1, 2)), nullptr, 16));
+      i += 2;
+    } else if (text[i] == '+') {
+      decoded += ' ';
+    } else {
+      decoded += text[i];
+    }
+  }
+  return decoded;
+}
+
+/// The value of [key] in a url query string, if any
+std::optional<string> query_param(std::string_view query, std::string_view key)
+{
+  size_t start = 0;
+  while (start <= query.size()) {
+    size_t end = std::min(query.find('&', start), query.size());
+
+    auto pair = query.substr(start, end - start);
+    auto eq = pair.find('=');
+    if (url_decode(pair.substr(0, eq)) == key) {
+      return eq == std::string_view::npos ? "" : url_decode(pair.substr(eq + 1));
+    }
+    start = end + 1;
+  }
+  return std::nullopt;
+}
+
+/// The `Content-Length` of the request [head], 0 when missing
+size_t content_length(const string& head)
+{
+  string lowercase_head = head;
+  std::transform(lowercase_head.begin(), lowercase_head.end(), lowercase_head.begin(),
+                 [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+  auto header = lowercase_head.find("\r\ncontent-length:");
+  if (header == string::npos) return 0;
+
+  size_t length = 0;
+  for (auto i = header + 17; i < lowercase_head.size() and lowercase_head[i] != '\r'; ++i) {
+    if (std::isdigit(static_cast<unsigned char>(lowercase_head[i]))) {
+      // Past the request size limit, the connection is dropped anyway
+      length = std::min(length * 10 + static_cast<size_t>(lowercase_head[i] - '0'), max_request_size + 1);
+    }
+  }
+  return length;
+}
+
+bool set_non_blocking(int fd)
+{
+  int flags = ::fcntl(fd, F_GETFL, 0);
+  return flags >= 0 and ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+}  // namespace
+
+/// A client connection, answered a request at a time
+struct Mirror::Connection
+{
+  int fd;
+  string input;
+  /// The response being sent, if any
+  string head;
+  std::shared_ptr<const string> body;
+  size_t sent = 0;
+  /// Whether the connection is closed once the response is sent
+  bool close = false;
+};
+
+Mirror::Mirror(MirrorOptions options) : _options(std::move(options)) {}
+
+Mirror::~Mirror()
+{
+  stop();
+}
+
+void Mirror::start()
+{
+  if (_running) return;
+
+  refresh();
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(_options.port);
+  if (::inet_pton(AF_INET, _options.bind.c_str(), &addr.sin_addr) != 1) {
+    throw ExitMessage::InvalidArguments("Invalid address to listen on `" + _options.bind + "`");
+  }
+
+  _listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  int reuse = 1;
+  if (_listen_fd < 0 or ::setsockopt(_listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 or
+      ::bind(_listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 or ::listen(_listen_fd, 512) != 0 or
+      !set_non_blocking(_listen_fd)) {
+    const string error = std::strerror(errno);
+    if (_listen_fd >= 0) ::close(_listen_fd);
+    _listen_fd = -1;
+    throw ExitMessage::InvalidArguments("Unable to listen on " + _options.bind + ":" + std::to_string(_options.port) +
+                                        ": " + error);
+  }
+
+  socklen_t len = sizeof(addr);
+  ::getsockname(_listen_fd, reinterpret_cast<sockaddr*>(&addr), &len);
+  _port = ntohs(addr.sin_port);
+
+  _running = true;
+  _loop_thread = std::thread([this] { serve_loop(); });
+  _refresh_thread = std::thread([this] { refresh_loop(); });
+
+  spdlog::info("Mirroring {} on {}:{}", _options.upstream, _options.bind, _port);
+}
+
+void Mirror::stop()
+{
+  {
+    std::lock_guard lock(_mutex);
+    if (!_running.exchange(false)) return;
+  }
+  _refresh_wakeup.notify_all();
+
+  _loop_thread.join();
+  _refresh_thread.join();
+  ::close(_listen_fd);
+  _listen_fd = -1;
+}
+
+string Mirror::url() const
+{
+  return "http://" + (_options.bind == "0.0.0.0" ? string("127.0.0.1") : _options.bind) + ":" + std::to_string(_port);
+}
+
+size_t Mirror::refreshes() const
+{
+  std::lock_guard lock(_mutex);
+  return _refreshes;
+}
+
+std::shared_ptr<Mirror::Snapshot> Mirror::snapshot() const
+{
+  std::lock_guard lock(_mutex);
+  return _snapshot;
+}
+
+void Mirror::refresh()
+{
+  std::lock_guard refreshing(_refresh_mutex);
+  // A fresh client, the responses of the previous one are memoized
+  ManagerApi upstream(_options.upstream);
+
+  vector<std::pair<Symbol, vector<Symbol>>> catalog;
+  try {
+    auto update = upstream.sync_catalog(_upstream_catalog);
+    if (update == CatalogStore::Update::Unchanged and snapshot() != nullptr) {
+      std::lock_guard lock(_mutex);
+      _refreshes++;
+      spdlog::info("The catalog of {} is unchanged at version {}", _options.upstream, _upstream_catalog.version());
+      return;
+    }
+    catalog = _upstream_catalog.entries();
+  } catch (const ExitMessage& failure) {
+    // An upstream without `/catalog`, e.g. another mirror, is fetched whole. Once it has served it, failures are
+    // failures.
+    if (!_upstream_catalog.empty() or (failure.code != ExitMessage::ServerUnavailable("").code and
+                                       failure.code != ExitMessage::InvalidNetworks("").code)) {
+      throw;
+    }
+
+    auto networks = upstream.get_networks();
+    auto sk_ad_networks = upstream.get_sk_ad_networks(networks);
+
+    catalog.reserve(networks.size());
+    for (const auto& network : networks) {
+      auto found = sk_ad_networks.find(network);
+      catalog.emplace_back(network, found == sk_ad_networks.end() ? vector<Symbol>() : found->second);
+    }
+  }
+
+  const size_t network_count = catalog.size();
+  auto previous = snapshot();
+  auto next = build_snapshot(std::move(catalog), previous.get(), _options.max_network_lists);
+
+  std::lock_guard lock(_mutex);
+  _snapshot = std::move(next);
+  _refreshes++;
+  spdlog::info("Mirrored {} networks from {}", network_count, _options.upstream);
+}
+
+void Mirror::refresh_loop()
+{
+  std::unique_lock lock(_mutex);
+  while (_running) {
+    if (_refresh_wakeup.wait_for(lock, _options.refresh_interval, [this] { return !_running; })) break;
+
+    lock.unlock();
+    try {
+      refresh();
+    } catch (const std::exception& ex) {
+      spdlog::warn("Keeping the previous catalog, the refresh failed: {}", ex.what());
+    }
+    lock.lock();
+  }
+}
+
+std::shared_ptr<Mirror::Snapshot> Mirror::build_snapshot(vector<std::pair<Symbol, vector<Symbol>>> catalog,
+                                                         Snapshot* previous, size_t max_network_lists)
+{
+  auto snapshot = std::make_shared<Snapshot>();
+  snapshot->catalog = std::move(catalog);
+
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+  writer.StartObject();
+  writer.Key("networks");
+  writer.StartArray();
+  for (size_t i = 0; i < snapshot->catalog.size(); ++i) {
+    auto network = snapshot->catalog[i].first.view();
+    snapshot->index.emplace(network, i);
+    writer.String(network.data(), static_cast<rapidjson::SizeType>(network.size()));
+  }
+  writer.EndArray();
+  writer.EndObject();
+  snapshot->networks = make_body(buffer.GetString());
+
+  // The combinations requested so far are likely to be requested again, they are ready before the swap
+  if (previous != nullptr) {
+    vector<string> network_lists;
+    {
+      std::lock_guard lock(previous->network_lists_mutex);
+      for (const auto& [network_list, body] : previous->network_lists) network_lists.push_back(network_list);
+    }
+    for (const auto& network_list : network_lists) network_list_body(*snapshot, network_list, max_network_lists);
+  }
+
+  return snapshot;
+}
+
+std::shared_ptr<const Mirror::Body> Mirror::network_list_body(Snapshot& snapshot, const string& network_list,
+                                                              size_t max_network_lists)
+{
+  {
+    std::lock_guard lock(snapshot.network_lists_mutex);
+    auto found = snapshot.network_lists.find(network_list);
+    if (found != snapshot.network_lists.end()) return found->second;
+  }
+
+  auto body = std::make_shared<const Body>(make_body(plist_json(snapshot, network_list)));
+
+  std::lock_guard lock(snapshot.network_lists_mutex);
+  if (snapshot.network_lists.size() < max_network_lists) snapshot.network_lists.emplace(network_list, body);
+  return body;
+}
+
+/// \code {"AdColony": ["4PFYVQ9L8R.skadnetwork", "YCLNXRL5PM.skadnetwork"], "Unknown_network": []}
+string Mirror::plist_json(const Snapshot& snapshot, const string& network_list)
+{
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+  writer.StartObject();
+  size_t start = 0;
+  while (start <= network_list.size()) {
+    size_t end = std::min(network_list.find(',', start), network_list.size());
+    auto network = std::string_view(network_list).substr(start, end - start);
+    start = end + 1;
+
+    writer.Key(network.data(), static_cast<rapidjson::SizeType>(network.size()));
+    writer.StartArray();
+    auto found = snapshot.index.find(network);
+    if (found != snapshot.index.end()) {
+      for (const auto& id : snapshot.catalog[found->second].second) {
+        writer.String(id.c_str(), static_cast<rapidjson::SizeType>(id.view().size()));
+      }
+    }
+    writer.EndArray();
+  }
+  writer.EndObject();
+
+  return buffer.GetString();
+}
+
+Mirror::Body Mirror::make_body(string json)
+{
+  Body body;
+  body.gzip = gzip(json);
+  body.identity = std::move(json);
+  return body;
+}
+
+string Mirror::gzip(std::string_view data)
+{
+  z_stream stream{};
+  // 16 + the window bits, for a gzip header rather than a zlib one
+  if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 16 + 15, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+    throw ExitMessage::Oops("Unable to initialize gzip");
+  }
+
+  string compressed(deflateBound(&stream, static_cast<uLong>(data.size())), '\0');
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.size());
+  stream.next_out = reinterpret_cast<Bytef*>(compressed.data());
+  stream.avail_out = static_cast<uInt>(compressed.size());
+
+  int result = deflate(&stream, Z_FINISH);
+  compressed.resize(stream.total_out);
+  deflateEnd(&stream);
+
+  if (result != Z_STREAM_END) throw ExitMessage::Oops("Unable to gzip a response");
+  return compressed;
+}
+
+//------------------- Event loop -----------------------------------------------
+
+void Mirror::serve_loop()
+{
+  std::unordered_map<int, Connection> connections;
+  vector<pollfd> fds;
+
+  while (_running) {
+    fds.assign(1, pollfd{_listen_fd, POLLIN, 0});
+    for (const auto& [fd, connection] : connections) {
+      fds.push_back(pollfd{fd, static_cast<short>(connection.body ? POLLOUT : POLLIN), 0});
+    }
+
+    // The timeout bounds how long `stop()` waits for the loop
+    if (::poll(fds.data(), fds.size(), 20) <= 0) continue;
+
+    for (size_t i = 1; i < fds.size(); ++i) {
+      if (fds[i].revents == 0) continue;
+
+      auto& connection = connections.at(fds[i].fd);
+      bool open = (fds[i].revents & (POLLERR | POLLNVAL)) == 0 and
+                  ((fds[i].revents & POLLOUT) != 0 ? advance(connection) : receive(connection));
+      if (!open) {
+        ::close(fds[i].fd);
+        connections.erase(fds[i].fd);
+      }
+    }
+
+    if ((fds[0].revents & POLLIN) == 0) continue;
+
+    int fd;
+    while ((fd = ::accept(_listen_fd, nullptr, nullptr)) >= 0) {
+      if (!set_non_blocking(fd)) {
+        ::close(fd);
+        continue;
+      }
+#ifdef SO_NOSIGPIPE
+      int no_sigpipe = 1;
+      ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &no_sigpipe, sizeof(no_sigpipe));
+#endif
+      connections.emplace(fd, Connection{fd});
+    }
+  }
+
+  for (const auto& [fd, connection] : connections) ::close(fd);
+}
+
+bool Mirror::receive(Connection& connection)
+{
+  char buffer[4096];
+  while (true) {
+    ssize_t received = ::recv(connection.fd, buffer, sizeof(buffer), 0);
+    if (received > 0) {
+      connection.input.append(buffer, static_cast<size_t>(received));
+      if (connection.input.size() > max_request_size) return false;
+      continue;
+    }
+    if (received == 0) return false;
+    if (errno == EAGAIN or errno == EWOULDBLOCK) break;
+    if (errno != EINTR) return false;
+  }
+
+  return advance(connection);
+}
+
+bool Mirror::advance(Connection& connection)
+{
+  while (true) {
+    if (connection.body) {
+      if (!send(connection)) return false;
+      if (connection.body) return true;  // the rest once the socket is writable
+      if (connection.close) return false;
+    }
+
+    auto head_end = connection.input.find("\r\n\r\n");
+    if (head_end == string::npos) return true;
+
+    const string head = connection.input.substr(0, head_end);
+    const size_t body_length = content_length(head);
+    if (connection.input.size() < head_end + 4 + body_length) return true;
+
+    respond(connection, head, connection.input.substr(head_end + 4, body_length));
+    connection.input.erase(0, head_end + 4 + body_length);
+  }
+}
+
+bool Mirror::send(Connection& connection)
+{
+  const size_t total = connection.head.size() + connection.body->size();
+
+  while (connection.sent < total) {
+    const bool in_head = connection.sent < connection.head.size();
+    const char* data = in_head ? connection.head.data() + connection.sent
+                               : connection.body->data() + (connection.sent - connection.head.size());
+    const size_t size = in_head ? connection.head.size() - connection.sent : total - connection.sent;
+
+    ssize_t sent = ::send(connection.fd, data, size, MSG_NOSIGNAL);
+    if (sent < 0) return errno == EAGAIN or errno == EWOULDBLOCK or errno == EINTR;
+    connection.sent += static_cast<size_t>(sent);
+  }
+
+  connection.head.clear();
+  connection.body.reset();
+  connection.sent = 0;
+  return true;
+}
+
+void Mirror::respond(Connection& connection, const string& head, const string& request_body)
+{
+  _requests++;
+
+  string lowercase_head = head;
+  std::transform(lowercase_head.begin(), lowercase_head.end(), lowercase_head.begin(),
+                 [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+  const auto request_line = std::string_view(head).substr(0, head.find("\r\n"));
+  const auto method_end = request_line.find(' ');
+  const auto target_end = request_line.find(' ', method_end + 1);
+  const auto method = request_line.substr(0, method_end);
+  const auto target = method_end == std::string_view::npos
+                          ? std::string_view()
+                          : request_line.substr(method_end + 1, target_end - method_end - 1);
+  const auto query_start = target.find('?');
+  const auto path = target.substr(0, query_start);
+  const auto query = query_start == std::string_view::npos ? std::string_view() : target.substr(query_start + 1);
+
+  connection.close = lowercase_head.find("\r\nconnection: close") != string::npos or
+                     (request_line.size() >= 8 and request_line.substr(request_line.size() - 8) == "HTTP/1.0");
+
+  const bool gzip = lowercase_head.find("\r\naccept-encoding:") != string::npos and
+                    lowercase_head.find("gzip", lowercase_head.find("\r\naccept-encoding:")) != string::npos;
+
+  int status = 200;
+  const char* reason = "OK";
+  std::shared_ptr<const Body> body;
+  std::optional<string> network_list;
+
+  auto current = snapshot();
+  if (method == "POST" and path == "/plist") {
+    // The names of the networks, one per line
+    string names = request_body;
+    std::replace(names.begin(), names.end(), '\n', ',');
+    body = network_list_body(*current, names, _options.max_network_lists);
+  } else if (method != "GET") {
+    status = 405;
+    reason = "Method Not Allowed";
+  } else if (path == "/networks") {
+    // Keeps the snapshot alive for as long as the body is sent
+    body = std::shared_ptr<const Body>(current, &current->networks);
+  } else if (path == "/plist" and (network_list = query_param(query, "network_list")).has_value()) {
+    body = network_list_body(*current, network_list.value(), _options.max_network_lists);
+  } else if (path == "/plist") {
+    status = 400;
+    reason = "Bad Request";
+  } else {
+    status = 404;
+    reason = "Not Found";
+  }
+
+  if (body) {
+    connection.body = std::shared_ptr<const string>(body, gzip ? &body->gzip : &body->identity);
+  } else {
+    connection.body = std::make_shared<const string>(reason);
+  }
+
+  connection.head = "HTTP/1.1 " + std::to_string(status) + " " + reason +
+                    "\r\n"
+                    "Content-Type: " +
+                    (body ? "application/json" : "text/plain") +
+                    "\r\nContent-Length: " + std::to_string(connection.body->size()) + "\r\n" +
+                    (body and gzip ? "Content-Encoding: gzip\r\n" : "") + "Vary: Accept-Encoding\r\n" +
+                    (connection.close ? "Connection: close\r\n" : "") + "\r\n";
+  connection.sent = 0;
+}
+
+}  // namespace fyber::mirror
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "CatalogStore.h"
+#include "Symbol.h"
+
+namespace fyber::mirror {
+
+using std::string;
+using std::vector;
+
+/// Options of a `Mirror`
+struct MirrorOptions
+{
+  /// `http://host:port` of the service mirrored
+  string upstream;
+  /// The address listened on, e.g. `0.0.0.0` to serve a LAN
+  string bind = "127.0.0.1";
+  /// The port listened on, an ephemeral one when 0
+  uint16_t port = 0;
+  /// How often the catalog is fetched from [upstream] again
+  std::chrono::seconds refresh_interval{300};
+  /// Number of `network_list` combinations kept serialized, beyond it responses are built for each request
+  size_t max_network_lists = 4096;
+};
+
+/// A caching mirror of the SKAdNetwork manager service, for fleets of `skad_updater` runs. <br/>
+/// The whole catalog is fetched from upstream with `ManagerApi`, and `/networks` and `/plist` (GET, or POST of the
+/// names) are answered from memory: every response body is serialized and gzipped once, then reused until the catalog
+/// is refreshed in the background. Refreshes only receive the changes since the previous one when upstream serves
+/// `/catalog`, and nothing is rebuilt without any. Connections are served by a single thread, on a `poll` event loop.
+class Mirror
+{
+ private:
+  /// A response body, as is and gzipped
+  struct Body
+  {
+    string identity;
+    string gzip;
+  };
+
+  /// A version of the catalog with its serialized responses. Replaced as a whole on refresh, so the responses in
+  /// flight keep the one they were built from.
+  struct Snapshot
+  {
+    vector<std::pair<Symbol, vector<Symbol>>> catalog;
+    std::unordered_map<std::string_view, size_t> index;
+    Body networks;
+    /// `/plist` responses by `network_list`, filled by the event loop and read by the refresh
+    std::mutex network_lists_mutex;
+    std::unordered_map<string, std::shared_ptr<const Body>> network_lists;
+  };
+
+  struct Connection;
+
+  const MirrorOptions _options;
+
+  int _listen_fd = -1;
+  uint16_t _port = 0;
+  std::atomic<bool> _running{false};
+  std::thread _loop_thread;
+  std::thread _refresh_thread;
+  std::condition_variable _refresh_wakeup;
+
+  mutable std::mutex _mutex;
+  std::shared_ptr<Snapshot> _snapshot;
+  size_t _refreshes = 0;
+  std::atomic<size_t> _requests{0};
+
+  /// Serializes the refreshes, which sync `_upstream_catalog`
+  std::mutex _refresh_mutex;
+  /// The catalog of upstream, empty when it doesn't serve `/catalog`
+  CatalogStore _upstream_catalog;
+
+  void serve_loop();
+  void refresh_loop();
+
+  /// Read what's available on [connection], then `advance` it
+  /// \return false when the connection has to be closed
+  bool receive(Connection& connection);
+  /// Send the pending response of [connection] and answer its next buffered requests, until the socket blocks
+  /// \return false when the connection has to be closed
+  bool advance(Connection& connection);
+  /// Send what the socket takes of the response of [connection], which is reset once sent
+  /// \return false on failure
+  static bool send(Connection& connection);
+
+  /// Queue the response to the request [head] and [request_body] on [connection]
+  void respond(Connection& connection, const string& head, const string& request_body);
+
+  [[nodiscard]] std::shared_ptr<Snapshot> snapshot() const;
+
+  /// The snapshot of [catalog], with the `/plist` responses of the `network_list`s requested from [previous]
+  static std::shared_ptr<Snapshot> build_snapshot(vector<std::pair<Symbol, vector<Symbol>>> catalog, Snapshot* previous,
+                                                  size_t max_network_lists);
+  /// The `/plist` response for [network_list], built on the first request
+  static std::shared_ptr<const Body> network_list_body(Snapshot& snapshot, const string& network_list,
+                                                       size_t max_network_lists);
+  static Body make_body(string json);
+  static string plist_json(const Snapshot& snapshot, const string& network_list);
+
+ public:
+  explicit Mirror(MirrorOptions options);
+  ~Mirror();
+
+  Mirror(const Mirror&) = delete;
+  Mirror& operator=(const Mirror&) = delete;
+
+  /// Fetch the catalog, then listen and serve in the background, refreshing the catalog every
+  /// `refresh_interval`. Failed refreshes are logged and the previous catalog is kept.
+  /// \throws ExitMessage if the catalog can't be fetched, InvalidArguments if the address can't be listened on
+  void start();
+
+  /// Stop serving, dropping the open connections
+  void stop();
+
+  /// Fetch the catalog from upstream now, and serve it once fetched
+  /// \throws ExitMessage if it can't be fetched, the current catalog is kept
+  void refresh();
+
+  /// The bound port. Valid after `start()`
+  [[nodiscard]] uint16_t port() const { return _port; }
+
+  /// `http://host:port` of the mirror
+  [[nodiscard]] string url() const;
+
+  /// Number of refreshes from upstream
+  [[nodiscard]] size_t refreshes() const;
+
+  /// Number of requests answered
+  [[nodiscard]] size_t requests() const { return _requests; }
+
+  /// [data] gzipped
+  static string gzip(std::string_view data);
+};
+
+}  // namespace fyber::mirror
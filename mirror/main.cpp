@@ -0,0 +1,74 @@
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "Mirror.h"
+#include "cxxopts.hpp"
+#include "exit_message.h"
+#include "spdlog/spdlog.h"
+
+/// Serve a mirror of the catalog service until interrupted, for the `skad_updater` runs pointed at it with
+/// `FYBER_SKAD_NETWORKS_SERVER_HOST`.
+/// \code skad_mirror [--upstream <url>] [--bind <address>] [--port <port>] [--refresh <seconds>]
+int main(int argc, char** argv)
+{
+  const char* server_host_override = std::getenv("FYBER_SKAD_NETWORKS_SERVER_HOST");
+
+  fyber::mirror::MirrorOptions mirror_options;
+  try {
+    cxxopts::Options options("skad_mirror", "Serve a caching mirror of the SKAdNetwork manager service");
+    // clang-format off
+    options.add_options()
+        ("upstream", "The service mirrored, or a comma-separated list of its endpoints. Defaults to "
+                     "`FYBER_SKAD_NETWORKS_SERVER_HOST` when set",
+                     cxxopts::value<std::string>()->default_value(
+                         server_host_override != nullptr ? server_host_override : "https://network-setup.fyber.com"))
+        ("bind", "The address listened on", cxxopts::value<std::string>()->default_value("0.0.0.0"))
+        ("port", "The port listened on", cxxopts::value<uint16_t>()->default_value("8080"))
+        ("refresh", "How often the catalog is fetched again, in seconds", cxxopts::value<long>()->default_value("300"))
+        ("h,help", "Print usage");
+    // clang-format on
+
+    auto result = options.parse(argc, argv);
+    if (result.count("help") > 0) {
+      std::cout << options.help() << std::endl;
+      return 0;
+    }
+
+    if (result["refresh"].as<long>() <= 0) throw fyber::ExitMessage::InvalidArguments("`refresh` must be positive");
+
+    mirror_options.upstream = result["upstream"].as<std::string>();
+    mirror_options.bind = result["bind"].as<std::string>();
+    mirror_options.port = result["port"].as<uint16_t>();
+    mirror_options.refresh_interval = std::chrono::seconds(result["refresh"].as<long>());
+  } catch (const fyber::ExitMessage& err) {
+    spdlog::error(err.what());
+    return err.code;
+  } catch (const std::exception& e) {
+    spdlog::error(e.what());
+    return fyber::ExitMessage::InvalidArguments("").code;
+  }
+
+  // Handled by `sigwait` below, blocked before any thread is started so that they all inherit the mask
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  fyber::mirror::Mirror mirror(mirror_options);
+  try {
+    mirror.start();
+  } catch (const fyber::ExitMessage& err) {
+    spdlog::error(err.what());
+    return err.code;
+  }
+
+  int signal = 0;
+  sigwait(&signals, &signal);
+
+  spdlog::info("Stopping after {} requests", mirror.requests());
+  mirror.stop();
+  return 0;
+}
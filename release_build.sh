@@ -0,0 +1,72 @@
+#!/usr/bin/env bash
+# Build skad_updater with profile-guided and link-time optimization, linked statically where possible, and compare it
+# with a plain release build.
+#
+#   release_build.sh <source dir> <output dir>
+#
+# 1. builds an instrumented skad_updater and runs it over the synthetic corpus of the benchmarks (plists, Podfiles and
+#    catalog responses served by the mock server) to collect profiles,
+# 2. rebuilds it in the same directory with the profiles, LTO and static linking,
+# 3. builds a plain release and writes the startup and throughput of both to <output dir>/gains.txt
+set -e
+
+export PROJECT_SOURCE_DIR=$1
+export OUTPUT_DIR=$2
+
+export OPTIMIZED_DIR=${OUTPUT_DIR}/optimized
+export PLAIN_DIR=${OUTPUT_DIR}/plain
+export PROFILES_DIR=${OUTPUT_DIR}/profiles
+export JOBS=$(getconf _NPROCESSORS_ONLN)
+
+export COMMON_OPTIONS="-DCMAKE_BUILD_TYPE=Release -DPACKAGE_BENCHMARKS=ON -DSKAD_MIRROR=OFF"
+export BENCHMARK_TARGETS="skad_updater fleet_harness startup_bench plist_bench"
+
+rm -rf "${PROFILES_DIR}"
+mkdir -p "${PROFILES_DIR}"
+
+echo "### Instrumented build"
+cmake -S "${PROJECT_SOURCE_DIR}" -B "${OPTIMIZED_DIR}" ${COMMON_OPTIONS} -DSKAD_PGO=generate \
+  -DSKAD_PGO_DIR="${PROFILES_DIR}" -DSKAD_LTO=OFF -DSKAD_STATIC=OFF
+cmake --build "${OPTIMIZED_DIR}" --target ${BENCHMARK_TARGETS} -- -j "${JOBS}"
+
+echo "### Training"
+# Budgets are irrelevant to an instrumented binary
+"${OPTIMIZED_DIR}/benchmarks/fleet_harness" --apps 200 --workdir "${OUTPUT_DIR}/training_fleet" \
+  --binary "${OPTIMIZED_DIR}/bin/skad_updater"
+"${OPTIMIZED_DIR}/benchmarks/startup_bench" --runs 10 --workdir "${OUTPUT_DIR}/training_startup" \
+  --binary "${OPTIMIZED_DIR}/bin/skad_updater" --help_budget_ms 1e9 --offline_budget_ms 1e9 --cached_budget_ms 1e9
+"${OPTIMIZED_DIR}/benchmarks/plist_bench" 200
+
+if ls "${PROFILES_DIR}"/*.profraw >/dev/null 2>&1; then
+  llvm-profdata merge -output="${PROFILES_DIR}/skad.profdata" "${PROFILES_DIR}"/*.profraw
+fi
+
+echo "### Optimized build"
+cmake -S "${PROJECT_SOURCE_DIR}" -B "${OPTIMIZED_DIR}" ${COMMON_OPTIONS} -DSKAD_PGO=use \
+  -DSKAD_PGO_DIR="${PROFILES_DIR}" -DSKAD_LTO=ON -DSKAD_STATIC=ON
+cmake --build "${OPTIMIZED_DIR}" --target ${BENCHMARK_TARGETS} -- -j "${JOBS}"
+
+echo "### Plain build"
+cmake -S "${PROJECT_SOURCE_DIR}" -B "${PLAIN_DIR}" ${COMMON_OPTIONS}
+cmake --build "${PLAIN_DIR}" --target ${BENCHMARK_TARGETS} -- -j "${JOBS}"
+
+echo "### Comparison"
+export GAINS=${OUTPUT_DIR}/gains.txt
+{
+  echo "Startup, plain build"
+  "${PLAIN_DIR}/benchmarks/startup_bench" --runs 50 --workdir "${OUTPUT_DIR}/startup" \
+    --binary "${PLAIN_DIR}/bin/skad_updater" || true
+  echo
+  echo "Startup, optimized build"
+  "${PLAIN_DIR}/benchmarks/startup_bench" --runs 50 --workdir "${OUTPUT_DIR}/startup" \
+    --binary "${OPTIMIZED_DIR}/bin/skad_updater" || true
+  echo
+  echo "Throughput, plain build -> optimized build"
+  "${PLAIN_DIR}/benchmarks/fleet_harness" --apps 500 --workdir "${OUTPUT_DIR}/fleet" \
+    --binary "${PLAIN_DIR}/bin/skad_updater" --baseline "${OUTPUT_DIR}/plain_fleet.txt" --write_baseline
+  "${PLAIN_DIR}/benchmarks/fleet_harness" --apps 500 --workdir "${OUTPUT_DIR}/fleet" \
+    --binary "${OPTIMIZED_DIR}/bin/skad_updater" --baseline "${OUTPUT_DIR}/plain_fleet.txt" --threshold 0 || true
+} | tee "${GAINS}"
+
+ls -la "${OPTIMIZED_DIR}/bin/skad_updater"
+echo "Gains written to ${GAINS}"
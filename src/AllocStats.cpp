@@ -0,0 +1,326 @@
+#include "AllocStats.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+
+#include "spdlog/fmt/fmt.h"
+
+#ifdef SKAD_ALLOC_STATS
+#include <curl/curl.h>
+#ifdef __APPLE__
+#include <malloc/malloc.h>
+#define SKAD_USABLE_SIZE(ptr) malloc_size(ptr)
+#else
+#include <malloc.h>
+#define SKAD_USABLE_SIZE(ptr) malloc_usable_size(ptr)
+#endif
+#endif
+
+namespace fyber::memory {
+
+namespace {
+
+constexpr size_t phase_count = static_cast<size_t>(Phase::Write) + 1;
+
+#ifdef SKAD_ALLOC_STATS
+
+/// Counters of a phase. Updated on every allocation, so nothing here may allocate.
+struct PhaseCounters
+{
+  std::atomic<size_t> allocations{0};
+  std::atomic<size_t> bytes{0};
+  std::atomic<size_t> peak_live_bytes{0};
+};
+
+// Zero-initialized before any constructor runs, allocations of static initializers are counted too
+PhaseCounters counters[phase_count];
+std::atomic<size_t> live_bytes{0};
+std::atomic<size_t> peak_live_bytes{0};
+
+thread_local Phase current_phase = Phase::Other;
+
+void raise_to(std::atomic<size_t>& peak, size_t value)
+{
+  size_t current = peak.load(std::memory_order_relaxed);
+  while (current < value and !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+  }
+}
+
+void count_allocation(void* ptr)
+{
+  if (ptr == nullptr) return;
+
+  const size_t size = SKAD_USABLE_SIZE(ptr);
+  auto& phase = counters[static_cast<size_t>(current_phase)];
+  phase.allocations.fetch_add(1, std::memory_order_relaxed);
+  phase.bytes.fetch_add(size, std::memory_order_relaxed);
+
+  const size_t live = live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+  raise_to(phase.peak_live_bytes, live);
+  raise_to(peak_live_bytes, live);
+}
+
+void count_deallocation(void* ptr)
+{
+  if (ptr != nullptr) live_bytes.fetch_sub(SKAD_USABLE_SIZE(ptr), std::memory_order_relaxed);
+}
+
+void* allocate(size_t size)
+{
+  void* ptr = std::malloc(size == 0 ? 1 : size);
+  count_allocation(ptr);
+  return ptr;
+}
+
+void* allocate_aligned(size_t size, std::align_val_t align)
+{
+  void* ptr = nullptr;
+  if (posix_memalign(&ptr, std::max(static_cast<size_t>(align), sizeof(void*)), size == 0 ? 1 : size) != 0) {
+    return nullptr;
+  }
+  count_allocation(ptr);
+  return ptr;
+}
+
+void* calloc_counted(size_t count, size_t size)
+{
+  void* ptr = std::calloc(count, size);
+  count_allocation(ptr);
+  return ptr;
+}
+
+char* strdup_counted(const char* text)
+{
+  const size_t size = std::strlen(text) + 1;
+  auto* copy = static_cast<char*>(alloc_stats::malloc(size));
+  if (copy != nullptr) std::memcpy(copy, text, size);
+  return copy;
+}
+
+#endif
+
+}  // namespace
+
+#ifdef SKAD_ALLOC_STATS
+
+void* alloc_stats::malloc(size_t size)
+{
+  return allocate(size);
+}
+
+void* alloc_stats::realloc(void* ptr, size_t size)
+{
+  const size_t previous_size = ptr == nullptr ? 0 : SKAD_USABLE_SIZE(ptr);
+  void* reallocated = std::realloc(ptr, size);
+  if (reallocated == nullptr and size != 0) return nullptr;
+
+  // Counted as a new allocation, which it usually is
+  live_bytes.fetch_sub(previous_size, std::memory_order_relaxed);
+  count_allocation(reallocated);
+  return reallocated;
+}
+
+void alloc_stats::free(void* ptr)
+{
+  count_deallocation(ptr);
+  std::free(ptr);
+}
+
+alloc_stats::Counts alloc_stats::of(Phase phase)
+{
+  const auto& phase_counters = counters[static_cast<size_t>(phase)];
+  return Counts{phase_counters.allocations.load(), phase_counters.bytes.load(), phase_counters.peak_live_bytes.load()};
+}
+
+void alloc_stats::install_curl_hooks()
+{
+  curl_global_init_mem(CURL_GLOBAL_DEFAULT, alloc_stats::malloc, alloc_stats::free, alloc_stats::realloc,
+                       strdup_counted, calloc_counted);
+}
+
+PhaseScope::PhaseScope(Phase phase) : _previous(current_phase)
+{
+  current_phase = phase;
+  raise_to(counters[static_cast<size_t>(phase)].peak_live_bytes, live_bytes.load(std::memory_order_relaxed));
+}
+
+PhaseScope::~PhaseScope()
+{
+  current_phase = _previous;
+}
+
+#else
+
+alloc_stats::Counts alloc_stats::of(Phase)
+{
+  return Counts();
+}
+
+void alloc_stats::install_curl_hooks() {}
+
+#endif
+
+alloc_stats::Counts alloc_stats::total()
+{
+  Counts total;
+  for (auto phase : phases()) {
+    auto counts = of(phase);
+    total.allocations += counts.allocations;
+    total.bytes += counts.bytes;
+  }
+#ifdef SKAD_ALLOC_STATS
+  total.peak_live_bytes = peak_live_bytes.load();
+#endif
+  return total;
+}
+
+size_t alloc_stats::max_rss_bytes()
+{
+  struct rusage usage = {};
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+  return static_cast<size_t>(usage.ru_maxrss);
+#else
+  // In kilobytes on Linux
+  return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+const std::vector<Phase>& alloc_stats::phases()
+{
+  static const std::vector<Phase> phases = {Phase::Other,        Phase::Cli,       Phase::PlistParse,
+                                            Phase::PodfileParse, Phase::Http,      Phase::JsonParse,
+                                            Phase::Diff,         Phase::Serialize, Phase::Write};
+  return phases;
+}
+
+const char* alloc_stats::phase_name(Phase phase)
+{
+  switch (phase) {
+    case Phase::Other:
+      return "other";
+    case Phase::Cli:
+      return "cli";
+    case Phase::PlistParse:
+      return "plist_parse";
+    case Phase::PodfileParse:
+      return "podfile_parse";
+    case Phase::Http:
+      return "http";
+    case Phase::JsonParse:
+      return "json_parse";
+    case Phase::Diff:
+      return "diff";
+    case Phase::Serialize:
+      return "serialize";
+    case Phase::Write:
+      return "write";
+  }
+  return "";
+}
+
+std::string alloc_stats::report()
+{
+  // Counted before formatting, which allocates too
+  std::vector<Counts> counts;
+  counts.reserve(phases().size());
+  for (auto phase : phases()) counts.push_back(of(phase));
+  auto totals = total();
+  const size_t max_rss = max_rss_bytes();
+
+  std::string report = fmt::format("{:<14} {:>12} {:>14} {:>16}\n", "phase", "allocations", "bytes", "peak live bytes");
+  for (size_t i = 0; i < counts.size(); ++i) {
+    report += fmt::format("{:<14} {:>12} {:>14} {:>16}\n", phase_name(phases()[i]), counts[i].allocations,
+                          counts[i].bytes, counts[i].peak_live_bytes);
+  }
+  report +=
+      fmt::format("{:<14} {:>12} {:>14} {:>16}\n", "total", totals.allocations, totals.bytes, totals.peak_live_bytes);
+  report += fmt::format("max RSS: {} bytes\n", max_rss);
+  return report;
+}
+
+}  // namespace fyber::memory
+
+#ifdef SKAD_ALLOC_STATS
+
+//------------------- Global operator new -----------------------------------------------
+
+void* operator new(size_t size)
+{
+  void* ptr = fyber::memory::allocate(size);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+  return fyber::memory::allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+  return fyber::memory::allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t align)
+{
+  void* ptr = fyber::memory::allocate_aligned(size, align);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void* operator new[](size_t size, std::align_val_t align)
+{
+  return operator new(size, align);
+}
+
+void operator delete(void* ptr) noexcept
+{
+  fyber::memory::alloc_stats::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+  fyber::memory::alloc_stats::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+  fyber::memory::alloc_stats::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+  fyber::memory::alloc_stats::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+  fyber::memory::alloc_stats::free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+  fyber::memory::alloc_stats::free(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept
+{
+  fyber::memory::alloc_stats::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept
+{
+  fyber::memory::alloc_stats::free(ptr);
+}
+
+#endif
@@ -0,0 +1,100 @@
+#pragma once
+#include <cstddef>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace fyber::memory {
+
+/// The phases of a run that allocations are accounted to
+enum class Phase
+{
+  Other,
+  Cli,
+  PlistParse,
+  PodfileParse,
+  Http,
+  JsonParse,
+  Diff,
+  Serialize,
+  Write,
+};
+
+/// Allocation accounting by phase, compiled in with `SKAD_ALLOC_STATS`. <br/>
+/// Counts the global `operator new`, pugixml, rapidjson, curl and arena allocations, in the bytes reserved by the
+/// allocator (`malloc_usable_size`), along with the peak of the live bytes reached while in each phase. <br/>
+/// Without `SKAD_ALLOC_STATS` every count is 0 and the allocation functions forward to `malloc`.
+struct alloc_stats
+{
+  /// The allocations of a phase
+  struct Counts
+  {
+    size_t allocations = 0;
+    size_t bytes = 0;
+    size_t peak_live_bytes = 0;
+  };
+
+#ifdef SKAD_ALLOC_STATS
+  static constexpr bool compiled = true;
+
+  static void* malloc(size_t size);
+  static void* realloc(void* ptr, size_t size);
+  static void free(void* ptr);
+#else
+  static constexpr bool compiled = false;
+
+  static void* malloc(size_t size)
+  {
+    return std::malloc(size);
+  }
+  static void* realloc(void* ptr, size_t size)
+  {
+    return std::realloc(ptr, size);
+  }
+  static void free(void* ptr)
+  {
+    std::free(ptr);
+  }
+#endif
+
+  /// Initialize curl with its allocations routed through `malloc`, in place of `curl_global_init`
+  static void install_curl_hooks();
+
+  /// The allocations of [phase] since the process started
+  static Counts of(Phase phase);
+
+  /// The allocations of every phase, the peak being that of the process
+  static Counts total();
+
+  /// The maximum resident set size of the process, in bytes (`getrusage`)
+  static size_t max_rss_bytes();
+
+  static const char* phase_name(Phase phase);
+
+  /// Every phase, in the order of a run
+  static const std::vector<Phase>& phases();
+
+  /// A table of the allocations by phase, followed by the maximum RSS
+  static std::string report();
+};
+
+/// While in scope, the allocations made by the current thread are accounted to [phase]. Scopes nest.
+class PhaseScope
+{
+#ifdef SKAD_ALLOC_STATS
+ private:
+  Phase _previous;
+
+ public:
+  explicit PhaseScope(Phase phase);
+  ~PhaseScope();
+#else
+ public:
+  explicit PhaseScope(Phase) {}
+#endif
+
+  PhaseScope(const PhaseScope&) = delete;
+  PhaseScope& operator=(const PhaseScope&) = delete;
+};
+
+}  // namespace fyber::memory
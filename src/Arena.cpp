@@ -0,0 +1,141 @@
+#include "Arena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <pugixml.hpp>
+
+#include "AllocStats.h"
+
+namespace fyber::memory {
+
+namespace {
+
+thread_local Arena* current_arena = nullptr;
+
+std::atomic<size_t> heap_allocations{0};
+std::atomic<size_t> arena_allocations{0};
+
+/// pugixml deallocates without a size or an owner, so every allocation is prefixed with a header telling where it
+/// came from.
+struct alignas(std::max_align_t) AllocationHeader
+{
+  bool from_arena;
+};
+
+void* pugixml_allocate(size_t size)
+{
+  AllocationHeader* header;
+
+  if (current_arena != nullptr) {
+    header = static_cast<AllocationHeader*>(current_arena->allocate(sizeof(AllocationHeader) + size));
+    header->from_arena = true;
+    arena_allocations++;
+  } else {
+    header = static_cast<AllocationHeader*>(alloc_stats::malloc(sizeof(AllocationHeader) + size));
+    if (header == nullptr) return nullptr;
+    header->from_arena = false;
+    heap_allocations++;
+  }
+
+  return header + 1;
+}
+
+void pugixml_deallocate(void* ptr)
+{
+  if (ptr == nullptr) return;
+
+  auto* header = static_cast<AllocationHeader*>(ptr) - 1;
+  // Arena memory is released by `Arena::reset`
+  if (!header->from_arena) alloc_stats::free(header);
+}
+
+}  // namespace
+
+void install_pugixml_hooks()
+{
+  static std::once_flag installed;
+  std::call_once(installed, [] { pugi::set_memory_management_functions(pugixml_allocate, pugixml_deallocate); });
+}
+
+//------------------- Arena -----------------------------------------------
+
+Arena::Arena(size_t block_size) : _block_size(block_size) {}
+
+Arena::~Arena()
+{
+  for (auto& block : _blocks) alloc_stats::free(block.data);
+}
+
+Arena::Block& Arena::block_for(size_t size, size_t align)
+{
+  if (!_blocks.empty()) {
+    Block& last = _blocks.back();
+    size_t offset = (last.used + align - 1) & ~(align - 1);
+    if (offset + size <= last.size) return last;
+  }
+
+  size_t block_size = std::max(_block_size, size + align);
+  auto* data = static_cast<char*>(alloc_stats::malloc(block_size));
+  if (data == nullptr) throw std::bad_alloc();
+
+  _blocks.push_back(Block{data, block_size, 0});
+  return _blocks.back();
+}
+
+void* Arena::allocate(size_t size, size_t align)
+{
+  Block& block = block_for(size, align);
+
+  // Blocks come from malloc, so aligning the offset aligns the address
+  size_t offset = (block.used + align - 1) & ~(align - 1);
+  block.used = offset + size;
+
+  _allocations++;
+  _bytes += size;
+
+  return block.data + offset;
+}
+
+std::string_view Arena::copy(std::string_view text)
+{
+  auto* data = static_cast<char*>(allocate(text.size() + 1, 1));
+  std::memcpy(data, text.data(), text.size());
+  data[text.size()] = '\0';
+  return std::string_view(data, text.size());
+}
+
+void Arena::reset()
+{
+  if (!_blocks.empty()) {
+    for (size_t i = 1; i < _blocks.size(); ++i) alloc_stats::free(_blocks[i].data);
+    _blocks.resize(1);
+    _blocks.front().used = 0;
+  }
+
+  _allocations = 0;
+  _bytes = 0;
+}
+
+//------------------- ArenaScope -----------------------------------------------
+
+ArenaScope::ArenaScope(Arena& arena) : _previous(current_arena)
+{
+  install_pugixml_hooks();
+  current_arena = &arena;
+}
+
+ArenaScope::~ArenaScope()
+{
+  current_arena = _previous;
+}
+
+PugixmlAllocations pugixml_allocations()
+{
+  return PugixmlAllocations{heap_allocations.load(), arena_allocations.load()};
+}
+
+}  // namespace fyber::memory
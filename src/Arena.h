@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace fyber::memory {
+
+/// A monotonic arena. <br/>
+/// Allocations are carved out of large blocks and are never freed individually, everything is released at once by
+/// `reset()`.
+class Arena
+{
+ private:
+  struct Block
+  {
+    char* data;
+    size_t size;
+    size_t used;
+  };
+
+  const size_t _block_size;
+  std::vector<Block> _blocks;
+  size_t _allocations = 0;
+  size_t _bytes = 0;
+
+  Block& block_for(size_t size, size_t align);
+
+ public:
+  explicit Arena(size_t block_size = 64 * 1024);
+  ~Arena();
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  /// Allocate [size] bytes aligned to [align]
+  void* allocate(size_t size, size_t align = alignof(std::max_align_t));
+
+  /// Copy [text] into the arena, null-terminated
+  std::string_view copy(std::string_view text);
+
+  /// Release every allocation. The first block is kept for reuse.
+  void reset();
+
+  /// Number of allocations since the last reset
+  [[nodiscard]] size_t allocations() const { return _allocations; }
+
+  /// Number of bytes allocated since the last reset
+  [[nodiscard]] size_t bytes() const { return _bytes; }
+
+  /// Number of blocks currently held
+  [[nodiscard]] size_t blocks() const { return _blocks.size(); }
+};
+
+/// While in scope, pugixml allocations made by the current thread are served from [arena]. <br/>
+/// <b> NOTE: </b> documents created in the scope must be destroyed before the arena is reset.
+class ArenaScope
+{
+ private:
+  Arena* _previous;
+
+ public:
+  explicit ArenaScope(Arena& arena);
+  ~ArenaScope();
+
+  ArenaScope(const ArenaScope&) = delete;
+  ArenaScope& operator=(const ArenaScope&) = delete;
+};
+
+/// Route pugixml allocations through the arena aware allocator. <br/>
+/// Must run before any pugixml document allocates, since memory is released by the functions installed at that time.
+void install_pugixml_hooks();
+
+/// Counters of the allocations requested by pugixml
+struct PugixmlAllocations
+{
+  size_t heap;
+  size_t arena;
+};
+
+/// Get the number of pugixml allocations served by the heap and by arenas, since the process started
+PugixmlAllocations pugixml_allocations();
+
+}  // namespace fyber::memory
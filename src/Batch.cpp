@@ -0,0 +1,169 @@
+#include "Batch.h"
+
+#include <algorithm>
+#include <filesystem>
+
+#include "Arena.h"
+#include "common.h"
+#include "exit_message.h"
+
+namespace fyber {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/// [path] relative to [base], both made absolute
+string relative_key(const string& path, const fs::path& base)
+{
+  auto relative = fs::absolute(path).lexically_normal().lexically_relative(fs::absolute(base).lexically_normal());
+  return relative.empty() ? path : relative.generic_string();
+}
+
+}  // namespace
+
+//------------------- Shard -----------------------------------------------
+
+Shard Shard::parse(const string& text)
+{
+  auto separator = text.find('/');
+
+  if (separator != string::npos) {
+    auto index = text.substr(0, separator);
+    auto count = text.substr(separator + 1);
+
+    if (common::is_integer(index) and common::is_integer(count) and index.size() < 9 and count.size() < 9) {
+      Shard shard{std::stoi(index), std::stoi(count)};
+      if (shard.count > 0 and shard.index > 0 and shard.index <= shard.count) return shard;
+    }
+  }
+
+  throw ExitMessage::InvalidArguments("Invalid shard `" + text + "`, expected `i/N` where 1 <= i <= N");
+}
+
+string Shard::to_string() const
+{
+  return std::to_string(index) + "/" + std::to_string(count);
+}
+
+//------------------- Batch -----------------------------------------------
+
+vector<Job> Batch::read_batch_file(const string& batch_file_path, const optional<string>& default_pod_file_path)
+{
+  auto content = common::read_text_input(batch_file_path, "batch_file");
+  const auto base =
+      common::is_stream(batch_file_path) ? fs::current_path() : fs::absolute(batch_file_path).parent_path();
+
+  vector<Job> jobs;
+  std::string_view lines(content);
+  for (size_t number = 1; !lines.empty(); ++number) {
+    const auto end = lines.find('\n');
+    // Columns are trimmed one by one, a line starting with a tab has an empty plist column
+    const auto line = lines.substr(0, end);
+    lines.remove_prefix(end == std::string_view::npos ? lines.size() : end + 1);
+
+    const auto trimmed = common::trim_view(line);
+    if (trimmed.empty() or trimmed.front() == '#') continue;
+
+    auto tab = line.find('\t');
+    auto plist_file_path = common::trim_view(line.substr(0, tab));
+    if (plist_file_path.empty()) {
+      throw ExitMessage::InvalidArguments("Line " + std::to_string(number) + " of the batch_file `" + batch_file_path +
+                                          "` has no plist path");
+    }
+    Job job{string(plist_file_path), default_pod_file_path};
+
+    if (tab != std::string_view::npos) {
+      auto rest = line.substr(tab + 1);
+      auto target_tab = rest.find('\t');
+
+      auto pod_file_path = common::trim_view(rest.substr(0, target_tab));
+      if (!pod_file_path.empty()) job.pod_file_path = string(pod_file_path);
+
+      if (target_tab != std::string_view::npos) {
+        auto pod_target = common::trim_view(rest.substr(target_tab + 1));
+        if (!pod_target.empty()) job.pod_target = string(pod_target);
+      }
+    }
+
+    job.shard_key = relative_key(job.plist_file_path, base);
+    jobs.push_back(std::move(job));
+  }
+
+  return jobs;
+}
+
+vector<Job> Batch::discover(const string& root_dir, const optional<string>& default_pod_file_path)
+{
+  if (!fs::is_directory(root_dir)) {
+    throw ExitMessage::NotAFile("Provided discover_dir is invalid : " +
+                                common::file_status_to_string(fs::status(root_dir)));
+  }
+
+  fs::path root(root_dir);
+  if (!root.has_filename()) root = root.parent_path();  // so it compares equal to the parents of what's under it
+
+  vector<Job> jobs;
+
+  auto options = fs::directory_options::skip_permission_denied;
+  for (auto it = fs::recursive_directory_iterator(root, options); it != fs::recursive_directory_iterator(); ++it) {
+    const auto name = it->path().filename().string();
+
+    if (it->is_directory()) {
+      if (name.front() == '.' or name == "Pods") it.disable_recursion_pending();
+      continue;
+    }
+
+    if (name != plist_file_name or !it->is_regular_file()) continue;
+
+    Job job{it->path().string(), default_pod_file_path, std::nullopt, relative_key(it->path().string(), root)};
+
+    for (auto dir = it->path().parent_path();; dir = dir.parent_path()) {
+      if (fs::is_regular_file(dir / pod_file_name)) {
+        job.pod_file_path = (dir / pod_file_name).string();
+        break;
+      }
+      if (dir == root or dir.empty() or dir == dir.parent_path()) break;
+    }
+
+    jobs.push_back(std::move(job));
+  }
+
+  std::sort(jobs.begin(), jobs.end(),
+            [](const Job& left, const Job& right) { return left.plist_file_path < right.plist_file_path; });
+
+  return jobs;
+}
+
+uint64_t Batch::stable_hash(std::string_view path)
+{
+  return common::fnv1a(fs::path(path).lexically_normal().generic_string());
+}
+
+vector<Job> Batch::shard(const vector<Job>& jobs, const Shard& shard)
+{
+  vector<Job> shard_jobs;
+
+  for (const auto& job : jobs) {
+    const auto& key = job.shard_key.empty() ? job.plist_file_path : job.shard_key;
+    if (stable_hash(key) % shard.count == static_cast<uint64_t>(shard.index - 1)) {
+      shard_jobs.push_back(job);
+    }
+  }
+
+  return shard_jobs;
+}
+
+void Batch::run(const vector<Job>& jobs, memory::Arena& arena,
+                const std::function<void(size_t index, const Job& job)>& process)
+{
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    {
+      memory::ArenaScope scope(arena);
+      process(i, jobs[i]);
+    }
+    arena.reset();
+  }
+}
+
+}  // namespace fyber
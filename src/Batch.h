@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fyber {
+
+namespace memory {
+class Arena;
+}
+
+using std::optional;
+using std::string;
+using std::vector;
+
+/// A single plist to update, with the podfile (and target of the podfile) its networks are derived from
+struct Job
+{
+  string plist_file_path;
+  optional<string> pod_file_path;
+  optional<string> pod_target;
+  /// What the job is sharded by: its plist path relative to the directory it was discovered in or listed from, so
+  /// that checkouts under different roots are sharded the same. The plist path itself when empty.
+  string shard_key;
+};
+
+/// The `index`th of `count` parts of a job list, 1-based
+struct Shard
+{
+  int index = 1;
+  int count = 1;
+
+  /// Parse a shard in the form `i/N`
+  /// \throws InvalidArguments if [text] isn't a valid shard
+  static Shard parse(const string& text);
+
+  [[nodiscard]] string to_string() const;
+};
+
+/// Build and partition the list of plists to update in a single run
+struct Batch
+{
+  inline static const char* plist_file_name = "Info.plist";
+  inline static const char* pod_file_name = "Podfile";
+
+  /// Read the jobs listed in [batch_file_path] (or stdin when `-`). <br/>
+  /// Each line holds a plist path, optionally followed by a tab and the path of its podfile, and by another tab and
+  /// the target of the podfile it belongs to, each column trimmed. Empty lines and lines starting with `#` are
+  /// skipped. <br/>
+  /// The jobs are sharded by their path relative to the directory of [batch_file_path], or to the current directory
+  /// when it's a stream.
+  /// \param default_pod_file_path used for the jobs without a podfile of their own
+  /// \throws InvalidArguments if a line has no plist path, e.g. starts with a tab
+  static vector<Job> read_batch_file(const string& batch_file_path, const optional<string>& default_pod_file_path);
+
+  /// Find every `Info.plist` under [root_dir], each paired with the nearest `Podfile` above it. <br/>
+  /// Hidden directories and `Pods` are skipped. Jobs are sorted by path, and sharded by their path relative to
+  /// [root_dir].
+  /// \param default_pod_file_path used for the plists without a podfile above them
+  static vector<Job> discover(const string& root_dir, const optional<string>& default_pod_file_path);
+
+  /// A hash of [path] that is the same on every machine and run (FNV-1a over the normalized path)
+  static uint64_t stable_hash(std::string_view path);
+
+  /// Keep the jobs of [jobs] that belong to [shard] by the hash of their `shard_key`, preserving their order
+  static vector<Job> shard(const vector<Job>& jobs, const Shard& shard);
+
+  /// Run [process] on every job of [jobs], in order, each in its own scope of [arena], which is reset once the job is
+  /// over. A batch then holds the documents of a single plist at a time, whatever its size.
+  /// <b> NOTE: </b> the documents created by [process] must not outlive its call.
+  static void run(const vector<Job>& jobs, memory::Arena& arena,
+                  const std::function<void(size_t index, const Job& job)>& process);
+};
+
+}  // namespace fyber
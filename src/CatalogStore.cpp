@@ -0,0 +1,369 @@
+#include "CatalogStore.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <system_error>
+#include <unordered_set>
+
+#include "Limits.h"
+#include "exit_message.h"
+#include "logging.h"
+#include "rapidjson/document.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+namespace fyber {
+
+namespace fs = std::filesystem;
+using std::string;
+using std::vector;
+
+namespace {
+
+const char* catalog_file = "catalog.json";
+const char* journal_file = "catalog.journal";
+
+using Writer = rapidjson::Writer<rapidjson::StringBuffer>;
+
+/// rapidjson asserts on values of another type, they are checked first
+/// \throws InvalidNetworks unless [valid]
+void expect(bool valid, const char* what)
+{
+  if (!valid) throw ExitMessage::InvalidNetworks(string("Invalid catalog returned from server: ") + what);
+}
+
+Symbol symbol(const rapidjson::Value& value)
+{
+  expect(value.IsString(), "a name or an ID isn't a string");
+  return Symbol(std::string_view(value.GetString(), value.GetStringLength()));
+}
+
+vector<Symbol> parse_ids(const rapidjson::Value& network, const Symbol& name)
+{
+  expect(network.IsArray(), "the IDs of a network aren't an array");
+  const auto max_ids = Limits::global().max_ids_per_network;
+  if (max_ids > 0 and network.GetArray().Size() > max_ids) {
+    throw ExitMessage::TooManyIds("The service returned " + std::to_string(network.GetArray().Size()) + " IDs for " +
+                                  name.str() + ", more than " + std::to_string(max_ids) +
+                                  " (see `max_ids_per_network`)");
+  }
+
+  vector<Symbol> ids;
+  ids.reserve(network.GetArray().Size());
+  for (auto& id : network.GetArray()) ids.push_back(symbol(id));
+  return ids;
+}
+
+std::map<Symbol, vector<Symbol>> parse_networks(const rapidjson::Value& networks)
+{
+  expect(networks.IsObject(), "the networks aren't an object");
+  std::map<Symbol, vector<Symbol>> parsed;
+  for (auto& network : networks.GetObject()) {
+    auto name = symbol(network.name);
+    parsed.emplace(name, parse_ids(network.value, name));
+  }
+  return parsed;
+}
+
+void write_networks(Writer& writer, const char* key, const std::map<Symbol, vector<Symbol>>& networks)
+{
+  writer.Key(key);
+  writer.StartObject();
+  for (const auto& [network, ids] : networks) {
+    writer.Key(network.c_str(), static_cast<rapidjson::SizeType>(network.view().size()));
+    writer.StartArray();
+    for (const auto& id : ids) writer.String(id.c_str(), static_cast<rapidjson::SizeType>(id.view().size()));
+    writer.EndArray();
+  }
+  writer.EndObject();
+}
+
+/// Write [content] aside and rename it to [path], so readers never see a partial file
+void write_file(const fs::path& path, const string& content)
+{
+  const auto temp_path = fs::path(path.string() + ".tmp." + std::to_string(::getpid()));
+  {
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    file.write(content.data(), static_cast<std::streamsize>(content.size()));
+  }
+
+  std::error_code error;
+  fs::rename(temp_path, path, error);
+  if (error) {
+    fs::remove(temp_path, error);
+    throw ExitMessage::NotAFile("Unable to write the catalog `" + path.string() + "`");
+  }
+}
+
+std::optional<string> read_file(const fs::path& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return std::nullopt;
+  return string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+}
+
+}  // namespace
+
+size_t CatalogStore::Delta::size() const
+{
+  size_t size = removed_networks.size();
+  for (const auto& [network, ids] : added) size += ids.size();
+  for (const auto& [network, ids] : removed) size += ids.size();
+  return size;
+}
+
+void CatalogStore::replace(uint64_t version, vector<std::pair<Symbol, vector<Symbol>>> networks)
+{
+  _version = version;
+  _networks = std::move(networks);
+  _index.clear();
+  for (size_t i = 0; i < _networks.size(); ++i) _index.emplace(_networks[i].first, i);
+}
+
+bool CatalogStore::apply(const Delta& delta)
+{
+  if (delta.since != _version or delta.version < delta.since) {
+    throw ExitMessage::InvalidNetworks("The catalog changes from version " + std::to_string(delta.since) + " to " +
+                                       std::to_string(delta.version) + " don't apply to version " +
+                                       std::to_string(_version));
+  }
+
+  // Checked before anything is changed, removals are assumed to hit
+  const auto max_ids = Limits::global().max_ids_per_network;
+  for (const auto& [network, ids] : delta.added) {
+    auto found = _index.find(network);
+    size_t size = ids.size() + (found == _index.end() ? 0 : _networks[found->second].second.size());
+    auto removed = delta.removed.find(network);
+    if (removed != delta.removed.end()) size -= std::min(size, removed->second.size());
+
+    if (max_ids > 0 and size > max_ids) {
+      throw ExitMessage::TooManyIds("The catalog has " + std::to_string(size) + " IDs for " + network.str() +
+                                    ", more than " + std::to_string(max_ids) + " (see `max_ids_per_network`)");
+    }
+  }
+
+  const size_t network_count = _networks.size();
+  size_t changed_ids = 0;
+
+  if (!delta.removed_networks.empty()) {
+    std::unordered_set<Symbol> removed(delta.removed_networks.begin(), delta.removed_networks.end());
+    _networks.erase(std::remove_if(_networks.begin(), _networks.end(),
+                                   [&](const auto& entry) { return removed.count(entry.first) > 0; }),
+                    _networks.end());
+    _index.clear();
+    for (size_t i = 0; i < _networks.size(); ++i) _index.emplace(_networks[i].first, i);
+  }
+
+  for (const auto& [network, ids] : delta.removed) {
+    auto found = _index.find(network);
+    if (found == _index.end()) continue;
+
+    std::unordered_set<Symbol> removed(ids.begin(), ids.end());
+    auto& current = _networks[found->second].second;
+    const size_t size = current.size();
+    current.erase(std::remove_if(current.begin(), current.end(), [&](const Symbol& id) { return removed.count(id); }),
+                  current.end());
+    changed_ids += size - current.size();
+  }
+
+  for (const auto& [network, ids] : delta.added) {
+    auto found = _index.find(network);
+    if (found == _index.end()) {
+      found = _index.emplace(network, _networks.size()).first;
+      _networks.emplace_back(network, vector<Symbol>());
+    }
+
+    auto& current = _networks[found->second].second;
+    std::unordered_set<Symbol> present(current.begin(), current.end());
+    for (const auto& id : ids) {
+      if (!present.insert(id).second) continue;
+      current.push_back(id);
+      changed_ids++;
+    }
+  }
+
+  _version = delta.version;
+  return changed_ids > 0 or _networks.size() != network_count or !delta.removed_networks.empty();
+}
+
+CatalogStore::Update CatalogStore::apply_response(const string& response, Delta* delta)
+{
+  rapidjson::Document doc;
+  doc.Parse(response.c_str(), response.size());
+
+  if (doc.HasParseError() or !doc.IsObject()) {
+    throw ExitMessage::InvalidNetworks("Invalid catalog returned from server: " + std::to_string(doc.GetParseError()));
+  }
+
+  auto member = [&doc](const char* name) -> const rapidjson::Value* {
+    auto found = doc.FindMember(name);
+    return found == doc.MemberEnd() ? nullptr : &found->value;
+  };
+
+  const auto* version = member("version");
+  expect(version != nullptr and version->IsUint64() and version->GetUint64() > 0, "no version");
+
+  const auto* since = member("since");
+  if (since == nullptr) {
+    const auto* whole = member("networks");
+    expect(whole != nullptr and whole->IsObject(), "no networks");
+
+    vector<std::pair<Symbol, vector<Symbol>>> networks;
+    std::unordered_set<Symbol> names;
+    for (auto& network : whole->GetObject()) {
+      auto name = symbol(network.name);
+      if (names.insert(name).second) networks.emplace_back(name, parse_ids(network.value, name));
+    }
+
+    SKAD_DEBUG("Catalog replaced with version {} of {} networks", version->GetUint64(), networks.size());
+    replace(version->GetUint64(), std::move(networks));
+    if (delta != nullptr) *delta = Delta{0, _version};
+    return Update::Replaced;
+  }
+
+  expect(since->IsUint64(), "the version of the changes isn't a number");
+  Delta changes;
+  changes.since = since->GetUint64();
+  changes.version = version->GetUint64();
+  if (const auto* added = member("added")) changes.added = parse_networks(*added);
+  if (const auto* removed = member("removed")) changes.removed = parse_networks(*removed);
+  if (const auto* removed_networks = member("removed_networks")) {
+    expect(removed_networks->IsArray(), "the removed networks aren't an array");
+    for (auto& network : removed_networks->GetArray()) changes.removed_networks.push_back(symbol(network));
+  }
+
+  const bool changed = apply(changes);
+  SKAD_DEBUG("Catalog updated from version {} to {} with {} changes", changes.since, changes.version, changes.size());
+
+  if (delta != nullptr) *delta = std::move(changes);
+  return changed ? Update::Changed : Update::Unchanged;
+}
+
+vector<Symbol> CatalogStore::networks() const
+{
+  vector<Symbol> networks;
+  networks.reserve(_networks.size());
+  for (const auto& [network, ids] : _networks) networks.push_back(network);
+  return networks;
+}
+
+std::map<Symbol, vector<Symbol>> CatalogStore::sk_ad_networks(const vector<Symbol>& networks) const
+{
+  std::map<Symbol, vector<Symbol>> sk_ad_networks;
+  for (const auto& network : networks) {
+    auto found = _index.find(network);
+    sk_ad_networks.emplace(network, found == _index.end() ? vector<Symbol>() : _networks[found->second].second);
+  }
+  return sk_ad_networks;
+}
+
+string CatalogStore::to_json() const
+{
+  rapidjson::StringBuffer buffer;
+  Writer writer(buffer);
+
+  writer.StartObject();
+  writer.Key("version");
+  writer.Uint64(_version);
+  writer.Key("networks");
+  writer.StartObject();
+  for (const auto& [network, ids] : _networks) {
+    writer.Key(network.c_str(), static_cast<rapidjson::SizeType>(network.view().size()));
+    writer.StartArray();
+    for (const auto& id : ids) writer.String(id.c_str(), static_cast<rapidjson::SizeType>(id.view().size()));
+    writer.EndArray();
+  }
+  writer.EndObject();
+  writer.EndObject();
+
+  return string(buffer.GetString(), buffer.GetSize());
+}
+
+string CatalogStore::to_json(const Delta& delta)
+{
+  rapidjson::StringBuffer buffer;
+  Writer writer(buffer);
+
+  writer.StartObject();
+  writer.Key("version");
+  writer.Uint64(delta.version);
+  writer.Key("since");
+  writer.Uint64(delta.since);
+  write_networks(writer, "added", delta.added);
+  write_networks(writer, "removed", delta.removed);
+  writer.Key("removed_networks");
+  writer.StartArray();
+  for (const auto& network : delta.removed_networks) {
+    writer.String(network.c_str(), static_cast<rapidjson::SizeType>(network.view().size()));
+  }
+  writer.EndArray();
+  writer.EndObject();
+
+  return string(buffer.GetString(), buffer.GetSize());
+}
+
+CatalogStore CatalogStore::load(const fs::path& dir)
+{
+  CatalogStore store;
+
+  auto catalog = read_file(dir / catalog_file);
+  if (!catalog.has_value()) return store;
+
+  try {
+    store.apply_response(catalog.value());
+  } catch (const ExitMessage& invalid) {
+    SKAD_DEBUG("Ignoring the catalog in `{}` : {}", dir.string(), invalid.what());
+    return CatalogStore();
+  }
+
+  // Changes are applied as far as they follow each other, the service sends the rest
+  std::ifstream journal(dir / journal_file, std::ios::binary);
+  string line;
+  while (std::getline(journal, line)) {
+    try {
+      store.apply_response(line);
+    } catch (const ExitMessage& invalid) {
+      SKAD_DEBUG("Ignoring the catalog changes in `{}` from version {} : {}", dir.string(), store.version(),
+                 invalid.what());
+      break;
+    }
+  }
+
+  return store;
+}
+
+void CatalogStore::save(const fs::path& dir, Update update, const Delta& delta) const
+{
+  const auto catalog_path = dir / catalog_file;
+  const auto journal_path = dir / journal_file;
+
+  std::error_code error;
+  const auto catalog_size = fs::file_size(catalog_path, error);
+
+  if (update != Update::Replaced and !error) {
+    std::ofstream journal(journal_path, std::ios::binary | std::ios::app);
+    journal << to_json(delta) << '\n';
+    journal.close();
+
+    const auto journal_size = fs::file_size(journal_path, error);
+    if (journal and !error and journal_size <= catalog_size) return;
+  }
+
+  // The journal is only emptied once the catalog it applies to is replaced
+  write_file(catalog_path, to_json());
+  write_file(journal_path, "");
+}
+
+bool CatalogStore::is_fresh(const fs::path& dir, std::chrono::seconds ttl)
+{
+  // The journal is written by every sync
+  std::error_code error;
+  auto modified = fs::last_write_time(dir / journal_file, error);
+  return !error and fs::file_time_type::clock::now() - modified < ttl;
+}
+
+}  // namespace fyber
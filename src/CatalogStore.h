@@ -0,0 +1,101 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Symbol.h"
+
+namespace fyber {
+
+/// The whole catalog of the service at a version, kept up to date by applying the changes since that version in
+/// place, so a refresh costs the size of the change rather than the size of the catalog. <br/>
+/// The service answers `/catalog` with either form:
+///\code
+/// {"version": 7, "networks": {"AdColony": ["4PFYVQ9L8R.skadnetwork"], "Applovin": ["ludvb6z3bs.skadnetwork"]}}
+/// {"version": 9, "since": 7, "added": {"Applovin": ["v9wttpbfk9.skadnetwork"]},
+///  "removed": {"AdColony": ["4PFYVQ9L8R.skadnetwork"]}, "removed_networks": ["Unknown_network"]}
+class CatalogStore
+{
+ public:
+  /// The changes between two versions of the catalog
+  struct Delta
+  {
+    uint64_t since = 0;
+    uint64_t version = 0;
+    /// IDs added, to new networks as well
+    std::map<Symbol, std::vector<Symbol>> added;
+    std::map<Symbol, std::vector<Symbol>> removed;
+    std::vector<Symbol> removed_networks;
+
+    /// Number of IDs and networks changed
+    [[nodiscard]] size_t size() const;
+  };
+
+  /// What applying a response of `/catalog` did
+  enum class Update
+  {
+    /// The whole catalog was replaced
+    Replaced,
+    /// Changes were applied
+    Changed,
+    /// Already up to date
+    Unchanged
+  };
+
+ private:
+  uint64_t _version = 0;
+  /// In the order of the service
+  std::vector<std::pair<Symbol, std::vector<Symbol>>> _networks;
+  /// Position of each network in `_networks`
+  std::unordered_map<Symbol, size_t> _index;
+
+  /// \return whether the catalog changed, beyond its version
+  /// \throws InvalidNetworks if [delta] doesn't start at the version of the store
+  bool apply(const Delta& delta);
+
+ public:
+  /// Versions start at 1, an empty store is at 0
+  [[nodiscard]] uint64_t version() const { return _version; }
+  [[nodiscard]] bool empty() const { return _version == 0; }
+
+  /// Replace the catalog with [networks] at [version]
+  void replace(uint64_t version, std::vector<std::pair<Symbol, std::vector<Symbol>>> networks);
+
+  /// Apply a response of `/catalog`, a whole catalog or the changes since the version of the store. <br/>
+  /// The store is unchanged when this throws.
+  /// \param delta set to the changes applied, when given
+  /// \throws InvalidNetworks if [response] is invalid or its changes don't start at the version of the store
+  /// \throws TooManyIds if a network has more IDs than `max_ids_per_network`
+  Update apply_response(const std::string& response, Delta* delta = nullptr);
+
+  /// The network names, in the order of the service
+  [[nodiscard]] std::vector<Symbol> networks() const;
+
+  /// The whole catalog, in the order of the service
+  [[nodiscard]] const std::vector<std::pair<Symbol, std::vector<Symbol>>>& entries() const { return _networks; }
+
+  /// The SKAdNetwork IDs of [networks], as the `/plist` endpoint would return them: a network missing from the
+  /// catalog has no IDs.
+  [[nodiscard]] std::map<Symbol, std::vector<Symbol>> sk_ad_networks(const std::vector<Symbol>& networks) const;
+
+  /// The whole catalog, as the service would serve it
+  [[nodiscard]] std::string to_json() const;
+  [[nodiscard]] static std::string to_json(const Delta& delta);
+
+  /// Read the store kept in [dir] by `save`, empty when there's none or it's unreadable
+  static CatalogStore load(const std::filesystem::path& dir);
+
+  /// Keep the store in [dir], after [update] applied [delta]: changes are appended to a journal, which is folded into
+  /// the whole catalog once it outgrows it. Concurrent processes have to serialize `load` and `save`.
+  void save(const std::filesystem::path& dir, Update update, const Delta& delta) const;
+
+  /// Whether the store kept in [dir] was synced less than [ttl] ago
+  static bool is_fresh(const std::filesystem::path& dir, std::chrono::seconds ttl);
+};
+
+}  // namespace fyber
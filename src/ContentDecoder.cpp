@@ -0,0 +1,197 @@
+#include "ContentDecoder.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+
+#ifdef SKAD_ZSTD
+#include <zstd.h>
+#endif
+
+#include "exit_message.h"
+
+namespace fyber {
+
+namespace {
+
+constexpr unsigned char gzip_magic[] = {0x1f, 0x8b};
+constexpr unsigned char zstd_magic[] = {0x28, 0xb5, 0x2f, 0xfd};
+
+/// Whether [data] starts with [magic], or with a part of it when shorter
+template <size_t size>
+bool starts_with(std::string_view data, const unsigned char (&magic)[size])
+{
+  for (size_t i = 0; i < std::min(size, data.size()); ++i) {
+    if (static_cast<unsigned char>(data[i]) != magic[i]) return false;
+  }
+  return true;
+}
+
+/// Decoded bytes appended to the body at once
+constexpr size_t chunk_size = 16 * 1024;
+
+}  // namespace
+
+struct ContentDecoder::Stream
+{
+  z_stream gzip{};
+  bool gzip_initialized = false;
+  bool ended = false;
+#ifdef SKAD_ZSTD
+  ZSTD_DStream* zstd = nullptr;
+  /// The result of the last `ZSTD_decompressStream`, 0 at the end of a frame
+  size_t zstd_pending = 0;
+#endif
+
+  ~Stream()
+  {
+    if (gzip_initialized) inflateEnd(&gzip);
+#ifdef SKAD_ZSTD
+    if (zstd != nullptr) ZSTD_freeDStream(zstd);
+#endif
+  }
+};
+
+const char* ContentDecoder::accept_encoding()
+{
+#ifdef SKAD_ZSTD
+  return "zstd, gzip";
+#else
+  return "gzip";
+#endif
+}
+
+const char* ContentDecoder::encoding_name(Encoding encoding)
+{
+  switch (encoding) {
+    case Encoding::Unknown:
+      return "unknown";
+    case Encoding::Identity:
+      return "identity";
+    case Encoding::Gzip:
+      return "gzip";
+    case Encoding::Zstd:
+      return "zstd";
+  }
+  return "";
+}
+
+ContentDecoder::ContentDecoder(size_t max_bytes) : _max_bytes(max_bytes), _stream(std::make_unique<Stream>()) {}
+
+ContentDecoder::~ContentDecoder() = default;
+
+bool ContentDecoder::feed(std::string_view data, std::string& body)
+{
+  _received_bytes += data.size();
+  if (_encoding != Encoding::Unknown) return decode(data, body);
+
+  _head.append(data);
+  const bool gzip = starts_with(_head, gzip_magic);
+  bool zstd = starts_with(_head, zstd_magic);
+#ifndef SKAD_ZSTD
+  zstd = false;
+#endif
+
+  // Wait for more, a single byte may be the start of both a magic number and a JSON document
+  if ((gzip and _head.size() < sizeof(gzip_magic)) or (zstd and _head.size() < sizeof(zstd_magic))) return true;
+
+  _encoding = gzip ? Encoding::Gzip : zstd ? Encoding::Zstd : Encoding::Identity;
+  if (_encoding == Encoding::Gzip) {
+    // 16 + the window bits, for a gzip header rather than a zlib one
+    if (inflateInit2(&_stream->gzip, 16 + MAX_WBITS) != Z_OK) throw ExitMessage::Oops("Unable to initialize gzip");
+    _stream->gzip_initialized = true;
+  }
+#ifdef SKAD_ZSTD
+  if (_encoding == Encoding::Zstd) {
+    _stream->zstd = ZSTD_createDStream();
+    if (_stream->zstd == nullptr) throw ExitMessage::Oops("Unable to initialize zstd");
+  }
+#endif
+
+  std::string head = std::move(_head);
+  _head.clear();
+  return decode(head, body);
+}
+
+bool ContentDecoder::decode(std::string_view data, std::string& body)
+{
+  auto within_limit = [this, &body] { return _max_bytes == 0 or body.size() <= _max_bytes; };
+
+  if (_encoding == Encoding::Identity) {
+    body.append(data);
+    return within_limit();
+  }
+
+  // Data past the end of the compressed stream is ignored, as by curl
+  if (_stream->ended) return true;
+
+  char chunk[chunk_size];
+
+  if (_encoding == Encoding::Gzip) {
+    auto& gzip = _stream->gzip;
+    gzip.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    gzip.avail_in = static_cast<uInt>(data.size());
+
+    do {
+      gzip.next_out = reinterpret_cast<Bytef*>(chunk);
+      gzip.avail_out = sizeof(chunk);
+
+      int result = inflate(&gzip, Z_NO_FLUSH);
+      if (result != Z_OK and result != Z_STREAM_END and result != Z_BUF_ERROR) {
+        throw ExitMessage::RemoteAPIFailure("Corrupted gzip response: " +
+                                            std::string(gzip.msg != nullptr ? gzip.msg : zError(result)));
+      }
+
+      body.append(chunk, sizeof(chunk) - gzip.avail_out);
+      if (!within_limit()) return false;
+
+      if (result == Z_STREAM_END) {
+        _stream->ended = true;
+        break;
+      }
+    } while (gzip.avail_out == 0);
+    return true;
+  }
+
+#ifdef SKAD_ZSTD
+  ZSTD_inBuffer input{data.data(), data.size(), 0};
+  while (true) {
+    ZSTD_outBuffer output{chunk, sizeof(chunk), 0};
+
+    size_t result = ZSTD_decompressStream(_stream->zstd, &output, &input);
+    if (ZSTD_isError(result)) {
+      throw ExitMessage::RemoteAPIFailure("Corrupted zstd response: " + std::string(ZSTD_getErrorName(result)));
+    }
+    _stream->zstd_pending = result;
+
+    body.append(chunk, output.pos);
+    if (!within_limit()) return false;
+
+    // Everything given is decoded and nothing is left buffered by zstd
+    if (input.pos == input.size and output.pos < output.size) break;
+  }
+#endif
+  return true;
+}
+
+void ContentDecoder::finish(std::string& body)
+{
+  // A body shorter than a magic number
+  if (_encoding == Encoding::Unknown) {
+    _encoding = Encoding::Identity;
+    body.append(_head);
+    _head.clear();
+    return;
+  }
+
+  if (_encoding == Encoding::Gzip and !_stream->ended) {
+    throw ExitMessage::RemoteAPIFailure("Truncated gzip response");
+  }
+#ifdef SKAD_ZSTD
+  if (_encoding == Encoding::Zstd and _stream->zstd_pending != 0) {
+    throw ExitMessage::RemoteAPIFailure("Truncated zstd response");
+  }
+#endif
+}
+
+}  // namespace fyber
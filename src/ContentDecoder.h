@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace fyber {
+
+/// Decodes the body of a response while it's received: gzip, zstd (when built with `SKAD_ZSTD`) or uncompressed. <br/>
+/// The encoding is told by the first bytes of the body, `Content-Encoding` is only known once the response is complete.
+class ContentDecoder
+{
+ public:
+  enum class Encoding
+  {
+    /// Until the first bytes are received
+    Unknown,
+    Identity,
+    Gzip,
+    Zstd
+  };
+
+ private:
+  /// The state of zlib or zstd
+  struct Stream;
+
+  const size_t _max_bytes;
+  Encoding _encoding = Encoding::Unknown;
+  /// The first bytes of the body, until they tell the encoding
+  std::string _head;
+  size_t _received_bytes = 0;
+  std::unique_ptr<Stream> _stream;
+
+  /// Decode [data] in the known encoding
+  /// \return false once [body] is larger than `max_bytes`
+  bool decode(std::string_view data, std::string& body);
+
+ public:
+  /// The `Accept-Encoding` header of the requests, the encodings that can be decoded
+  static const char* accept_encoding();
+
+  static const char* encoding_name(Encoding encoding);
+
+  /// \param max_bytes the decoded size of the body allowed (unlimited when 0), which bounds compressed bodies too
+  explicit ContentDecoder(size_t max_bytes);
+  ~ContentDecoder();
+
+  ContentDecoder(const ContentDecoder&) = delete;
+  ContentDecoder& operator=(const ContentDecoder&) = delete;
+
+  /// Decode [data], the next bytes of the body, appending them to [body]
+  /// \return false once [body] is larger than `max_bytes`
+  /// \throws RemoteAPIFailure if the body is corrupted
+  bool feed(std::string_view data, std::string& body);
+
+  /// Decode what's left once the whole body is received
+  /// \throws RemoteAPIFailure if the body is truncated
+  void finish(std::string& body);
+
+  [[nodiscard]] Encoding encoding() const { return _encoding; }
+
+  /// Bytes received, before decoding
+  [[nodiscard]] size_t received_bytes() const { return _received_bytes; }
+};
+
+}  // namespace fyber
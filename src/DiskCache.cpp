@@ -0,0 +1,86 @@
+#include "DiskCache.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+#include "FileLock.h"
+#include "Metrics.h"
+#include "common.h"
+#include "exit_message.h"
+#include "logging.h"
+#include "spdlog/spdlog.h"
+
+namespace fyber {
+
+namespace fs = std::filesystem;
+
+DiskCache::DiskCache(const std::string& dir, std::chrono::seconds ttl) : _dir(dir), _ttl(ttl)
+{
+  std::error_code error;
+  fs::create_directories(_dir, error);
+
+  if (error or !fs::is_directory(_dir)) {
+    throw ExitMessage::NotAFile("Provided cache_dir is invalid : " + (error ? error.message() : _dir.string()));
+  }
+}
+
+fs::path DiskCache::entry_path(const std::string& key, const char* extension) const
+{
+  char name[17];
+  std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(common::fnv1a(key)));
+  return _dir / (std::string(name) + extension);
+}
+
+bool DiskCache::is_fresh(const fs::path& path) const
+{
+  std::error_code error;
+  auto modified = fs::last_write_time(path, error);
+  return !error and fs::file_time_type::clock::now() - modified < _ttl;
+}
+
+std::string DiskCache::get_or_fetch(const std::string& key, const std::function<std::string()>& fetch) const
+{
+  const auto path = entry_path(key, ".json");
+
+  // Concurrent processes missing the same key queue here, so only the first one fetches it
+  FileLock lock(entry_path(key, ".lock").string());
+
+  if (is_fresh(path)) {
+    std::ifstream file(path, std::ios::binary);
+    std::string value(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+    if (file.good() or file.eof()) {
+      SKAD_DEBUG("Cache hit for `{}` in `{}`", key, path.string());
+      Metrics::global().increment(Metrics::cache_hits, {{"cache", "disk"}});
+      return value;
+    }
+  }
+
+  Metrics::global().increment(Metrics::cache_misses, {{"cache", "disk"}});
+  auto value = fetch();
+
+  // Written aside and renamed, so readers that don't take the lock never see a partial entry
+  const auto temp_path = entry_path(key, (".tmp." + std::to_string(::getpid())).c_str());
+  bool written;
+  {
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    file.write(value.data(), static_cast<std::streamsize>(value.size()));
+    file.close();
+    written = !file.fail();
+  }
+
+  // A short write (e.g. a full disk) would be served to every process until it expires
+  std::error_code error;
+  if (written) fs::rename(temp_path, path, error);
+  if (!written or error) {
+    SKAD_DEBUG("Unable to store `{}` in the cache : {}", key, written ? error.message() : "write failed");
+    fs::remove(temp_path, error);
+  }
+
+  return value;
+}
+
+}  // namespace fyber
@@ -0,0 +1,37 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <string>
+
+namespace fyber {
+
+/// A cache of responses in a directory shared by concurrent processes, with single-flight semantics: <br/>
+/// the first process to miss a key fetches it while holding the key's lock, the others wait on the lock and then
+/// reuse what it stored instead of fetching it again.
+class DiskCache
+{
+ private:
+  std::filesystem::path _dir;
+  std::chrono::seconds _ttl;
+
+  [[nodiscard]] std::filesystem::path entry_path(const std::string& key, const char* extension) const;
+  [[nodiscard]] bool is_fresh(const std::filesystem::path& path) const;
+
+ public:
+  inline static const std::chrono::seconds default_ttl{300};
+
+  /// \param dir created when missing
+  /// \param ttl how long a stored value is reused
+  /// \throws NotAFile if [dir] can't be created
+  DiskCache(const std::string& dir, std::chrono::seconds ttl = default_ttl);
+
+  /// Get the stored value of [key] if it's fresh, otherwise [fetch] and store it. <br/>
+  /// Nothing is stored when [fetch] throws.
+  std::string get_or_fetch(const std::string& key, const std::function<std::string()>& fetch) const;
+
+  [[nodiscard]] const std::filesystem::path& dir() const { return _dir; }
+  [[nodiscard]] std::chrono::seconds ttl() const { return _ttl; }
+};
+
+}  // namespace fyber
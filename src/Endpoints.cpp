@@ -0,0 +1,159 @@
+#include "Endpoints.h"
+
+#include <algorithm>
+#include <fstream>
+#include <system_error>
+#include <tuple>
+
+#include "FileLock.h"
+#include "common.h"
+#include "exit_message.h"
+
+namespace fyber {
+
+namespace fs = std::filesystem;
+using std::vector;
+
+namespace {
+
+int64_t now_us()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+Endpoints::Endpoints(const string& urls)
+{
+  for (const auto& url : common::split(urls, ',')) {
+    string trimmed(common::trim_view(url));
+    if (trimmed.empty()) continue;
+
+    // A trailing slash would double the one of the paths
+    while (trimmed.size() > 1 and trimmed.back() == '/') trimmed.pop_back();
+    if (std::none_of(_endpoints.begin(), _endpoints.end(), [&](const auto& e) { return e.url == trimmed; })) {
+      _endpoints.push_back(Endpoint{trimmed});
+    }
+  }
+
+  if (_endpoints.empty()) throw ExitMessage::InvalidArguments("No endpoint of the service in `" + urls + "`");
+}
+
+vector<string> Endpoints::urls() const
+{
+  std::lock_guard lock(_mutex);
+  vector<string> urls;
+  for (const auto& endpoint : _endpoints) urls.push_back(endpoint.url);
+  return urls;
+}
+
+void Endpoints::share_through(const string& dir)
+{
+  std::error_code error;
+  fs::create_directories(dir, error);
+  if (error or !fs::is_directory(dir)) {
+    throw ExitMessage::NotAFile("Provided cache_dir is invalid : " + (error ? error.message() : dir));
+  }
+
+  std::lock_guard lock(_mutex);
+  _shared_state = fs::path(dir) / "endpoints";
+
+  FileLock file_lock(_shared_state->string());
+  read_shared_state(nullptr);
+}
+
+void Endpoints::read_shared_state(vector<Endpoint>* others)
+{
+  // One endpoint per line: url latency measured_at failed_at
+  std::ifstream in(_shared_state.value());
+  Endpoint shared;
+  while (in >> shared.url >> shared.latency >> shared.measured_at >> shared.failed_at) {
+    auto found = std::find_if(_endpoints.begin(), _endpoints.end(), [&](const auto& e) { return e.url == shared.url; });
+    if (found != _endpoints.end()) {
+      // The URL is the same, it's left alone for `primary`
+      found->latency = shared.latency;
+      found->measured_at = shared.measured_at;
+      found->failed_at = shared.failed_at;
+    } else if (others != nullptr) {
+      others->push_back(shared);
+    }
+  }
+}
+
+bool Endpoints::measured_within(std::chrono::seconds max_age) const
+{
+  const auto oldest = now_us() - std::chrono::duration_cast<std::chrono::microseconds>(max_age).count();
+
+  std::lock_guard lock(_mutex);
+  return std::all_of(_endpoints.begin(), _endpoints.end(),
+                     [&](const auto& e) { return e.latency >= 0 and e.measured_at > oldest; });
+}
+
+vector<string> Endpoints::ranked() const
+{
+  const auto cooldown_start =
+      now_us() - std::chrono::duration_cast<std::chrono::microseconds>(failure_cooldown).count();
+
+  std::lock_guard lock(_mutex);
+  vector<std::tuple<int, double, size_t>> ranks;
+  for (size_t i = 0; i < _endpoints.size(); ++i) {
+    const auto& endpoint = _endpoints[i];
+    if (endpoint.failed_at > cooldown_start) {
+      ranks.emplace_back(2, static_cast<double>(endpoint.failed_at), i);
+    } else if (endpoint.latency < 0) {
+      ranks.emplace_back(1, 0, i);
+    } else {
+      ranks.emplace_back(0, endpoint.latency, i);
+    }
+  }
+  std::sort(ranks.begin(), ranks.end());
+
+  vector<string> urls;
+  for (const auto& [rank, key, i] : ranks) urls.push_back(_endpoints[i].url);
+  return urls;
+}
+
+void Endpoints::record_latency(const string& url, std::chrono::duration<double> latency)
+{
+  update(url, [&](Endpoint& endpoint) {
+    endpoint.latency =
+        endpoint.latency < 0 ? latency.count() : smoothing * latency.count() + (1 - smoothing) * endpoint.latency;
+    endpoint.measured_at = now_us();
+    endpoint.failed_at = 0;
+  });
+}
+
+void Endpoints::record_failure(const string& url)
+{
+  update(url, [](Endpoint& endpoint) { endpoint.failed_at = now_us(); });
+}
+
+void Endpoints::update(const string& url, const std::function<void(Endpoint&)>& apply)
+{
+  std::lock_guard lock(_mutex);
+  auto found = std::find_if(_endpoints.begin(), _endpoints.end(), [&](const auto& e) { return e.url == url; });
+  if (found == _endpoints.end()) return;
+
+  if (!_shared_state.has_value()) {
+    apply(*found);
+    return;
+  }
+
+  // Other processes wait here, the file is small enough to be rewritten in place. The samples of other processes are
+  // folded in first, and the endpoints of other lists are kept.
+  FileLock file_lock(_shared_state->string());
+  vector<Endpoint> others;
+  read_shared_state(&others);
+  apply(*found);
+
+  std::ofstream out(_shared_state.value(), std::ios::trunc);
+  for (const auto* endpoints : {&_endpoints, &others}) {
+    for (const auto& endpoint : *endpoints) {
+      out << endpoint.url << ' ' << endpoint.latency << ' ' << endpoint.measured_at << ' ' << endpoint.failed_at
+          << '\n';
+    }
+  }
+}
+
+}  // namespace fyber
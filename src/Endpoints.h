@@ -0,0 +1,78 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace fyber {
+
+using std::string;
+
+/// The endpoints of the service, e.g. regional mirrors, ranked by an exponentially weighted moving average of their
+/// latency. Endpoints that failed recently are ranked last. <br/>
+/// The estimates are shared with concurrent and later runs through a file when enabled (see `share_through`).
+class Endpoints
+{
+ public:
+  /// Weight of a new latency sample in the estimate
+  inline static const double smoothing = 0.3;
+  /// How long an endpoint that failed is ranked last
+  inline static const std::chrono::seconds failure_cooldown{60};
+
+ private:
+  /// Times in microseconds since the epoch, so that they can be shared with other processes
+  struct Endpoint
+  {
+    string url;
+    /// Estimated latency in seconds, negative until measured
+    double latency = -1;
+    int64_t measured_at = 0;
+    int64_t failed_at = 0;
+  };
+
+  mutable std::mutex _mutex;
+  std::vector<Endpoint> _endpoints;
+  std::optional<std::filesystem::path> _shared_state;
+
+  /// Apply [apply] to [url], through the shared state when enabled
+  void update(const string& url, const std::function<void(Endpoint&)>& apply);
+
+  /// Read the endpoints of the shared state over `_endpoints`, and the others into [others]
+  void read_shared_state(std::vector<Endpoint>* others);
+
+ public:
+  /// \param urls comma-separated, in the order of preference until measured
+  /// \throws InvalidArguments if there's none
+  explicit Endpoints(const string& urls);
+
+  [[nodiscard]] size_t size() const { return _endpoints.size(); }
+
+  /// The first endpoint given
+  [[nodiscard]] const string& primary() const { return _endpoints.front().url; }
+
+  /// Every URL, in the order given
+  [[nodiscard]] std::vector<string> urls() const;
+
+  /// Share the estimates with the processes using [dir], and reuse the ones stored there
+  /// \throws NotAFile if [dir] can't be created
+  void share_through(const string& dir);
+
+  /// Whether every endpoint was measured less than [max_age] ago
+  [[nodiscard]] bool measured_within(std::chrono::seconds max_age) const;
+
+  /// The URLs to send a request to, in order: the healthy ones by estimated latency (the unmeasured ones last, in the
+  /// order given), then the ones that failed recently, the oldest failure first
+  [[nodiscard]] std::vector<string> ranked() const;
+
+  /// Add a [latency] sample to the estimate of [url], which is then healthy
+  void record_latency(const string& url, std::chrono::duration<double> latency);
+
+  /// Rank [url] last for `failure_cooldown`
+  void record_failure(const string& url);
+};
+
+}  // namespace fyber
@@ -0,0 +1,42 @@
+#include "FileLock.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "exit_message.h"
+#include "logging.h"
+#include "spdlog/spdlog.h"
+
+namespace fyber {
+
+FileLock::FileLock(const std::string& path, bool create)
+{
+  _fd = ::open(path.c_str(), create ? O_RDONLY | O_CREAT | O_CLOEXEC : O_RDONLY | O_CLOEXEC, 0644);
+  if (_fd < 0) {
+    throw ExitMessage::NotAFile("Unable to open `" + path + "` for locking : " + std::strerror(errno));
+  }
+
+  if (::flock(_fd, LOCK_EX | LOCK_NB) == 0) return;
+
+  SKAD_DEBUG("Waiting for the lock on `{}`", path);
+
+  while (::flock(_fd, LOCK_EX) != 0) {
+    if (errno == EINTR) continue;
+
+    int error = errno;
+    ::close(_fd);
+    throw ExitMessage::NotAFile("Unable to lock `" + path + "` : " + std::strerror(error));
+  }
+}
+
+FileLock::~FileLock()
+{
+  // Closing the last descriptor of the file releases the lock
+  ::close(_fd);
+}
+
+}  // namespace fyber
@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+
+namespace fyber {
+
+/// An advisory, exclusive `flock` on a file, held for the lifetime of the object. <br/>
+/// Serializes the processes that lock the same file; the lock is released by the system if the process dies.
+class FileLock
+{
+ private:
+  int _fd = -1;
+
+ public:
+  /// Block until the lock on [path] is acquired.
+  /// \param create whether to create [path] when missing
+  /// \throws NotAFile if [path] can't be opened or locked
+  explicit FileLock(const std::string& path, bool create = true);
+  ~FileLock();
+
+  FileLock(const FileLock&) = delete;
+  FileLock& operator=(const FileLock&) = delete;
+};
+
+}  // namespace fyber
@@ -0,0 +1,166 @@
+#include "Limits.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "common.h"
+#include "exit_message.h"
+
+namespace fyber {
+
+Limits& Limits::global()
+{
+  static Limits limits;
+  return limits;
+}
+
+size_t Limits::parse_size(const string& parameter, const string& text)
+{
+  size_t multiplier = 1;
+  string digits = text;
+  if (!digits.empty()) {
+    switch (digits.back()) {
+      case 'K':
+        multiplier = 1024;
+        break;
+      case 'M':
+        multiplier = 1024 * 1024;
+        break;
+      case 'G':
+        multiplier = 1024 * 1024 * 1024;
+        break;
+    }
+    if (multiplier != 1) digits.pop_back();
+  }
+
+  if (!common::is_integer(digits) or digits.size() > 12) {
+    throw ExitMessage::InvalidArguments("`" + parameter + "` must be a number of bytes, as `<n>[K|M|G]`, not `" + text +
+                                        "`");
+  }
+
+  const auto value = std::stoull(digits);
+  if (value > SIZE_MAX / multiplier) {
+    throw ExitMessage::InvalidArguments("`" + parameter + "` is too large, `" + text + "` bytes don't fit in memory");
+  }
+  return value * multiplier;
+}
+
+size_t Limits::xml_depth(std::string_view xml)
+{
+  size_t depth = 0;
+  size_t max_depth = 0;
+
+  // Skips past [end], or to the end of the document
+  auto skip_past = [&xml](size_t from, std::string_view end) {
+    auto found = xml.find(end, from);
+    return found == std::string_view::npos ? xml.size() : found + end.size();
+  };
+
+  size_t i = xml.find('<');
+  while (i < xml.size()) {
+    if (xml.compare(i, 4, "<!--") == 0) {
+      i = skip_past(i + 4, "-->");
+    } else if (xml.compare(i, 9, "<![CDATA[") == 0) {
+      i = skip_past(i + 9, "]]>");
+    } else if (xml.compare(i, 2, "<?") == 0) {
+      i = skip_past(i + 2, "?>");
+    } else if (xml.compare(i, 2, "<!") == 0) {
+      // A DOCTYPE, with its internal subset
+      size_t brackets = 0;
+      for (i += 2; i < xml.size() and (xml[i] != '>' or brackets > 0); ++i) {
+        if (xml[i] == '[') brackets++;
+        if (xml[i] == ']' and brackets > 0) brackets--;
+      }
+      i++;
+    } else {
+      const bool closing = xml.compare(i, 2, "</") == 0;
+
+      // The end of the tag, attribute values may contain `>`
+      char quote = 0;
+      for (++i; i < xml.size() and (quote != 0 or xml[i] != '>'); ++i) {
+        if (quote != 0 and xml[i] == quote) {
+          quote = 0;
+        } else if (quote == 0 and (xml[i] == '"' or xml[i] == '\'')) {
+          quote = xml[i];
+        }
+      }
+      const bool self_closing = i < xml.size() and xml[i - 1] == '/';
+      i++;
+
+      if (closing) {
+        if (depth > 0) depth--;
+      } else if (!self_closing) {
+        max_depth = std::max(max_depth, ++depth);
+      } else {
+        max_depth = std::max(max_depth, depth + 1);
+      }
+    }
+    i = std::min(xml.find('<', std::min(i, xml.size())), xml.size());
+  }
+
+  return max_depth;
+}
+
+//------------------- Deadline -----------------------------------------------
+
+Deadline::Deadline(const char* phase, std::chrono::steady_clock::duration limit) : _phase(phase), _limit(limit) {}
+
+bool Deadline::expired() const
+{
+  return _limit.count() > 0 and std::chrono::steady_clock::now() - _start >= _limit;
+}
+
+std::chrono::milliseconds Deadline::remaining() const
+{
+  using std::chrono::milliseconds;
+  if (_limit.count() == 0) return milliseconds(0);
+
+  auto left = std::chrono::duration_cast<milliseconds>(_limit - (std::chrono::steady_clock::now() - _start));
+  return std::max(left, milliseconds(1));
+}
+
+void Deadline::check() const
+{
+  if (!expired()) return;
+
+  throw ExitMessage::DeadlineExceeded(string("Deadline exceeded ") + _phase + ", after " +
+                                      std::to_string(std::chrono::duration_cast<std::chrono::seconds>(_limit).count()) +
+                                      "s (see `phase_deadline`)");
+}
+
+//------------------- BoundedStreambuf -----------------------------------------------
+
+BoundedStreambuf::BoundedStreambuf(std::streambuf* source, size_t max_bytes, const Deadline* deadline)
+    : _source(source), _remaining(max_bytes), _limited(max_bytes > 0), _deadline(deadline)
+{
+}
+
+BoundedStreambuf::int_type BoundedStreambuf::underflow()
+{
+  if (_exceeded or _expired) return traits_type::eof();
+
+  if (_deadline != nullptr and _deadline->expired()) {
+    _expired = true;
+    return traits_type::eof();
+  }
+
+  // One byte past the limit tells a source of exactly [max_bytes] from a larger one
+  auto wanted = static_cast<std::streamsize>(sizeof(_buffer));
+  if (_limited) wanted = std::min(wanted, static_cast<std::streamsize>(_remaining) + 1);
+
+  auto read = _source->sgetn(_buffer, wanted);
+  if (read <= 0) return traits_type::eof();
+
+  if (_limited) {
+    if (static_cast<size_t>(read) > _remaining) {
+      _exceeded = true;
+      return traits_type::eof();
+    }
+    _remaining -= static_cast<size_t>(read);
+  }
+
+  setg(_buffer, _buffer, _buffer + read);
+  return traits_type::to_int_type(_buffer[0]);
+}
+
+}  // namespace fyber
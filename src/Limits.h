@@ -0,0 +1,82 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <streambuf>
+#include <string>
+#include <string_view>
+
+namespace fyber {
+
+using std::string;
+
+/// Bounds on the inputs of a run and on the responses of the service, 0 meaning unlimited. <br/>
+/// Breaching one fails the plist with the exit code of the limit (e.g. `PlistTooLarge`).
+struct Limits
+{
+  size_t max_plist_bytes = 64 * 1024 * 1024;
+  size_t max_podfile_bytes = 16 * 1024 * 1024;
+  size_t max_response_bytes = 64 * 1024 * 1024;
+  size_t max_xml_depth = 256;
+  size_t max_ids_per_network = 10000;
+  /// Wall-clock time allowed to read and parse a plist or a Podfile, and to get a response from the service
+  std::chrono::seconds phase_deadline{300};
+
+  /// The limits of the process, set from the command line
+  static Limits& global();
+
+  /// Parse `<n>[K|M|G]`, a number of bytes
+  /// \throws InvalidArguments if [text] isn't a size
+  static size_t parse_size(const string& parameter, const string& text);
+
+  /// The nesting depth of the elements of the XML document [xml], without parsing it
+  static size_t xml_depth(std::string_view xml);
+};
+
+/// The deadline of a phase of a run, `Limits::phase_deadline` from its creation
+class Deadline
+{
+ private:
+  const char* _phase;
+  std::chrono::steady_clock::duration _limit;
+  std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+
+ public:
+  /// \param phase named in the error, e.g. `reading the plist`
+  explicit Deadline(const char* phase, std::chrono::steady_clock::duration limit = Limits::global().phase_deadline);
+
+  [[nodiscard]] bool expired() const;
+
+  /// The time left, at least 1ms, or 0 when unlimited (as for curl timeouts)
+  [[nodiscard]] std::chrono::milliseconds remaining() const;
+
+  /// \throws DeadlineExceeded if expired
+  void check() const;
+};
+
+/// A stream buffer reading [source] up to [max_bytes] (unlimited when 0) and until [deadline], whichever comes first.
+/// <br/> Reads end early instead of buffering past the limits, see `exceeded` and `expired`.
+class BoundedStreambuf : public std::streambuf
+{
+ private:
+  std::streambuf* _source;
+  size_t _remaining;
+  const bool _limited;
+  const Deadline* _deadline;
+  bool _exceeded = false;
+  bool _expired = false;
+  char _buffer[64 * 1024];
+
+ protected:
+  int_type underflow() override;
+
+ public:
+  BoundedStreambuf(std::streambuf* source, size_t max_bytes, const Deadline* deadline = nullptr);
+
+  /// Whether [source] has more than [max_bytes]
+  [[nodiscard]] bool exceeded() const { return _exceeded; }
+
+  /// Whether the deadline expired before the end of [source]
+  [[nodiscard]] bool expired() const { return _expired; }
+};
+
+}  // namespace fyber
@@ -1,12 +1,25 @@
 #include "ManagerApi.h"
 
 #include <cpr/cpr.h>
+#include <curl/curl.h>
 
+#include <algorithm>
+#include <future>
+#include <mutex>
 #include <optional>
 #include <tuple>
 
+#include "AllocStats.h"
+#include "ContentDecoder.h"
+#include "FileLock.h"
+#include "Limits.h"
+#include "Metrics.h"
+#include "RateLimiter.h"
+#include "Trace.h"
 #include "common.h"
+#include "embedded_catalog.h"
 #include "exit_message.h"
+#include "logging.h"
 #include "rapidjson/document.h"
 #include "spdlog/spdlog.h"
 
@@ -14,28 +27,338 @@ namespace fyber {
 using std::optional;
 using std::tuple;
 
-ManagerApi::ManagerApi(string url) : API_URL(std::move(url))
+namespace {
+
+/// rapidjson's `CrtAllocator`, with the allocations accounted by `alloc_stats`
+struct JsonAllocator
+{
+  static const bool kNeedFree = true;
+  void* Malloc(size_t size) { return size == 0 ? nullptr : memory::alloc_stats::malloc(size); }
+  void* Realloc(void* ptr, size_t, size_t new_size)
+  {
+    if (new_size == 0) {
+      memory::alloc_stats::free(ptr);
+      return nullptr;
+    }
+    return memory::alloc_stats::realloc(ptr, new_size);
+  }
+  static void Free(void* ptr) { memory::alloc_stats::free(ptr); }
+};
+
+using JsonDocument =
+    rapidjson::GenericDocument<rapidjson::UTF8<>, rapidjson::MemoryPoolAllocator<JsonAllocator>, JsonAllocator>;
+
+const int max_retries = 3;
+const std::chrono::seconds max_retry_after{60};
+
+/// How long to wait before retrying the request that got [response], if it has to be retried. <br/>
+/// Throttling responses are retried: `429 Too Many Requests`, and server errors with a `Retry-After` in seconds.
+/// \param attempt the number of retries so far
+optional<std::chrono::milliseconds> retry_delay(cpr::Response& response, int attempt)
+{
+  if (response.error or attempt >= max_retries) return std::nullopt;
+  if (response.status_code != 429 and response.status_code < 500) return std::nullopt;
+
+  auto retry_after = response.header["Retry-After"];
+  if (!retry_after.empty() and common::is_integer(retry_after)) {
+    auto delay = std::chrono::seconds(std::stol(retry_after));
+    // Better fail than hang for that long
+    if (delay > max_retry_after) return std::nullopt;
+    return delay;
+  }
+
+  if (response.status_code == 429) return std::chrono::milliseconds(500) * (1 << attempt);
+  return std::nullopt;
+}
+
+/// Initialize curl, and TLS with it, on the first request. Runs answered by the disk cache or the embedded catalog,
+/// and `--help`, never pay for it.
+void init_curl()
+{
+  static std::once_flag initialized;
+  std::call_once(initialized, [] {
+    if constexpr (memory::alloc_stats::compiled) {
+      memory::alloc_stats::install_curl_hooks();
+    } else {
+      curl_global_init(CURL_GLOBAL_DEFAULT);
+    }
+  });
+}
+
+/// Send a request to [endpoint] with [perform], retrying throttled ones until [deadline], and receive its body through
+/// the limits
+/// \param perform performs the request with the given headers, body callback and timeout
+/// \return response body, decoded
+template <typename Perform>
+string send(const string& endpoint, bool compression, const Deadline& deadline, Perform perform)
+{
+  memory::PhaseScope phase(memory::Phase::Http);
+  init_curl();
+
+  auto& limiter = RateLimiter::for_host(RateLimiter::host_of(endpoint));
+  const auto max_bytes = Limits::global().max_response_bytes;
+
+  cpr::Header headers;
+  if (compression) headers["Accept-Encoding"] = ContentDecoder::accept_encoding();
+
+  // Exported even when nothing is retried, so dashboards can rely on the series
+  Metrics::global().increment(Metrics::http_retries, {}, 0);
+
+  cpr::Response r;
+  for (int attempt = 0;; ++attempt) {
+    // The body is decoded as it's received and through the limit, a runaway response is aborted instead of buffered
+    string body;
+    ContentDecoder decoder(max_bytes);
+    bool too_large = false;
+    cpr::WriteCallback receive([&body, &decoder, &too_large](std::string data) {
+      too_large = !decoder.feed(data, body);
+      return !too_large;
+    });
+
+    {
+      auto permit = limiter.acquire();
+      deadline.check();
+      Stopwatch stopwatch;
+      r = perform(headers, receive, cpr::Timeout{deadline.remaining()});
+      Metrics::global().observe(Metrics::http_request_seconds, {{"endpoint", endpoint.substr(endpoint.rfind('/'))}},
+                                stopwatch.elapsed());
+    }
+    Metrics::global().increment(Metrics::response_bytes,
+                                {{"encoding", ContentDecoder::encoding_name(decoder.encoding())}},
+                                static_cast<double>(decoder.received_bytes()));
+
+    if (too_large) {
+      throw ExitMessage::ResponseTooLarge("The response of '" + endpoint + "' is larger than " +
+                                          std::to_string(max_bytes) + " bytes (see `max_response_size`)");
+    }
+    if (r.error) deadline.check();
+    if (!r.error) decoder.finish(body);
+    r.text = std::move(body);
+
+    SKAD_DEBUG("{} Returned ({}, {} bytes {}) : {}", endpoint, r.status_code, decoder.received_bytes(),
+               ContentDecoder::encoding_name(decoder.encoding()), r.text);
+
+    auto delay = retry_delay(r, attempt);
+    if (!delay.has_value()) break;
+
+    // Every request to the host waits, not only this one
+    spdlog::warn("{} is throttling ({}), retrying in {}ms", endpoint, r.status_line, delay->count());
+    limiter.back_off(delay.value());
+    Metrics::global().increment(Metrics::http_retries);
+  }
+
+  if (r.error) {
+    throw ExitMessage::RemoteAPIFailure("API failure for '" + endpoint + "': " + r.error.message);
+  }
+
+  if (r.status_code != 200) {
+    throw ExitMessage::ServerUnavailable("Connection to '" + endpoint + "' failed (" + r.status_line + ") : " + r.text);
+  }
+
+  return r.text;
+}
+
+}  // namespace
+
+ManagerApi::ManagerApi(const string& url) : _endpoints(url), API_URL(_endpoints.primary())
+{
+  SKAD_DEBUG("Remote set to {}", common::join(_endpoints.urls(), ", "));
+}
+
+void ManagerApi::use_disk_cache(const string& dir, std::chrono::seconds ttl)
+{
+  _disk_cache.emplace(dir, ttl);
+  if (_endpoints.size() > 1) _endpoints.share_through(dir);
+  SKAD_DEBUG("Caching responses in `{}` for {}s", dir, ttl.count());
+}
+
+void ManagerApi::use_embedded_catalog(EmbeddedCatalogUse use)
+{
+  _embedded_catalog = use;
+  SKAD_DEBUG("Embedded catalog of {} networks used {}", embedded_catalog::size(),
+             use == EmbeddedCatalogUse::Always      ? "always"
+             : use == EmbeddedCatalogUse::OnFailure ? "on failure"
+                                                    : "never");
+}
+
+void ManagerApi::use_compression(bool compression)
+{
+  _compression = compression;
+}
+
+void ManagerApi::use_post_queries(bool post_queries)
+{
+  _post_queries = post_queries;
+}
+
+void ManagerApi::use_catalog_sync(bool catalog_sync)
 {
-  spdlog::debug("Remote set to {}", API_URL);
+  _catalog_sync = catalog_sync;
+}
+
+const char* ManagerApi::source_name(ResponseSource source)
+{
+  switch (source) {
+    case ResponseSource::Server:
+      return "server";
+    case ResponseSource::MemoryCache:
+      return "memory";
+    case ResponseSource::DiskCache:
+      return "disk";
+    case ResponseSource::Embedded:
+      return "embedded";
+  }
+  return "";
 }
 
-vector<string> ManagerApi::get_networks() const
+ResponseSource ManagerApi::source_by_name(const string& name)
 {
-  auto response = GET_request(API_URL + "/networks", std::nullopt);
-  vector<string> networks = parse_networks_response(response.c_str());
+  for (auto source :
+       {ResponseSource::Server, ResponseSource::MemoryCache, ResponseSource::DiskCache, ResponseSource::Embedded}) {
+    if (name == source_name(source)) return source;
+  }
+
+  throw ExitMessage::InvalidArguments("Unknown response source `" + name + "`");
+}
+
+string ManagerApi::fetch(const string& key, const std::function<string()>& request, ResponseSource& source) const
+{
+  source = ResponseSource::Server;
+  if (!_disk_cache.has_value()) return request();
+
+  source = ResponseSource::DiskCache;
+  return _disk_cache->get_or_fetch(key, [&] {
+    source = ResponseSource::Server;
+    return request();
+  });
+}
+
+vector<Symbol> ManagerApi::get_networks() const
+{
+  std::promise<vector<Symbol>> fetched;
+  std::shared_future<vector<Symbol>> pending;
+  {
+    std::lock_guard lock(_cache_mutex);
+    if (_networks_cache.has_value()) {
+      pending = _networks_cache.value();
+    } else {
+      _networks_cache = fetched.get_future().share();
+    }
+  }
+
+  if (pending.valid()) {
+    Metrics::global().increment(Metrics::cache_hits, {{"cache", "memory"}});
+    return pending.get();
+  }
+  Metrics::global().increment(Metrics::cache_misses, {{"cache", "memory"}});
 
-  spdlog::debug("Returned networks: {} ", common::join(networks, ","));
+  try {
+    auto networks = fetch_networks();
+    fetched.set_value(networks);
+    return networks;
+  } catch (...) {
+    // Failures aren't cached, the callers waiting for this fetch get it and the next ones fetch again
+    {
+      std::lock_guard lock(_cache_mutex);
+      _networks_cache.reset();
+    }
+    fetched.set_exception(std::current_exception());
+    throw;
+  }
+}
+
+vector<Symbol> ManagerApi::fetch_networks() const
+{
+  vector<Symbol> networks;
+  try {
+    if (_embedded_catalog == EmbeddedCatalogUse::Always) {
+      networks = embedded_catalog::networks();
+    } else if (_catalog_sync) {
+      ResponseSource source;
+      networks = synced_catalog(source).networks();
+    } else {
+      ResponseSource source;
+      auto response = fetch(
+          API_URL + "/networks", [&] { return GET_request("/networks", std::nullopt); }, source);
+      networks = parse_networks_response(response.c_str());
+    }
+  } catch (const ExitMessage& failure) {
+    if (!falls_back_on(failure)) throw;
+    networks = embedded_catalog::networks();
+  }
 
+  SKAD_DEBUG("Returned networks: {} ", common::join(networks, ","));
   return networks;
 }
 
+CatalogStore::Update ManagerApi::sync_catalog(CatalogStore& store, CatalogStore::Delta* delta) const
+{
+  optional<tuple<string, string>> since;
+  if (!store.empty()) since = std::make_tuple("since", std::to_string(store.version()));
+
+  auto response = GET_request("/catalog", since);
+
+  memory::PhaseScope phase(memory::Phase::JsonParse);
+  return store.apply_response(response, delta);
+}
+
+const CatalogStore& ManagerApi::synced_catalog(ResponseSource& source) const
+{
+  // A single catalog: the callers needing it while it's synced wait for that sync
+  std::lock_guard lock(_catalog_mutex);
+  if (_catalog.has_value()) {
+    source = ResponseSource::MemoryCache;
+    return _catalog.value();
+  }
+
+  CatalogStore store;
+  source = ResponseSource::Server;
+  if (!_disk_cache.has_value()) {
+    sync_catalog(store);
+  } else {
+    const auto& dir = _disk_cache->dir();
+    // Concurrent processes queue here, so only the first one syncs
+    FileLock lock((dir / "catalog.lock").string());
+
+    store = CatalogStore::load(dir);
+    if (!store.empty() and CatalogStore::is_fresh(dir, _disk_cache->ttl())) {
+      Metrics::global().increment(Metrics::cache_hits, {{"cache", "disk"}});
+      source = ResponseSource::DiskCache;
+    } else {
+      Metrics::global().increment(Metrics::cache_misses, {{"cache", "disk"}});
+      CatalogStore::Delta delta;
+      auto update = sync_catalog(store, &delta);
+      store.save(dir, update, delta);
+    }
+  }
+
+  _catalog = std::move(store);
+  return _catalog.value();
+}
+
+bool ManagerApi::falls_back_on(const ExitMessage& failure) const
+{
+  if (_embedded_catalog != EmbeddedCatalogUse::OnFailure) return false;
+
+  // Invalid responses aren't covered, the service is up and something has to be fixed
+  if (failure.code != ExitMessage::ServerUnavailable("").code and
+      failure.code != ExitMessage::RemoteAPIFailure("").code) {
+    return false;
+  }
+
+  spdlog::warn("Using the embedded catalog: {}", failure.what());
+  Metrics::global().increment(Metrics::embedded_catalog_fallbacks, {});
+  return true;
+}
+
 /// Parses a response with this format:
 ///\code  {"networks": [AdColony, Google-Mobile-Ads-SDK, AppLovinSDK, ... ]}
-vector<string> ManagerApi::parse_networks_response(const char* body)
+vector<Symbol> ManagerApi::parse_networks_response(const char* body)
 {
-  vector<string> networks;
+  memory::PhaseScope phase(memory::Phase::JsonParse);
+  vector<Symbol> networks;
 
-  rapidjson::Document doc;
+  JsonDocument doc;
   doc.Parse(body);
 
   if (doc.HasParseError()) {
@@ -44,7 +367,7 @@ vector<string> ManagerApi::parse_networks_response(const char* body)
 
   try {
     for (auto& network : doc["networks"].GetArray()) {
-      networks.emplace_back(network.GetString());
+      networks.emplace_back(std::string_view(network.GetString(), network.GetStringLength()));
     }
   } catch (std::exception& ex) {
     throw ExitMessage::InvalidNetworks("Networks parsing error: " + string(ex.what()));
@@ -53,18 +376,97 @@ vector<string> ManagerApi::parse_networks_response(const char* body)
   return networks;
 }
 
-map<string, vector<string>> ManagerApi::get_sk_ad_networks(const vector<string>& networks) const
+map<Symbol, vector<Symbol>> ManagerApi::get_sk_ad_networks(const vector<Symbol>& networks, ResponseSource* source) const
 {
   const string& req_networks_str = common::join(networks, ",");
-  auto response = GET_request(API_URL + "/plist", std::make_tuple("network_list", req_networks_str));
 
-  map<string, vector<string>> sk_ad_networks = parse_plist_response(response.c_str());
+  std::promise<map<Symbol, vector<Symbol>>> fetched;
+  std::shared_future<map<Symbol, vector<Symbol>>> pending;
+  {
+    std::lock_guard lock(_cache_mutex);
+    auto [cached, inserted] = _sk_ad_networks_cache.try_emplace(req_networks_str);
+    if (inserted) {
+      cached->second = fetched.get_future().share();
+    } else {
+      pending = cached->second;
+    }
+  }
+
+  if (pending.valid()) {
+    Metrics::global().increment(Metrics::cache_hits, {{"cache", "memory"}});
+    auto sk_ad_networks = pending.get();
+    if (source != nullptr) *source = ResponseSource::MemoryCache;
+    return sk_ad_networks;
+  }
+  Metrics::global().increment(Metrics::cache_misses, {{"cache", "memory"}});
 
-  log_sk_ad_networks(sk_ad_networks);
+  try {
+    ResponseSource served_from;
+    auto sk_ad_networks = fetch_sk_ad_networks(networks, served_from);
+    fetched.set_value(sk_ad_networks);
+    if (source != nullptr) *source = served_from;
+    return sk_ad_networks;
+  } catch (...) {
+    // Failures aren't cached, the callers waiting for this fetch get it and the next ones fetch again
+    {
+      std::lock_guard lock(_cache_mutex);
+      _sk_ad_networks_cache.erase(req_networks_str);
+    }
+    fetched.set_exception(std::current_exception());
+    throw;
+  }
+}
 
+map<Symbol, vector<Symbol>> ManagerApi::fetch_sk_ad_networks(const vector<Symbol>& networks,
+                                                             ResponseSource& served_from) const
+{
+  const string& req_networks_str = common::join(networks, ",");
+
+  served_from = ResponseSource::Embedded;
+  map<Symbol, vector<Symbol>> sk_ad_networks;
+  try {
+    if (_embedded_catalog == EmbeddedCatalogUse::Always) {
+      sk_ad_networks = embedded_catalog::sk_ad_networks(networks);
+    } else if (_catalog_sync) {
+      sk_ad_networks = synced_catalog(served_from).sk_ad_networks(networks);
+    } else {
+      const auto endpoint = API_URL + "/plist";
+      string response;
+      if (_post_queries) {
+        // The same names in any order get the same response, from the disk cache as well
+        vector<string> names;
+        for (const auto& network : networks) names.push_back(network.str());
+        std::sort(names.begin(), names.end());
+        names.erase(std::unique(names.begin(), names.end()), names.end());
+
+        response = fetch(
+            endpoint + "?network_list=" + common::join(names, ","),
+            [&] { return POST_request("/plist", common::join(names, "\n")); }, served_from);
+      } else {
+        response = fetch(
+            endpoint + "?network_list=" + req_networks_str,
+            [&] { return GET_request("/plist", std::make_tuple("network_list", req_networks_str)); }, served_from);
+      }
+      sk_ad_networks = parse_plist_response(response.c_str());
+    }
+  } catch (const ExitMessage& failure) {
+    if (!falls_back_on(failure)) throw;
+    served_from = ResponseSource::Embedded;
+    sk_ad_networks = embedded_catalog::sk_ad_networks(networks);
+  }
+
+  log_sk_ad_networks(sk_ad_networks);
   return sk_ad_networks;
 }
 
+std::future<map<Symbol, vector<Symbol>>> ManagerApi::get_sk_ad_networks_async(
+    std::shared_future<vector<Symbol>> networks, ResponseSource* source) const
+{
+  return std::async(std::launch::async, [this, networks = std::move(networks), source] {
+    return get_sk_ad_networks(networks.get(), source);
+  });
+}
+
 /// Parses a response with this format:
 ///\code
 /// {
@@ -72,12 +474,13 @@ map<string, vector<string>> ManagerApi::get_sk_ad_networks(const vector<string>&
 ///         "Google-Mobile-Ads-SDK": ["cstr6suwn9"], "Applovin":
 ///         ["ludvb6z3bs"], "Unknown_network": []
 /// }
-map<string, vector<string>> ManagerApi::parse_plist_response(const char* body)
+map<Symbol, vector<Symbol>> ManagerApi::parse_plist_response(const char* body)
 {
+  memory::PhaseScope phase(memory::Phase::JsonParse);
+  map<Symbol, vector<Symbol>> sdk_ad_networks;
+  const auto max_ids = Limits::global().max_ids_per_network;
 
-  map<string, vector<string>> sdk_ad_networks;
-
-  rapidjson::Document doc;
+  JsonDocument doc;
   doc.Parse(body);
 
   if (doc.HasParseError()) {
@@ -86,15 +489,22 @@ map<string, vector<string>> ManagerApi::parse_plist_response(const char* body)
 
   try {
     for (auto& network : doc.GetObject()) {
-      const char* network_name = network.name.GetString();
+      Symbol network_name(std::string_view(network.name.GetString(), network.name.GetStringLength()));
+      if (max_ids > 0 and network.value.GetArray().Size() > max_ids) {
+        throw ExitMessage::TooManyIds("The service returned " + std::to_string(network.value.GetArray().Size()) +
+                                      " IDs for " + network_name.str() + ", more than " + std::to_string(max_ids) +
+                                      " (see `max_ids_per_network`)");
+      }
 
-      vector<string> network_values;
+      vector<Symbol> network_values;
       for (auto& v : network.value.GetArray()) {
-        network_values.emplace_back(v.GetString());
+        network_values.emplace_back(std::string_view(v.GetString(), v.GetStringLength()));
       }
 
-      sdk_ad_networks.emplace(network_name, network_values);
+      sdk_ad_networks.emplace(network_name, std::move(network_values));
     }
+  } catch (const ExitMessage&) {
+    throw;
   } catch (std::exception& ex) {
     throw ExitMessage::InvalidNetworks("SKAdNetworks parsing error: " + string(ex.what()));
   }
@@ -102,12 +512,12 @@ map<string, vector<string>> ManagerApi::parse_plist_response(const char* body)
   return sdk_ad_networks;
 }
 
-/// Perform a GET request to [[endpoint]] with a single optional parameter [[param]]
-/// \param endpoint
+/// Perform a GET request to [[path]] with a single optional parameter [[param]]
+/// \param path
 /// \param param
 /// \return response body
 /// \throws
-string ManagerApi::GET_request(const string& endpoint, optional<tuple<string, string>> param)
+string ManagerApi::GET_request(const string& path, const optional<tuple<string, string>>& param) const
 {
   cpr::Parameters parameters;
   if (param.has_value()) {
@@ -115,30 +525,99 @@ string ManagerApi::GET_request(const string& endpoint, optional<tuple<string, st
     parameters = cpr::Parameters{{key.c_str(), value.c_str()}};
   }
 
-  cpr::Response r = cpr::Get(cpr::Url{endpoint}, parameters);
+  Trace::Span span("GET " + path);
+  return request(path, [&](const string& endpoint, const Deadline& deadline) {
+    return send(endpoint, _compression, deadline, [&](const auto& headers, const auto& receive, const auto& timeout) {
+      return cpr::Get(cpr::Url{endpoint}, parameters, headers, receive, timeout);
+    });
+  });
+}
 
-  spdlog::debug("{} Returned ({}) : {}", endpoint, r.status_code, r.text);
+string ManagerApi::POST_request(const string& path, const string& body) const
+{
+  Trace::Span span("POST " + path);
+  return request(path, [&](const string& endpoint, const Deadline& deadline) {
+    return send(endpoint, _compression, deadline, [&](cpr::Header headers, const auto& receive, const auto& timeout) {
+      headers["Content-Type"] = "text/plain";
+      return cpr::Post(cpr::Url{endpoint}, headers, cpr::Body{body}, receive, timeout);
+    });
+  });
+}
 
-  if (r.error) {
-    throw ExitMessage::RemoteAPIFailure("API failure for '" + endpoint + "': " + r.error.message);
+string ManagerApi::request(const string& path,
+                           const std::function<string(const string& url, const Deadline& deadline)>& send_to) const
+{
+  // Retries, throttling and failovers included
+  Deadline deadline("waiting for the service");
+  if (_endpoints.size() == 1) return send_to(API_URL + path, deadline);
+
+  std::call_once(_endpoints_probed, [this] { probe_endpoints(); });
+
+  const auto urls = _endpoints.ranked();
+  for (size_t i = 0;; ++i) {
+    Stopwatch stopwatch;
+    try {
+      auto body = send_to(urls[i] + path, deadline);
+      _endpoints.record_latency(urls[i], stopwatch.elapsed());
+      return body;
+    } catch (const ExitMessage& failure) {
+      // Other failures would be the same on every endpoint, or leave no time for another one
+      if (failure.code != ExitMessage::ServerUnavailable("").code and
+          failure.code != ExitMessage::RemoteAPIFailure("").code) {
+        throw;
+      }
+
+      _endpoints.record_failure(urls[i]);
+      if (i + 1 == urls.size()) throw;
+
+      spdlog::warn("{} failed, failing over to {}: {}", urls[i], urls[i + 1], failure.what());
+      Metrics::global().increment(Metrics::endpoint_failovers, {{"endpoint", urls[i]}});
+    }
   }
+}
 
-  if (r.status_code != 200) {
-    throw ExitMessage::ServerUnavailable("Connection to '" + endpoint + "' failed (" + r.status_line + ") : " + r.text);
+void ManagerApi::probe_endpoints() const
+{
+  if (_endpoints.measured_within(_disk_cache.has_value() ? _disk_cache->ttl() : DiskCache::default_ttl)) return;
+
+  memory::PhaseScope phase(memory::Phase::Http);
+  init_curl();
+
+  // Outside of the rate limits, a single small request per endpoint
+  vector<std::future<void>> probes;
+  for (const auto& url : _endpoints.urls()) {
+    probes.push_back(std::async(std::launch::async, [this, url] {
+      Stopwatch stopwatch;
+      auto r = cpr::Get(cpr::Url{url + "/networks"}, cpr::Timeout{probe_timeout});
+      auto elapsed = stopwatch.elapsed();
+
+      if (!r.error and r.status_code == 200) {
+        _endpoints.record_latency(url, elapsed);
+      } else if (elapsed >= probe_timeout) {
+        // Slow rather than failed
+        _endpoints.record_latency(url, probe_timeout);
+      } else {
+        _endpoints.record_failure(url);
+      }
+      SKAD_DEBUG("Probed {} in {:.1f}ms ({})", url, elapsed.count() * 1000, r.error ? r.error.message : r.status_line);
+    }));
   }
+  for (auto& probe : probes) probe.get();
 
-  return r.text;
+  SKAD_DEBUG("Endpoints by latency: {}", common::join(_endpoints.ranked(), ", "));
 }
 
-void ManagerApi::log_sk_ad_networks(const map<string, vector<string>>& sk_ad_networks)
+void ManagerApi::log_sk_ad_networks(const map<Symbol, vector<Symbol>>& sk_ad_networks)
 {
+  if (!logging::debug_enabled()) return;
+
   string sk_ad_networks_str = "{";
   for (auto& [network_name, values] : sk_ad_networks) {
-    sk_ad_networks_str += network_name + ": [" + common::join(values, ",") + "]\n";
+    sk_ad_networks_str += network_name.str() + ": [" + common::join(values, ",") + "]\n";
   }
   sk_ad_networks_str += "}";
 
-  spdlog::debug("returned sk_ad_networks: {} ", sk_ad_networks_str);
+  SKAD_DEBUG("returned sk_ad_networks: {} ", sk_ad_networks_str);
 }
 
 }  // namespace fyber
\ No newline at end of file
@@ -1,10 +1,20 @@
 #pragma once
+#include <chrono>
+#include <functional>
+#include <future>
 #include <map>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <tuple>
 #include <vector>
 
+#include "CatalogStore.h"
+#include "DiskCache.h"
+#include "Endpoints.h"
+#include "Symbol.h"
+#include "exit_message.h"
+
 namespace fyber {
 using std::map;
 using std::optional;
@@ -12,31 +22,156 @@ using std::string;
 using std::tuple;
 using std::vector;
 
+/// Where a response of the service was served from
+enum class ResponseSource
+{
+  Server,
+  MemoryCache,
+  DiskCache,
+  /// The catalog compiled into the binary, see `embedded_catalog`
+  Embedded
+};
+
+/// When the catalog compiled into the binary is used rather than the service
+enum class EmbeddedCatalogUse
+{
+  Never,
+  /// When the service is unavailable or unreachable
+  OnFailure,
+  /// Always, the service is never contacted
+  Always
+};
+
+class Deadline;
+
 /// The API with the SKAdNetwork manager service in Fyber
 class ManagerApi
 {
  private:
+  /// Where requests are sent, the fastest healthy endpoint first
+  mutable Endpoints _endpoints;
+  /// The first endpoint, which names the responses in the caches whichever endpoint served them
   const string API_URL;
-  static string GET_request(const string& endpoint, optional<tuple<string, string>> param);
+  mutable std::once_flag _endpoints_probed;
+
+  // Responses are memoized, so a single instance can serve many plists without repeating requests. A response is
+  // cached as soon as its fetch starts: concurrent callers asking for the same one wait for that fetch, the others
+  // fetch in parallel. The mutex is only held to look up and publish entries.
+  mutable std::mutex _cache_mutex;
+  mutable optional<std::shared_future<vector<Symbol>>> _networks_cache;
+  mutable map<string, std::shared_future<map<Symbol, vector<Symbol>>>> _sk_ad_networks_cache;
+
+  // Responses shared with concurrent processes, when enabled
+  optional<DiskCache> _disk_cache;
+
+  EmbeddedCatalogUse _embedded_catalog = EmbeddedCatalogUse::Never;
+
+  /// Whether responses are asked compressed, see `ContentDecoder`
+  bool _compression = true;
+  /// Whether `/plist` is queried with a POST of the network names rather than in the URL
+  bool _post_queries = false;
+
+  /// Whether the networks and their IDs are served from a copy of the whole catalog, see `use_catalog_sync`
+  bool _catalog_sync = false;
+  /// The copy, once synced by this instance. Set once, under `_catalog_mutex`
+  mutable optional<CatalogStore> _catalog;
+  mutable std::mutex _catalog_mutex;
+
+  /// GET [path] with a single optional parameter [param]
+  [[nodiscard]] string GET_request(const string& path, const optional<tuple<string, string>>& param) const;
+
+  /// POST [body] to [path], as `text/plain`
+  [[nodiscard]] string POST_request(const string& path, const string& body) const;
+
+  /// Send a request for [path] with [send_to] to the ranked endpoints, failing over to the next one when an endpoint
+  /// fails or is unavailable, all within a single deadline
+  [[nodiscard]] string request(const string& path,
+                               const std::function<string(const string& url, const Deadline& deadline)>& send_to) const;
 
-  static vector<string> parse_networks_response(const char* body);
-  static map<string, vector<string>> parse_plist_response(const char* body);
+  /// Measure the latency of every endpoint at once, unless they were measured within the cache TTL
+  void probe_endpoints() const;
 
-  static void log_sk_ad_networks(const map<string, vector<string>>& sk_ad_networks);
+  /// Perform [request], through the disk cache under [key] when enabled
+  /// \param source set to where the response was served from
+  [[nodiscard]] string fetch(const string& key, const std::function<string()>& request, ResponseSource& source) const;
+
+  /// The copy of the catalog, synced when this instance first needs it, through the disk cache when enabled
+  /// \param source set to where the catalog, or its changes, were served from
+  [[nodiscard]] const CatalogStore& synced_catalog(ResponseSource& source) const;
+
+  /// The networks, from the service or the catalogs, bypassing the memory cache
+  [[nodiscard]] vector<Symbol> fetch_networks() const;
+
+  /// The SKAdNetwork IDs of [networks], from the service or the catalogs, bypassing the memory cache
+  /// \param source set to where the response was served from
+  [[nodiscard]] map<Symbol, vector<Symbol>> fetch_sk_ad_networks(const vector<Symbol>& networks,
+                                                                 ResponseSource& source) const;
+
+  /// Whether [failure] of the service is covered by the embedded catalog, which is then logged
+  [[nodiscard]] bool falls_back_on(const ExitMessage& failure) const;
+
+  static vector<Symbol> parse_networks_response(const char* body);
+  static map<Symbol, vector<Symbol>> parse_plist_response(const char* body);
+
+  static void log_sk_ad_networks(const map<Symbol, vector<Symbol>>& sk_ad_networks);
 
  public:
-  explicit ManagerApi(string url);
+  /// Time an endpoint has to answer a probe, slower ones are ranked as if they took that long
+  inline static const std::chrono::milliseconds probe_timeout{250};
+
+  /// \param url the service, or a comma-separated list of endpoints serving it (e.g. regional mirrors), tried in order
+  /// until their latencies are measured
+  /// \throws InvalidArguments if [url] has no endpoint
+  explicit ManagerApi(const string& url);
+
+  /// Share the responses, and the latencies of the endpoints, with other processes through the cache in [dir], reusing
+  /// them for [ttl]
+  /// \throws NotAFile if [dir] can't be created
+  void use_disk_cache(const string& dir, std::chrono::seconds ttl = DiskCache::default_ttl);
+
+  /// Serve the responses from the catalog compiled into the binary, always or when the service fails
+  void use_embedded_catalog(EmbeddedCatalogUse use);
+
+  /// Ask for compressed responses (the default), decoded while they are received
+  void use_compression(bool compression);
+
+  /// Query `/plist` with a POST of the sorted and deduplicated network names, one per line, rather than in the URL
+  void use_post_queries(bool post_queries);
+
+  /// Serve the networks and their IDs from a copy of the whole catalog, kept in the disk cache when enabled and synced
+  /// with the changes since its version once it's older than the cache TTL, rather than from `/networks` and `/plist`
+  void use_catalog_sync(bool catalog_sync);
+
+  /// Bring [store] up to date with `/catalog`: the whole catalog when [store] is empty, otherwise only the changes
+  /// since its version, applied in place
+  /// \param delta set to the changes applied, when given
+  /// \throws InvalidNetworks if the response is invalid, the store is then unchanged
+  CatalogStore::Update sync_catalog(CatalogStore& store, CatalogStore::Delta* delta = nullptr) const;
 
   /// Get a list of network names. <br/>
   /// Using the api call: https://network-setup.fyber.com/networks
   /// \return list of network names
-  [[nodiscard]] vector<string> get_networks() const;
+  [[nodiscard]] vector<Symbol> get_networks() const;
 
   /// Get a Mapping from 'Network Name' (as used in the podfile) to a list of SKAdNetwork IDs.<br/>
-  /// Using this api call: https://network-setup.fyber.com/plist?network_list=<comma-separated-networks>
+  /// Using this api call: https://network-setup.fyber.com/plist?network_list=<comma-separated-networks>, or a POST
+  /// of the names to https://network-setup.fyber.com/plist (see `use_post_queries`)
   /// \param networks list of network names
+  /// \param source when given, set to where the response was served from
   /// \return map of network names to IDs
-  [[nodiscard]] map<string, vector<string>> get_sk_ad_networks(const vector<string>& networks) const;
+  [[nodiscard]] map<Symbol, vector<Symbol>> get_sk_ad_networks(const vector<Symbol>& networks,
+                                                               ResponseSource* source = nullptr) const;
+
+  /// `get_sk_ad_networks` on a thread of its own, sent as soon as [networks] are resolved, so that the request
+  /// overlaps with the work of the caller. The instance must outlive the result.
+  /// \param source when given, set to where the response was served from, once the result is ready
+  /// \return the IDs, or the failure to resolve [networks] or to fetch them
+  [[nodiscard]] std::future<map<Symbol, vector<Symbol>>> get_sk_ad_networks_async(
+      std::shared_future<vector<Symbol>> networks, ResponseSource* source = nullptr) const;
+
+  static const char* source_name(ResponseSource source);
+  /// \throws InvalidArguments if [name] isn't the name of a source
+  static ResponseSource source_by_name(const string& name);
 };
 
 }  // namespace fyber
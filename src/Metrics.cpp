@@ -0,0 +1,219 @@
+#include "Metrics.h"
+
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include "FileLock.h"
+#include "exit_message.h"
+#include "spdlog/fmt/fmt.h"
+
+namespace fyber {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct FamilyInfo
+{
+  const char* name;
+  const char* type;
+  const char* help;
+};
+
+/// Every family the updater exports, in the order they are written
+const FamilyInfo families_info[] = {
+    {Metrics::run_seconds, "histogram", "Duration of a whole run."},
+    {Metrics::http_request_seconds, "histogram", "Duration of the requests to the catalog service, by endpoint."},
+    {Metrics::plist_seconds, "histogram", "Duration of plist processing, by phase."},
+    {Metrics::cache_hits, "counter", "Catalog responses served from a cache, by cache."},
+    {Metrics::cache_misses, "counter", "Catalog responses missing from a cache, by cache."},
+    {Metrics::http_retries, "counter", "Requests to the catalog service that were retried."},
+    {Metrics::response_bytes, "counter", "Bytes received from the catalog service, before decoding, by encoding."},
+    {Metrics::throttle_seconds, "histogram", "Time requests waited for the rate limiter, by reason."},
+    {Metrics::endpoint_failovers, "counter", "Requests sent to the next endpoint after a failure, by endpoint failed."},
+    {Metrics::embedded_catalog_fallbacks, "counter", "Failed catalog requests served by the embedded catalog."},
+    {Metrics::allocations, "counter", "Heap allocations, by phase (builds with SKAD_ALLOC_STATS only)."},
+    {Metrics::allocated_bytes, "counter", "Heap bytes allocated, by phase (builds with SKAD_ALLOC_STATS only)."},
+    {Metrics::ids_added, "counter", "SKAdNetwork IDs added to plists."},
+    {Metrics::plists, "counter", "Plists processed, by status."},
+    {Metrics::exits, "counter", "Runs, by exit reason."},
+};
+
+/// Upper bounds of the histogram buckets, in seconds
+const std::pair<double, const char*> buckets[] = {
+    {0.001, "0.001"}, {0.0025, "0.0025"}, {0.005, "0.005"}, {0.01, "0.01"}, {0.025, "0.025"},
+    {0.05, "0.05"},   {0.1, "0.1"},       {0.25, "0.25"},   {0.5, "0.5"},   {1, "1.0"},
+    {2.5, "2.5"},     {5, "5.0"},         {10, "10.0"},
+};
+
+const FamilyInfo* find_info(const string& name)
+{
+  for (const auto& info : families_info) {
+    if (name == info.name) return &info;
+  }
+  return nullptr;
+}
+
+string format_value(double value)
+{
+  if (std::floor(value) == value and std::fabs(value) < 1e15) {
+    return std::to_string(static_cast<long long>(value));
+  }
+  return fmt::format("{}", value);
+}
+
+string escape_label_value(const string& value)
+{
+  string escaped;
+  for (char c : value) {
+    if (c == '\\' or c == '"') escaped += '\\';
+    if (c == '\n') {
+      escaped += "\\n";
+      continue;
+    }
+    escaped += c;
+  }
+  return escaped;
+}
+
+}  // namespace
+
+void Metrics::Family::add(const string& series, double value)
+{
+  auto [it, inserted] = values.emplace(series, value);
+  if (inserted) {
+    order.push_back(series);
+  } else {
+    it->second += value;
+  }
+}
+
+Metrics& Metrics::global()
+{
+  static Metrics metrics;
+  return metrics;
+}
+
+string Metrics::series_name(const string& name, const Labels& labels)
+{
+  if (labels.empty()) return name;
+
+  string series = name + "{";
+  for (size_t i = 0; i < labels.size(); ++i) {
+    if (i > 0) series += ",";
+    series += labels[i].first + "=\"" + escape_label_value(labels[i].second) + "\"";
+  }
+  return series + "}";
+}
+
+void Metrics::increment(const string& family, const Labels& labels, double value)
+{
+  std::lock_guard lock(_mutex);
+  _families[family].add(series_name(family + "_total", labels), value);
+}
+
+void Metrics::observe(const string& family, const Labels& labels, std::chrono::duration<double> duration)
+{
+  const double seconds = duration.count();
+
+  std::lock_guard lock(_mutex);
+  auto& samples = _families[family];
+
+  // Buckets are cumulative
+  for (const auto& [bound, bound_name] : buckets) {
+    Labels bucket_labels = labels;
+    bucket_labels.emplace_back("le", bound_name);
+    samples.add(series_name(family + "_bucket", bucket_labels), seconds <= bound ? 1 : 0);
+  }
+
+  Labels inf_labels = labels;
+  inf_labels.emplace_back("le", "+Inf");
+  samples.add(series_name(family + "_bucket", inf_labels), 1);
+  samples.add(series_name(family + "_sum", labels), seconds);
+  samples.add(series_name(family + "_count", labels), 1);
+}
+
+string Metrics::to_text(const std::map<string, Family>& families)
+{
+  string text;
+
+  for (const auto& info : families_info) {
+    auto family = families.find(info.name);
+    if (family == families.end()) continue;
+
+    text += string("# TYPE ") + info.name + " " + info.type + "\n";
+    text += string("# HELP ") + info.name + " " + info.help + "\n";
+
+    for (const auto& series : family->second.order) {
+      text += series + " " + format_value(family->second.values.at(series)) + "\n";
+    }
+  }
+
+  return text + "# EOF\n";
+}
+
+string Metrics::to_text() const
+{
+  std::lock_guard lock(_mutex);
+  return to_text(_families);
+}
+
+void Metrics::parse_text(const string& text, std::map<string, Family>& families)
+{
+  std::istringstream lines(text);
+  string line;
+  string family;
+
+  while (std::getline(lines, line)) {
+    if (line.rfind("# TYPE ", 0) == 0) {
+      auto name = line.substr(7, line.find(' ', 7) - 7);
+      family = find_info(name) != nullptr ? name : "";
+      continue;
+    }
+
+    if (line.empty() or line[0] == '#' or family.empty()) continue;
+
+    auto separator = line.rfind(' ');
+    if (separator == string::npos) continue;
+
+    try {
+      families[family].add(line.substr(0, separator), std::stod(line.substr(separator + 1)));
+    } catch (const std::exception&) {
+      // Not one of ours, dropped
+    }
+  }
+}
+
+void Metrics::merge_into_file(const string& path) const
+{
+  FileLock lock(path + ".lock");
+
+  std::map<string, Family> merged;
+
+  if (fs::is_regular_file(path)) {
+    std::ifstream file(path, std::ios::binary);
+    parse_text(string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()), merged);
+  }
+
+  {
+    std::lock_guard guard(_mutex);
+    for (const auto& [name, family] : _families) {
+      for (const auto& series : family.order) merged[name].add(series, family.values.at(series));
+    }
+  }
+
+  // Written aside and renamed, so scrapers never read a partial file
+  const string temp_path = path + ".tmp";
+  {
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    file << to_text(merged);
+    if (!file) throw ExitMessage::NotAFile("Unable to write the metrics file `" + path + "`");
+  }
+  fs::rename(temp_path, path);
+}
+
+}  // namespace fyber
@@ -0,0 +1,82 @@
+#pragma once
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace fyber {
+
+using std::string;
+using std::vector;
+
+/// Counters and histograms of a run, exported as an OpenMetrics textfile (e.g. for the node-exporter textfile
+/// collector). <br/>
+/// Every series is cumulative, so the files of many runs can be merged by adding them up.
+class Metrics
+{
+ public:
+  using Labels = vector<std::pair<string, string>>;
+
+  inline static const char* run_seconds = "skad_updater_run_seconds";
+  inline static const char* http_request_seconds = "skad_updater_http_request_seconds";
+  inline static const char* plist_seconds = "skad_updater_plist_seconds";
+  inline static const char* cache_hits = "skad_updater_cache_hits";
+  inline static const char* cache_misses = "skad_updater_cache_misses";
+  inline static const char* http_retries = "skad_updater_http_retries";
+  inline static const char* response_bytes = "skad_updater_response_bytes";
+  inline static const char* throttle_seconds = "skad_updater_throttle_seconds";
+  inline static const char* endpoint_failovers = "skad_updater_endpoint_failovers";
+  inline static const char* embedded_catalog_fallbacks = "skad_updater_embedded_catalog_fallbacks";
+  inline static const char* allocations = "skad_updater_allocations";
+  inline static const char* allocated_bytes = "skad_updater_allocated_bytes";
+  inline static const char* ids_added = "skad_updater_ids_added";
+  inline static const char* plists = "skad_updater_plists";
+  inline static const char* exits = "skad_updater_exits";
+
+ private:
+  struct Family
+  {
+    vector<string> order;
+    std::unordered_map<string, double> values;
+
+    void add(const string& series, double value);
+  };
+
+  mutable std::mutex _mutex;
+  std::map<string, Family> _families;
+
+  static string series_name(const string& name, const Labels& labels);
+  static string to_text(const std::map<string, Family>& families);
+  static void parse_text(const string& text, std::map<string, Family>& families);
+
+ public:
+  static Metrics& global();
+
+  /// Add [value] to the counter [family]
+  void increment(const string& family, const Labels& labels = {}, double value = 1);
+
+  /// Record a duration in the histogram [family]
+  void observe(const string& family, const Labels& labels, std::chrono::duration<double> duration);
+
+  /// The OpenMetrics exposition of the recorded metrics
+  [[nodiscard]] string to_text() const;
+
+  /// Add the recorded metrics to those of the textfile in [path] (created when missing). <br/>
+  /// The file is locked while merging and replaced atomically, so concurrent runs and scrapers can share it.
+  void merge_into_file(const string& path) const;
+};
+
+/// Measures the time since its creation
+class Stopwatch
+{
+ private:
+  std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+
+ public:
+  [[nodiscard]] std::chrono::duration<double> elapsed() const { return std::chrono::steady_clock::now() - _start; }
+};
+
+}  // namespace fyber
@@ -3,10 +3,19 @@
 #include <spdlog/spdlog.h>
 
 #include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
 #include <pugixml.hpp>
 #include <utility>
 
+#include "AllocStats.h"
+#include "Arena.h"
+#include "Limits.h"
+#include "Metrics.h"
+#include "PlistWriter.h"
 #include "common.h"
+#include "logging.h"
 
 namespace fyber {
 
@@ -16,28 +25,77 @@ using std::string;
 using std::vector;
 namespace fs = std::filesystem;
 
-struct xml_string_writer : pugi::xml_writer
+Plist::Plist(string file_path) : _file_path(std::move(file_path)), _sk_ad_network_items(set<Symbol>())
 {
-  std::string result;
-
-  void write(const void* data, size_t size) override { result.append(static_cast<const char*>(data), size); }
-};
+  memory::PhaseScope phase(memory::Phase::PlistParse);
+  memory::install_pugixml_hooks();
+  Deadline deadline("reading the plist");
+
+  check_path(_file_path);
+  if (common::is_stream(_file_path)) {
+    // Nothing to lock, the stream is only read once
+    _stream_content = read_content(deadline);
+  } else {
+    _lock.emplace(_file_path, false);
+  }
+  _sk_ad_network_items = parseFile(deadline);
+}
 
-Plist::Plist(string file_path) : _file_path(std::move(file_path)), _sk_ad_network_items(set<string>())
+void Plist::check_path(const string& file_path)
 {
-  if (!fs::is_regular_file(_file_path)) {
+  if (!common::is_stream(file_path) and !fs::is_regular_file(file_path)) {
     throw ExitMessage::NotAFile("Provided plist_file_path is invalid : " +
-                                common::file_status_to_string(fs::status(_file_path)));
+                                common::file_status_to_string(fs::status(file_path)));
   }
-  _sk_ad_network_items = parseFile();
 }
 
-set<string> Plist::parseFile()
+string Plist::read_content(const Deadline& deadline) const
 {
-  pugi::xml_parse_result result = _doc.load_file(_file_path.c_str(), pugi::parse_full);
+  const auto& limits = Limits::global();
+
+  std::ifstream file;
+  std::istream* input = &std::cin;
+  if (_file_path != "-") {
+    file.open(_file_path, std::ios::binary);
+    if (!file.is_open()) throw ExitMessage::InvalidPlist("Unable to open plist '" + _file_path + "'");
+    input = &file;
+  }
+
+  // Read in chunks up to the limits, a corrupted plist of many GB is never buffered
+  BoundedStreambuf bounded(input->rdbuf(), limits.max_plist_bytes, &deadline);
+  string content((std::istreambuf_iterator<char>(&bounded)), std::istreambuf_iterator<char>());
+
+  if (bounded.exceeded()) {
+    throw ExitMessage::PlistTooLarge("`" + _file_path + "` is larger than " + std::to_string(limits.max_plist_bytes) +
+                                     " bytes (see `max_plist_size`)");
+  }
+  if (bounded.expired()) deadline.check();
+
+  return content;
+}
+
+set<Symbol> Plist::parseFile(const Deadline& deadline)
+{
+  Stopwatch stopwatch;
+
+  string file_content;
+  if (!_stream_content.has_value()) file_content = read_content(deadline);
+  const string& content = _stream_content.has_value() ? _stream_content.value() : file_content;
+
+  const auto max_depth = Limits::global().max_xml_depth;
+  if (max_depth > 0 and Limits::xml_depth(content) > max_depth) {
+    throw ExitMessage::XmlTooDeep("`" + _file_path + "` nests elements deeper than " + std::to_string(max_depth) +
+                                  " levels (see `max_xml_depth`)");
+  }
+
+  // Whitespace-only values (e.g. `<string> </string>`) are kept, so they are written back unchanged
+  const unsigned int options = pugi::parse_full | pugi::parse_ws_pcdata_single;
+  pugi::xml_parse_result result = _doc.load_buffer(content.data(), content.size(), options);
+  deadline.check();
+  Metrics::global().observe(Metrics::plist_seconds, {{"phase", "parse"}}, stopwatch.elapsed());
 
   if (result) {
-    set<string> collected_items = set<string>();
+    set<Symbol> collected_items = set<Symbol>();
 
     auto skAdNetworkItems_key = _doc.child("plist").child(plist_dict).find_child([](pugi::xml_node node) {
       return name_is(node, plist_key) and value_is(node, plist_SKAdNetworkItems);
@@ -53,7 +111,7 @@ set<string> Plist::parseFile()
         }
       }
 
-      spdlog::debug("Extracted from [" + _file_path + "] : [" + fyber::common::join(collected_items, ",") + "]");
+      SKAD_DEBUG("Extracted from [{}] : [{}]", _file_path, fyber::common::join(collected_items, ","));
     }
 
     return collected_items;
@@ -85,11 +143,11 @@ string Plist::new_sk_ad_network_items_str()
   return fyber::common::join(_new_sk_ad_network_items, ", ");
 }
 
-bool Plist::set_sk_ad_network_items_for_update(const std::map<string, vector<string>>& received_sk_ad_networks)
+bool Plist::set_sk_ad_network_items_for_update(const std::map<Symbol, vector<Symbol>>& received_sk_ad_networks)
 {
-  set<string> new_items;
+  set<Symbol> new_items;
 
-  const set<std::string>& received_items = fyber::common::get_value_set(received_sk_ad_networks);
+  const set<Symbol>& received_items = fyber::common::get_value_set(received_sk_ad_networks);
 
   for (const auto& received_item : received_items) {
     if (_sk_ad_network_items.count(received_item) == 0) {
@@ -97,7 +155,7 @@ bool Plist::set_sk_ad_network_items_for_update(const std::map<string, vector<str
     }
   }
 
-  spdlog::debug("Set New SKAdNetworkItems: {}", fyber::common::join(new_items, ", "));
+  SKAD_DEBUG("Set New SKAdNetworkItems: {}", fyber::common::join(new_items, ", "));
 
   _network_items_mapping = received_sk_ad_networks;
   _new_sk_ad_network_items = new_items;
@@ -110,8 +168,11 @@ bool Plist::should_update()
   return !_new_sk_ad_network_items.empty();
 }
 
-string Plist::build_plist_SKAdNetworkItems()
+const string& Plist::build_plist_SKAdNetworkItems()
 {
+  memory::PhaseScope phase(memory::Phase::Serialize);
+  Stopwatch stopwatch;
+
   pugi::xml_document new_doc;
   new_doc.reset(_doc);
 
@@ -123,14 +184,18 @@ string Plist::build_plist_SKAdNetworkItems()
 
   create_new_SKAdNetwork_items(sk_items);
 
-  xml_string_writer writer_new;
-  new_doc.save(writer_new);
+  // Room for the original content and the new items
+  std::error_code error;
+  auto file_size = _stream_content.has_value() ? _stream_content->size() : fs::file_size(_file_path, error);
+  PlistWriter writer((error ? 0 : file_size) + _new_sk_ad_network_items.size() * 128);
 
-  spdlog::debug("New Info.plist: \n{}", writer_new.result);
+  writer.write(new_doc);
+  _new_content = writer.release();
+  Metrics::global().observe(Metrics::plist_seconds, {{"phase", "build"}}, stopwatch.elapsed());
 
-  _new_doc.reset(new_doc);
+  SKAD_DEBUG("New Info.plist: \n{}", _new_content);
 
-  return writer_new.result;
+  return _new_content;
 }
 
 void Plist::create_new_SKAdNetwork_items(pugi::xml_node& sk_items) const
@@ -177,6 +242,11 @@ pugi::xml_node Plist::get_or_create_SKAdNetworkItems_xml(pugi::xml_node& plist_m
 
 void Plist::update_file(bool backup)
 {
+  memory::PhaseScope phase(memory::Phase::Write);
+  if (is_stream()) {
+    throw ExitMessage::InvalidArguments("`" + _file_path + "` is a stream and can't be updated in place, use `output`");
+  }
+
   std::filesystem::path path(_file_path);
   std::string file_name = path.filename();
   if (backup) {
@@ -188,8 +258,42 @@ void Plist::update_file(bool backup)
     spdlog::info("Backup `{}` created at `{}`", _file_path, _backup_name);
   }
 
-  auto saved = _new_doc.save_file(_file_path.c_str());
-  spdlog::info("Saving new `{}` = {}", _file_path, saved);
+  Stopwatch stopwatch;
+
+  std::ofstream file(_file_path, std::ios::binary | std::ios::trunc);
+  file.write(_new_content.data(), static_cast<std::streamsize>(_new_content.size()));
+  file.close();
+  Metrics::global().observe(Metrics::plist_seconds, {{"phase", "write"}}, stopwatch.elapsed());
+
+  if (file.fail()) {
+    throw ExitMessage::NotAFile("Unable to write the plist `" + _file_path + "`" +
+                                (_backup_name.empty() ? "" : ", its backup is `" + _backup_name + "`"));
+  }
+  spdlog::info("Saving new `{}` = true", _file_path);
+}
+
+void Plist::save_as(const string& output_path) const
+{
+  memory::PhaseScope phase(memory::Phase::Write);
+  std::ofstream file;
+  std::ostream* output = &std::cout;
+  if (output_path != "-") {
+    file.open(output_path, std::ios::binary | std::ios::trunc);
+    output = &file;
+  }
+
+  if (!_new_content.empty()) {
+    output->write(_new_content.data(), static_cast<std::streamsize>(_new_content.size()));
+  } else if (_stream_content.has_value()) {
+    output->write(_stream_content->data(), static_cast<std::streamsize>(_stream_content->size()));
+  } else {
+    std::ifstream original(_file_path, std::ios::binary);
+    *output << original.rdbuf();
+  }
+  output->flush();
+
+  if (!*output) throw ExitMessage::NotAFile("Unable to write the plist to `" + output_path + "`");
+  spdlog::info("Saving `{}` to `{}`", _file_path, output_path == "-" ? "stdout" : output_path);
 }
 
 int Plist::get_next_backup_id(const std::filesystem::path& path, const string& file_name)
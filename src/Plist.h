@@ -2,12 +2,16 @@
 
 #include <filesystem>
 #include <map>
+#include <optional>
 #include <pugixml.hpp>
 #include <set>
 #include <string>
 #include <variant>
 #include <vector>
 
+#include "FileLock.h"
+#include "Limits.h"
+#include "Symbol.h"
 #include "exit_message.h"
 
 namespace fyber {
@@ -21,14 +25,20 @@ class Plist
 {
  private:
   const string _file_path;
+  // Held from reading the file until the object is destroyed, so concurrent updates of the file are serialized
+  std::optional<FileLock> _lock;
   string _backup_name;
-  set<string> _sk_ad_network_items;
-  map<string, vector<string>> _network_items_mapping;
-  set<string> _new_sk_ad_network_items;
+  // The content read from a stream, which can't be read again
+  std::optional<string> _stream_content;
+  set<Symbol> _sk_ad_network_items;
+  map<Symbol, vector<Symbol>> _network_items_mapping;
+  set<Symbol> _new_sk_ad_network_items;
   pugi::xml_document _doc;
-  pugi::xml_document _new_doc;
+  string _new_content;
 
-  set<string> parseFile();
+  /// Read the whole plist, within the limits of plists
+  string read_content(const Deadline& deadline) const;
+  set<Symbol> parseFile(const Deadline& deadline);
   static bool value_is(const pugi::xml_node& item, const char* text);
   static bool name_is(const pugi::xml_node& item, const char* text);
   static int get_next_backup_id(const std::filesystem::path& path, const string& file_name);
@@ -48,33 +58,66 @@ class Plist
   inline static const char* backup_extension = ".bak.";
 
  public:
-  /// Load and parse the Info.Plist file in [file_path]
+  /// Load and parse the Info.Plist file in [file_path]. <br/>
+  /// Waits for other processes holding the file and locks it for the lifetime of the object. <br/>
+  /// [file_path] can also be `-` for stdin, a pipe or a device such as `/dev/fd/3`, which are read at once and can't
+  /// be updated in place (see `save_as`).
   explicit Plist(string file_path);
 
+  /// Fail as the constructor would if there's no plist to read in [file_path], without reading it
+  /// \throws NotAFile if [file_path] is neither a regular file nor a stream
+  static void check_path(const string& file_path);
+
   /// Setup new SKAdNetworkItems for update. <br/>
   /// Finds the difference with the existing SKAdNetworks and determines whether there are <b>new</b> network IDs.
   /// \param received_sk_ad_networks
   /// \return whether there's something to update in the actual file
-  bool set_sk_ad_network_items_for_update(const map<string, vector<string>>& received_sk_ad_networks);
+  bool set_sk_ad_network_items_for_update(const map<Symbol, vector<Symbol>>& received_sk_ad_networks);
 
   /// Return whether there's something to update in the actual file
   bool should_update();
 
-  /// Build a new Info.Plist XML based on the existing file, and the sk_ad_networks that needed to be added.
+  /// Build a new Info.Plist XML based on the existing file, and the sk_ad_networks that needed to be added. <br/>
+  /// The XML is formatted like Xcode (and `plutil -convert xml1`) would, see `PlistWriter`.
   /// \return Raw XML string
-  string build_plist_SKAdNetworkItems();
+  const string& build_plist_SKAdNetworkItems();
 
   /// Perform an update of the actual Plist file.<br/>
   /// If [backup] is passed, create indexed backup files with the extension `bak.X` where `X` is the last number of
   /// update.
   /// \param backup - whether it should create a backup
+  /// \throws InvalidArguments if the plist was read from a stream
+  /// \throws NotAFile if the plist can't be written, it may then be truncated
   void update_file(bool backup);
 
+  /// Write the plist to [output_path], or to stdout when it's `-`: the updated content once built, the original
+  /// content otherwise. The plist file itself is left unchanged.
+  /// \throws NotAFile if [output_path] can't be written
+  void save_as(const string& output_path) const;
+
   /// get a string of the currently existing SKAdNetworks items.
   string existing_sk_ad_network_items_str();
 
   /// get a string of the new SKAdNetworks items.
   string new_sk_ad_network_items_str();
+
+  /// The path of the Info.Plist file
+  [[nodiscard]] const string& file_path() const { return _file_path; }
+
+  /// Whether the plist was read from a stream rather than a file
+  [[nodiscard]] bool is_stream() const { return _stream_content.has_value(); }
+
+  /// The SKAdNetwork IDs found in the file
+  [[nodiscard]] const set<Symbol>& existing_sk_ad_network_items() const { return _sk_ad_network_items; }
+
+  /// The SKAdNetwork IDs that are missing from the file. Set by `set_sk_ad_network_items_for_update`
+  [[nodiscard]] const set<Symbol>& new_sk_ad_network_items() const { return _new_sk_ad_network_items; }
+
+  /// The network name to SKAdNetwork IDs mapping received for the update
+  [[nodiscard]] const map<Symbol, vector<Symbol>>& network_items_mapping() const { return _network_items_mapping; }
+
+  /// The path of the backup created by the last `update_file`, or empty when none was created
+  [[nodiscard]] const string& backup_path() const { return _backup_name; }
 };
 
 }  // namespace fyber
\ No newline at end of file
@@ -0,0 +1,209 @@
+#include "PlistWriter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace fyber {
+
+namespace {
+
+constexpr std::string_view header =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<!DOCTYPE plist PUBLIC \"-//Apple//DTD PLIST 1.0//EN\" \"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n"
+    "<plist version=\"1.0\">\n";
+
+constexpr std::string_view footer = "</plist>\n";
+
+/// CoreFoundation wraps base64 data at 76 columns, counting each level of indentation as 8 (up to 8 levels)
+constexpr size_t data_line_length = 76;
+constexpr size_t max_data_indent = 8;
+
+bool is_element(const pugi::xml_node& node)
+{
+  return node.type() == pugi::node_element;
+}
+
+bool is_text(const pugi::xml_node& node)
+{
+  return node.type() == pugi::node_pcdata or node.type() == pugi::node_cdata;
+}
+
+struct DictEntry
+{
+  std::string_view key;
+  pugi::xml_node key_node;
+  pugi::xml_node value;
+};
+
+bool is_base64_whitespace(char c)
+{
+  return c == ' ' or c == '\t' or c == '\n' or c == '\r';
+}
+
+}  // namespace
+
+PlistWriter::PlistWriter(size_t capacity)
+{
+  _output.reserve(capacity);
+}
+
+const std::string& PlistWriter::write(const pugi::xml_document& doc)
+{
+  _output.clear();
+  _output += header;
+
+  for (auto node = doc.child("plist").first_child(); node; node = node.next_sibling()) {
+    if (is_element(node)) {
+      write_object(node, 0);
+      break;
+    }
+  }
+
+  _output += footer;
+  return _output;
+}
+
+void PlistWriter::write_object(const pugi::xml_node& node, size_t depth)
+{
+  const char* name = node.name();
+
+  if (std::strcmp(name, "dict") == 0) {
+    write_dict(node, depth);
+  } else if (std::strcmp(name, "array") == 0) {
+    write_array(node, depth);
+  } else if (std::strcmp(name, "data") == 0) {
+    write_data(node, depth);
+  } else if (std::strcmp(name, "true") == 0 or std::strcmp(name, "false") == 0) {
+    indent(depth);
+    _output += '<';
+    _output += name;
+    _output += "/>\n";
+  } else {
+    write_text_element(name, node, depth);
+  }
+}
+
+void PlistWriter::write_dict(const pugi::xml_node& node, size_t depth)
+{
+  std::vector<DictEntry> entries;
+
+  for (auto child = node.first_child(); child; child = child.next_sibling()) {
+    if (!is_element(child) or std::strcmp(child.name(), "key") != 0) continue;
+
+    auto value = child.next_sibling();
+    while (value and !is_element(value)) value = value.next_sibling();
+    if (!value) break;
+
+    entries.push_back(DictEntry{child.child_value(), child, value});
+    child = value;
+  }
+
+  indent(depth);
+  if (entries.empty()) {
+    _output += "<dict/>\n";
+    return;
+  }
+
+  // Like CFPropertyList, keys are written in sorted order
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const DictEntry& left, const DictEntry& right) { return left.key < right.key; });
+
+  _output += "<dict>\n";
+  for (const auto& entry : entries) {
+    write_text_element("key", entry.key_node, depth + 1);
+    write_object(entry.value, depth + 1);
+  }
+  indent(depth);
+  _output += "</dict>\n";
+}
+
+void PlistWriter::write_array(const pugi::xml_node& node, size_t depth)
+{
+  auto first = node.first_child();
+  while (first and !is_element(first)) first = first.next_sibling();
+
+  indent(depth);
+  if (!first) {
+    _output += "<array/>\n";
+    return;
+  }
+
+  _output += "<array>\n";
+  for (auto child = first; child; child = child.next_sibling()) {
+    if (is_element(child)) write_object(child, depth + 1);
+  }
+  indent(depth);
+  _output += "</array>\n";
+}
+
+void PlistWriter::write_data(const pugi::xml_node& node, size_t depth)
+{
+  const size_t line_length = data_line_length - 8 * std::min(depth, max_data_indent);
+
+  indent(depth);
+  _output += "<data>\n";
+
+  size_t column = 0;
+  for (auto child = node.first_child(); child; child = child.next_sibling()) {
+    if (!is_text(child)) continue;
+
+    for (const char* c = child.value(); *c != '\0'; ++c) {
+      if (is_base64_whitespace(*c)) continue;
+
+      if (column == 0) indent(depth);
+      _output += *c;
+
+      if (++column == line_length) {
+        _output += '\n';
+        column = 0;
+      }
+    }
+  }
+  if (column > 0) _output += '\n';
+
+  indent(depth);
+  _output += "</data>\n";
+}
+
+void PlistWriter::write_text_element(std::string_view name, const pugi::xml_node& node, size_t depth)
+{
+  indent(depth);
+  _output += '<';
+  _output += name;
+  _output += '>';
+  write_escaped_text(node);
+  _output += "</";
+  _output += name;
+  _output += ">\n";
+}
+
+void PlistWriter::write_escaped_text(const pugi::xml_node& node)
+{
+  for (auto child = node.first_child(); child; child = child.next_sibling()) {
+    if (!is_text(child)) continue;
+
+    for (const char* c = child.value(); *c != '\0'; ++c) {
+      switch (*c) {
+        case '&':
+          _output += "&amp;";
+          break;
+        case '<':
+          _output += "&lt;";
+          break;
+        case '>':
+          _output += "&gt;";
+          break;
+        default:
+          _output += *c;
+      }
+    }
+  }
+}
+
+void PlistWriter::indent(size_t depth)
+{
+  _output.append(depth, '\t');
+}
+
+}  // namespace fyber
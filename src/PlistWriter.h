@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <pugixml.hpp>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace fyber {
+
+/// Serialize a plist DOM exactly as Xcode and `plutil -convert xml1` do. <br/>
+/// That is: the XML declaration and DOCTYPE header, the root object at column 0, a tab per nesting level,
+/// `<true/>` / `<false/>` and `<dict/>` / `<array/>` for empty containers, dictionary keys sorted, comments dropped,
+/// and only `&`, `<` and `>` escaped.
+class PlistWriter
+{
+ private:
+  std::string _output;
+
+  void write_object(const pugi::xml_node& node, size_t depth);
+  void write_dict(const pugi::xml_node& node, size_t depth);
+  void write_array(const pugi::xml_node& node, size_t depth);
+  void write_data(const pugi::xml_node& node, size_t depth);
+  void write_text_element(std::string_view name, const pugi::xml_node& node, size_t depth);
+  void write_escaped_text(const pugi::xml_node& node);
+  void indent(size_t depth);
+
+ public:
+  /// \param capacity initial size of the output buffer, e.g. the size of the source file
+  explicit PlistWriter(size_t capacity = 4096);
+
+  /// Serialize the root object of the `<plist>` element of [doc]
+  /// \return the serialized plist
+  const std::string& write(const pugi::xml_document& doc);
+
+  /// The serialized plist, moved out of the writer
+  std::string release() { return std::move(_output); }
+};
+
+}  // namespace fyber
@@ -1,62 +1,344 @@
 #include "PodFile.h"
 
+#include <algorithm>
+#include <cctype>
 #include <filesystem>
 #include <fstream>
+#include <iostream>
+#include <unordered_set>
 #include <utility>
 
+#include "AllocStats.h"
+#include "Limits.h"
 #include "common.h"
 #include "exit_message.h"
+#include "logging.h"
 #include "spdlog/spdlog.h"
 
 namespace fyber {
 
 using std::string;
+using std::string_view;
 using std::vector;
 namespace fs = std::filesystem;
 
-fyber::PodFile::PodFile(string pod_file_path, const vector<string>& supported_networks)
-    : _pod_file_path(std::move(pod_file_path)), _found_networks(vector<string>())
+namespace {
+
+/// A block of the Podfile being scanned
+struct Scope
+{
+  enum class Kind
+  {
+    Def,
+    Target,
+    Other
+  };
+
+  Kind kind = Kind::Other;
+  /// The name of a `def`
+  string def_name;
+  /// The targets declared by a `target` block, several when it's named through an array
+  vector<size_t> targets;
+  /// The variable of an `[...].each do |variable|` block, and the values it takes
+  string variable;
+  vector<string> values;
+};
+
+/// [line] without its comment
+string_view strip_comment(string_view line)
+{
+  char quote = 0;
+  for (size_t i = 0; i < line.size(); ++i) {
+    char c = line[i];
+    if (quote != 0) {
+      if (c == '\\') {
+        ++i;
+      } else if (c == quote) {
+        quote = 0;
+      }
+    } else if (c == '\'' or c == '"') {
+      quote = c;
+    } else if (c == '#') {
+      return line.substr(0, i);
+    }
+  }
+  return line;
+}
+
+bool is_identifier(string_view text)
+{
+  if (text.empty() or !(std::isalpha(static_cast<unsigned char>(text[0])) or text[0] == '_')) return false;
+  return std::all_of(text.begin(), text.end(),
+                     [](char c) { return std::isalnum(static_cast<unsigned char>(c)) or c == '_'; });
+}
+
+/// The leading word of [text], up to a space or a parenthesis
+string_view first_word(string_view text)
+{
+  return text.substr(0, std::min(text.find_first_of(" \t("), text.size()));
+}
+
+/// The string literals of [text], in order
+vector<string> string_literals(string_view text)
+{
+  vector<string> literals;
+  for (size_t i = 0; i < text.size(); ++i) {
+    char quote = text[i];
+    if (quote != '\'' and quote != '"') continue;
+
+    auto end = text.find(quote, i + 1);
+    if (end == string_view::npos) break;
+    literals.emplace_back(text.substr(i + 1, end - i - 1));
+    i = end;
+  }
+  return literals;
+}
+
+/// Whether [line] opens a block closed by `end`: `do`, `do |...|`, or a statement such as `if`
+bool opens_block(string_view line)
 {
-  if (!fs::is_regular_file(_pod_file_path)) {
+  static const string_view keywords[] = {"if", "unless", "case", "begin", "while", "until", "for", "class", "module"};
+
+  auto word = first_word(line);
+  if (std::find(std::begin(keywords), std::end(keywords), word) != std::end(keywords)) return true;
+
+  if (!line.empty() and line.back() == '|') {
+    auto bar = line.rfind('|', line.size() - 2);
+    if (bar == string_view::npos) return false;
+    line = common::trim_view(line.substr(0, bar));
+  }
+  return line == "do" or (line.size() > 3 and line.substr(line.size() - 3) == " do") or
+         (line.size() > 3 and line.substr(line.size() - 3) == ")do");
+}
+
+}  // namespace
+
+fyber::PodFile::PodFile(string pod_file_path, const vector<Symbol>& supported_networks)
+    : _pod_file_path(std::move(pod_file_path)), _found_networks(vector<Symbol>())
+{
+  memory::PhaseScope phase(memory::Phase::PodfileParse);
+  if (!fs::is_regular_file(_pod_file_path) and !common::is_stream(_pod_file_path)) {
     throw ExitMessage::NotAFile("Provided pod_file_path is invalid : " +
                                 common::file_status_to_string(fs::status(_pod_file_path)));
   }
 
-  _found_networks = parseFile(supported_networks);
+  parseFile(supported_networks);
 
-  spdlog::debug("pod file contains these networks: [{}]", common::join(_found_networks, ","));
+  SKAD_DEBUG("pod file contains these networks: [{}]", common::join(_found_networks, ","));
 }
 
-vector<string> PodFile::parseFile(const vector<string>& supported_networks)
+void PodFile::parseFile(const vector<Symbol>& supported_networks)
 {
-  vector<string> pods;
-  string line;
-  std::ifstream podfile(_pod_file_path);
-  if (podfile.is_open()) {
-    while (getline(podfile, line)) {
-      const string& trimmed = common::ltrim(line);
-      if (common::starts_with(trimmed, "pod '")) {
+  std::ifstream file;
+  std::istream* input = &std::cin;
+  if (_pod_file_path != "-") {
+    file.open(_pod_file_path);
+    if (!file.is_open()) {
+      throw ExitMessage::InvalidPodFile("Unable to open podfile '" + _pod_file_path + "'.");
+    }
+    input = &file;
+  }
+
+  // Lines are read through the limits, a runaway Podfile ends the parse instead of being buffered
+  const auto& limits = Limits::global();
+  Deadline deadline("parsing the Podfile");
+  BoundedStreambuf bounded(input->rdbuf(), limits.max_podfile_bytes, &deadline);
+  std::istream podfile(&bounded);
+
+  parse(podfile, supported_networks);
 
-        find_sk_ad_network(supported_networks, trimmed, pods);
+  if (bounded.exceeded()) {
+    throw ExitMessage::PodFileTooLarge("`" + _pod_file_path + "` is larger than " +
+                                       std::to_string(limits.max_podfile_bytes) + " bytes (see `max_podfile_size`)");
+  }
+  deadline.check();
+}
+
+/// Scans the structure of the Podfile in a single pass: `def`, `target` and other blocks are tracked on a stack, and
+/// every `pod` of a supported network or call of a helper is recorded in the innermost `def` or `target`.
+void PodFile::parse(std::istream& podfile, const vector<Symbol>& supported_networks)
+{
+  Block root;
+  std::map<string, Block> defs;
+  vector<Target> targets;
+  vector<Scope> scopes;
+
+  auto record = [&](const Entry& entry) {
+    for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+      if (scope->kind == Scope::Kind::Def) {
+        defs[scope->def_name].push_back(entry);
+        return;
       }
+      if (scope->kind == Scope::Kind::Target) {
+        for (auto target : scope->targets) targets[target].block.push_back(entry);
+        return;
+      }
+    }
+    root.push_back(entry);
+  };
+
+  // The names given to a target by [argument]: a literal, or the values of an enclosing `each` variable
+  auto target_names = [&](string_view argument) -> vector<string> {
+    auto literals = string_literals(argument);
+    if (!literals.empty()) return {literals.front()};
+
+    auto variable = common::trim_view(argument);
+    if (!variable.empty() and variable.front() == '(') variable = common::trim_view(variable.substr(1));
+    variable = variable.substr(0, std::min(variable.find_first_of(" \t)"), variable.size()));
+
+    for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+      if (!scope->variable.empty() and scope->variable == variable) return scope->values;
     }
-    podfile.close();
+    return {string(variable)};
+  };
 
-    return pods;
-  } else {
+  string raw_line;
+  while (getline(podfile, raw_line)) {
+    const auto line = common::trim_view(strip_comment(raw_line));
+    if (line.empty()) continue;
 
-    throw ExitMessage::InvalidPodFile("Unable to open podfile '" + _pod_file_path + "'.");
+    const auto word = first_word(line);
+
+    if (word == "end") {
+      if (!scopes.empty()) scopes.pop_back();
+      continue;
+    }
+
+    if (word == "pod") {
+      auto literals = string_literals(line);
+      if (literals.empty()) continue;
+
+      if (auto network = find_sk_ad_network(supported_networks, literals.front())) {
+        _found_networks.push_back(network.value());
+        record(Entry{network.value(), ""});
+      }
+      continue;
+    }
+
+    if (word == "inherit!") {
+      if (line.find(":complete") != string_view::npos) continue;
+
+      for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+        if (scope->kind != Scope::Kind::Target) continue;
+        for (auto target : scope->targets) targets[target].inherits = false;
+        break;
+      }
+      continue;
+    }
+
+    if (word == "def") {
+      Scope scope;
+      scope.kind = Scope::Kind::Def;
+      scope.def_name = string(first_word(common::trim_view(line.substr(word.size()))));
+      scopes.push_back(std::move(scope));
+      continue;
+    }
+
+    if ((word == "target" or word == "abstract_target") and opens_block(line)) {
+      vector<size_t> parents;
+      for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+        if (scope->kind == Scope::Kind::Target) {
+          parents = scope->targets;
+          break;
+        }
+      }
+
+      Scope scope;
+      scope.kind = Scope::Kind::Target;
+      for (const auto& name : target_names(line.substr(word.size()))) {
+        if (parents.empty()) {
+          scope.targets.push_back(targets.size());
+          targets.push_back(Target{name, {}, std::nullopt});
+        }
+        for (auto parent : parents) {
+          scope.targets.push_back(targets.size());
+          targets.push_back(Target{name, {}, parent});
+        }
+      }
+      scopes.push_back(std::move(scope));
+      continue;
+    }
+
+    if (opens_block(line)) {
+      Scope scope;
+
+      // ['A', 'B'].each do |name|
+      auto each = line.find("].each");
+      if (line.front() == '[' and each != string_view::npos and line.back() == '|') {
+        scope.values = string_literals(line.substr(0, each));
+        auto bar = line.rfind('|', line.size() - 2);
+        scope.variable = string(common::trim_view(line.substr(bar + 1, line.size() - bar - 2)));
+      }
+
+      scopes.push_back(std::move(scope));
+      continue;
+    }
+
+    if (is_identifier(line)) record(Entry{Symbol(), string(line)});
+  }
+
+  for (const auto& target : targets) {
+    vector<const Block*> blocks = {&target.block};
+    const Target* inheriting = &target;
+    for (; inheriting->inherits and inheriting->parent.has_value(); inheriting = &targets[inheriting->parent.value()]) {
+      blocks.push_back(&targets[inheriting->parent.value()].block);
+    }
+    if (inheriting->inherits) blocks.push_back(&root);
+
+    // Outermost first
+    vector<Symbol> networks;
+    vector<string> expanding;
+    for (auto block = blocks.rbegin(); block != blocks.rend(); ++block) expand(**block, defs, expanding, networks);
+
+    std::unordered_set<Symbol> seen;
+    networks.erase(std::remove_if(networks.begin(), networks.end(),
+                                  [&seen](const Symbol& network) { return !seen.insert(network).second; }),
+                   networks.end());
+
+    SKAD_DEBUG("pod file target `{}` contains these networks: [{}]", target.name, common::join(networks, ","));
+    _target_networks.emplace_back(target.name, std::move(networks));
+  }
+}
+
+void PodFile::expand(const Block& block, const std::map<string, Block>& defs, vector<string>& expanding,
+                     vector<Symbol>& networks)
+{
+  for (const auto& entry : block) {
+    if (entry.call.empty()) {
+      networks.push_back(entry.network);
+      continue;
+    }
+
+    // Calls of anything but helpers (e.g. `use_frameworks`) and recursive calls are skipped
+    auto def = defs.find(entry.call);
+    if (def == defs.end() or std::find(expanding.begin(), expanding.end(), entry.call) != expanding.end()) continue;
+
+    expanding.push_back(entry.call);
+    expand(def->second, defs, expanding, networks);
+    expanding.pop_back();
   }
 }
 
-void PodFile::find_sk_ad_network(const vector<string>& supported_networks, const string& trimmed, vector<string>& pods)
+const vector<Symbol>& PodFile::get_target_networks(const string& target_name) const
+{
+  for (const auto& [name, networks] : _target_networks) {
+    if (name == target_name) return networks;
+  }
+
+  vector<string> names;
+  for (const auto& [name, networks] : _target_networks) names.push_back(name);
+  throw ExitMessage::InvalidPodFile("Target `" + target_name +
+                                    "` not found in the podfile. Targets: " + common::join(names, ", "));
+}
+
+std::optional<Symbol> PodFile::find_sk_ad_network(const vector<Symbol>& supported_networks, string_view pod_name)
 {
   for (auto& supported_network : supported_networks) {
-    if (common::starts_with(trimmed, "pod '" + supported_network)) {
-      pods.emplace_back(supported_network);
-      break;
+    if (pod_name.substr(0, supported_network.view().size()) == supported_network.view()) {
+      return supported_network;
     }
   }
+  return std::nullopt;
 }
 
-}  // namespace fyber
\ No newline at end of file
+}  // namespace fyber
@@ -1,7 +1,14 @@
 #pragma once
+#include <istream>
+#include <map>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
+#include "Symbol.h"
+
 namespace fyber {
 
 using std::string;
@@ -11,19 +18,57 @@ using std::vector;
 class PodFile
 {
  private:
+  /// A `pod` of a supported network, or a call of a `def` helper, in the order of the Podfile
+  struct Entry
+  {
+    Symbol network;
+    string call;
+  };
+
+  /// The pods and helper calls of a `def`, a `target` or the root of the Podfile
+  using Block = vector<Entry>;
+
+  struct Target
+  {
+    string name;
+    Block block;
+    /// The enclosing target, whose pods are inherited
+    std::optional<size_t> parent;
+    /// Cleared by `inherit! :search_paths` or `inherit! :none`, then neither the enclosing targets' nor the root pods
+    /// are inherited
+    bool inherits = true;
+  };
+
   const string _pod_file_path;
-  vector<string> _found_networks;
+  vector<Symbol> _found_networks;
+  vector<std::pair<string, vector<Symbol>>> _target_networks;
 
-  vector<string> parseFile(const vector<string>& supported_networks);
+  void parseFile(const vector<Symbol>& supported_networks);
+  void parse(std::istream& podfile, const vector<Symbol>& supported_networks);
 
-  static void find_sk_ad_network(const vector<string>& supported_networks, const string& trimmed, vector<string>& pods);
+  static std::optional<Symbol> find_sk_ad_network(const vector<Symbol>& supported_networks, std::string_view pod_name);
+
+  /// Append the networks of [block] to [networks], expanding the helper calls
+  static void expand(const Block& block, const std::map<string, Block>& defs, vector<string>& expanding,
+                     vector<Symbol>& networks);
 
  public:
-  /// Parse the podfile in [pod_file_path], by matching the network name list of [supported_networks].
-  explicit PodFile(string pod_file_path, const vector<string>& supported_networks);
+  /// Parse the podfile in [pod_file_path], by matching the network name list of [supported_networks]. <br/>
+  /// [pod_file_path] can be `-` for stdin, a pipe or a device such as `/dev/fd/3`, which are read as they come.
+  explicit PodFile(string pod_file_path, const vector<Symbol>& supported_networks);
 
   /// Get the list of networks used in the podfile.
-  vector<string> get_used_networks() { return _found_networks; }
+  vector<Symbol> get_used_networks() { return _found_networks; }
+
+  /// The networks of every target, in the order of the Podfile. <br/>
+  /// A target has its own pods, those of the `def` helpers it calls, those of its enclosing targets and those at the
+  /// root of the Podfile, unless it's declared with `inherit! :search_paths` or `inherit! :none`. Targets named through
+  /// an array (`['A', 'B'].each do |name| target(name) ...`) are expanded.
+  [[nodiscard]] const vector<std::pair<string, vector<Symbol>>>& target_networks() const { return _target_networks; }
+
+  /// The networks of the target [target_name]
+  /// \throws InvalidPodFile if there's no such target
+  [[nodiscard]] const vector<Symbol>& get_target_networks(const string& target_name) const;
 };
 
 }  // namespace fyber
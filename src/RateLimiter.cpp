@@ -0,0 +1,236 @@
+#include "RateLimiter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <thread>
+
+#include "FileLock.h"
+#include "Metrics.h"
+#include "common.h"
+#include "exit_message.h"
+#include "logging.h"
+#include "spdlog/spdlog.h"
+
+namespace fyber {
+
+namespace fs = std::filesystem;
+using std::chrono::microseconds;
+
+namespace {
+
+int64_t now_us()
+{
+  return std::chrono::duration_cast<microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/// The limiters of the process, and what they are created with
+struct Registry
+{
+  std::mutex mutex;
+  std::map<string, std::unique_ptr<RateLimiter>> limiters;
+  std::map<string, RateLimit> limits;
+  std::optional<string> shared_dir;
+
+  static Registry& global()
+  {
+    static auto* registry = new Registry();  // never destroyed, permits may be released during static destruction
+    return *registry;
+  }
+
+  /// The limit of [host], `name:port` or `name`, falling back to the default one
+  RateLimit limit_of(const string& host) const
+  {
+    for (const auto& key : {host, host.substr(0, host.rfind(':')), string()}) {
+      auto found = limits.find(key);
+      if (found != limits.end()) return found->second;
+    }
+    return RateLimit();
+  }
+};
+
+}  // namespace
+
+RateLimit RateLimit::parse(const string& text)
+{
+  RateLimit limit;
+  auto slash = text.find('/');
+  try {
+    size_t parsed = 0;
+    limit.rate = std::stod(text.substr(0, slash), &parsed);
+    if (parsed != text.substr(0, slash).size()) throw std::invalid_argument(text);
+    limit.burst = slash == string::npos ? std::max(1.0, limit.rate) : std::stod(text.substr(slash + 1), &parsed);
+    if (slash != string::npos and parsed != text.size() - slash - 1) throw std::invalid_argument(text);
+  } catch (const std::exception&) {
+    throw ExitMessage::InvalidArguments("Invalid rate limit `" + text + "`, expected `<rate>[/<burst>]`");
+  }
+
+  if (limit.rate <= 0 or limit.burst < 1) {
+    throw ExitMessage::InvalidArguments("Invalid rate limit `" + text +
+                                        "`, the rate must be positive and the burst 1 "
+                                        "or more");
+  }
+  return limit;
+}
+
+RateLimiter::RateLimiter(string host, RateLimit limit, const std::optional<string>& shared_dir)
+    : _host(std::move(host)), _limit(limit)
+{
+  _state.tokens = std::max(1.0, _limit.burst);
+  _state.refilled = now_us();
+
+  if (shared_dir.has_value()) share_in(shared_dir.value());
+}
+
+void RateLimiter::share_in(const string& dir)
+{
+  std::error_code error;
+  fs::create_directories(dir, error);
+  if (error or !fs::is_directory(dir)) {
+    throw ExitMessage::NotAFile("Provided cache_dir is invalid : " + (error ? error.message() : dir));
+  }
+
+  char name[17];
+  std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(common::fnv1a(_host)));
+
+  std::lock_guard lock(_mutex);
+  _shared_state = fs::path(dir) / ("ratelimit-" + string(name));
+}
+
+RateLimiter& RateLimiter::for_host(const string& host)
+{
+  auto& registry = Registry::global();
+  std::lock_guard lock(registry.mutex);
+
+  auto& limiter = registry.limiters[host];
+  if (!limiter) limiter = std::make_unique<RateLimiter>(host, registry.limit_of(host), registry.shared_dir);
+  return *limiter;
+}
+
+void RateLimiter::configure(const string& host, RateLimit limit)
+{
+  auto& registry = Registry::global();
+  std::lock_guard lock(registry.mutex);
+
+  registry.limits[host] = limit;
+  for (auto& [limited_host, limiter] : registry.limiters) {
+    std::lock_guard limiter_lock(limiter->_mutex);
+    limiter->_limit = registry.limit_of(limited_host);
+  }
+  SKAD_DEBUG("Requests to {} limited to {}/s (burst {}), {} in flight", host.empty() ? "every host" : host, limit.rate,
+             limit.burst, limit.max_in_flight);
+}
+
+void RateLimiter::share_through(const string& dir)
+{
+  auto& registry = Registry::global();
+  std::lock_guard lock(registry.mutex);
+
+  registry.shared_dir = dir;
+  for (auto& [host, limiter] : registry.limiters) limiter->share_in(dir);
+}
+
+string RateLimiter::host_of(const string& url)
+{
+  auto start = url.find("://");
+  start = start == string::npos ? 0 : start + 3;
+  return url.substr(start, url.find_first_of("/?", start) - start);
+}
+
+std::pair<RateLimiter::Wait, microseconds> RateLimiter::take(State& state, int64_t now) const
+{
+  if (now < state.blocked_until) return {Wait::RetryAfter, microseconds(state.blocked_until - now)};
+  if (_limit.rate <= 0) return {Wait::None, microseconds(0)};
+
+  const double burst = std::max(1.0, _limit.burst);
+  state.tokens = std::min(burst, state.tokens + static_cast<double>(now - state.refilled) * _limit.rate / 1e6);
+  state.refilled = now;
+
+  if (state.tokens >= 1) {
+    state.tokens -= 1;
+    return {Wait::None, microseconds(0)};
+  }
+  return {Wait::Rate, microseconds(static_cast<int64_t>((1 - state.tokens) / _limit.rate * 1e6) + 1)};
+}
+
+void RateLimiter::update_shared_state(const std::function<void(State&)>& update) const
+{
+  // Other processes wait here, the file is small enough to be rewritten in place
+  FileLock lock(_shared_state->string());
+
+  State state = _state;
+  std::ifstream in(_shared_state.value());
+  if (!(in >> state.tokens >> state.refilled >> state.blocked_until)) state = _state;
+  in.close();
+
+  update(state);
+
+  std::ofstream out(_shared_state.value(), std::ios::trunc);
+  out << state.tokens << ' ' << state.refilled << ' ' << state.blocked_until << '\n';
+}
+
+RateLimiter::Permit RateLimiter::acquire()
+{
+  // By `Wait`, with the time waited for a request in flight to complete in place of `None`
+  microseconds waited[3] = {};
+
+  std::unique_lock lock(_mutex);
+  while (true) {
+    if (_limit.max_in_flight > 0 and _in_flight >= _limit.max_in_flight) {
+      Stopwatch stopwatch;
+      _released.wait(lock, [this] { return _limit.max_in_flight == 0 or _in_flight < _limit.max_in_flight; });
+      waited[0] += std::chrono::duration_cast<microseconds>(stopwatch.elapsed());
+    }
+
+    std::pair<Wait, microseconds> taken;
+    if (_shared_state.has_value()) {
+      update_shared_state([&](State& state) { taken = take(state, now_us()); });
+    } else {
+      taken = take(_state, now_us());
+    }
+
+    auto [wait, delay] = taken;
+    if (wait == Wait::None) break;
+
+    waited[static_cast<int>(wait)] += delay;
+    lock.unlock();
+    std::this_thread::sleep_for(delay);
+    lock.lock();
+  }
+  _in_flight++;
+  lock.unlock();
+
+  const char* reasons[] = {"in_flight", "rate", "retry_after"};
+  for (int i = 0; i < 3; ++i) {
+    if (waited[i].count() == 0) continue;
+    SKAD_DEBUG("Request to {} throttled for {}us ({})", _host, waited[i].count(), reasons[i]);
+    Metrics::global().observe(Metrics::throttle_seconds, {{"reason", reasons[i]}}, waited[i]);
+  }
+
+  return Permit(this);
+}
+
+void RateLimiter::release()
+{
+  {
+    std::lock_guard lock(_mutex);
+    _in_flight--;
+  }
+  _released.notify_one();
+}
+
+void RateLimiter::back_off(std::chrono::milliseconds delay)
+{
+  const int64_t until = now_us() + std::chrono::duration_cast<microseconds>(delay).count();
+
+  std::lock_guard lock(_mutex);
+  _state.blocked_until = std::max(_state.blocked_until, until);
+
+  if (_shared_state.has_value()) {
+    update_shared_state([until](State& state) { state.blocked_until = std::max(state.blocked_until, until); });
+  }
+}
+
+}  // namespace fyber
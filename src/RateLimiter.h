@@ -0,0 +1,118 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+
+namespace fyber {
+
+using std::string;
+
+/// Limits of the requests to a host
+struct RateLimit
+{
+  /// Sustained requests per second, unlimited when 0
+  double rate = 0;
+  /// Requests that can be sent at once after an idle period, at least 1
+  double burst = 1;
+  /// Requests in flight at once, unlimited when 0
+  size_t max_in_flight = 0;
+
+  /// Parse `<rate>[/<burst>]`, the burst defaulting to a second of [rate]
+  /// \throws InvalidArguments if [text] isn't a positive rate
+  static RateLimit parse(const string& text);
+};
+
+/// A token bucket and a cap on the requests in flight to a host, shared by the threads of the process (see
+/// `for_host`), and by the processes sharing a directory for the bucket (see `share_through`). <br/>
+/// Holds every request to the host while a `Retry-After` received from it is pending.
+class RateLimiter
+{
+ private:
+  /// The bucket, in microseconds since the epoch so that it can be shared with other processes
+  struct State
+  {
+    double tokens = 0;
+    int64_t refilled = 0;
+    int64_t blocked_until = 0;
+  };
+
+  /// Why a request waits
+  enum class Wait
+  {
+    None,
+    Rate,
+    RetryAfter
+  };
+
+  const string _host;
+  mutable std::mutex _mutex;
+  std::condition_variable _released;
+  RateLimit _limit;
+  State _state;
+  size_t _in_flight = 0;
+  std::optional<std::filesystem::path> _shared_state;
+
+  /// Take a token from [state] at [now]
+  /// \return how long to wait for it otherwise, and why
+  std::pair<Wait, std::chrono::microseconds> take(State& state, int64_t now) const;
+
+  /// Apply [update] to the bucket shared with other processes, under its lock
+  void update_shared_state(const std::function<void(State&)>& update) const;
+
+  /// Share the bucket with the processes using [dir]
+  void share_in(const string& dir);
+
+  void release();
+
+ public:
+  /// A request allowed to be sent, in flight until destroyed
+  class Permit
+  {
+   private:
+    RateLimiter* _limiter;
+
+   public:
+    explicit Permit(RateLimiter* limiter) : _limiter(limiter) {}
+    Permit(Permit&& other) noexcept : _limiter(other._limiter) { other._limiter = nullptr; }
+    Permit(const Permit&) = delete;
+    Permit& operator=(const Permit&) = delete;
+    Permit& operator=(Permit&&) = delete;
+    ~Permit()
+    {
+      if (_limiter != nullptr) _limiter->release();
+    }
+  };
+
+  /// \param shared_dir when given, the bucket is shared with the processes using the same directory
+  RateLimiter(string host, RateLimit limit, const std::optional<string>& shared_dir = std::nullopt);
+
+  /// The limiter of [host] (`name[:port]`), shared by the whole process and created with the limit configured for it
+  static RateLimiter& for_host(const string& host);
+
+  /// Limit the requests to [host], or to every host that has no limit of its own when empty
+  static void configure(const string& host, RateLimit limit);
+
+  /// Share the buckets of every host with the processes using [dir]
+  /// \throws NotAFile if [dir] can't be created
+  static void share_through(const string& dir);
+
+  /// The host of [url], `name[:port]`
+  static string host_of(const string& url);
+
+  /// Wait until a request can be sent to the host. The time waited is recorded in the `throttle_seconds` metrics.
+  Permit acquire();
+
+  /// Hold every request to the host for [delay], e.g. as asked by a `Retry-After`
+  void back_off(std::chrono::milliseconds delay);
+
+  [[nodiscard]] const string& host() const { return _host; }
+};
+
+}  // namespace fyber
@@ -0,0 +1,293 @@
+#include "Report.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+#include "common.h"
+#include "exit_message.h"
+#include "rapidjson/document.h"
+#include "rapidjson/prettywriter.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include "spdlog/spdlog.h"
+
+namespace fyber {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+bool shard_less(const Shard& left, const Shard& right)
+{
+  return left.count != right.count ? left.count < right.count : left.index < right.index;
+}
+
+/// Get the member [name] of [object], failing unless [is_valid]
+template <typename V, typename P>
+const rapidjson::Value& member(const V& object, const char* name, P is_valid, const string& path)
+{
+  if (!object.IsObject() or !object.HasMember(name) or !is_valid(object[name])) {
+    throw ExitMessage::InvalidArguments("Report `" + path + "` is invalid : bad or missing `" + name + "`");
+  }
+  return object[name];
+}
+
+/// Serialize the result of a plist, as a member of `projects`
+template <typename W>
+void write_project(W& writer, const UpdateResult& project)
+{
+  writer.StartObject();
+  writer.Key("plist_file_path");
+  writer.String(project.plist_file_path.c_str());
+  writer.Key("status");
+  writer.String(UpdateResult::status_name(project.status));
+  writer.Key("exit_code");
+  writer.Int(project.exit_code);
+  writer.Key("error");
+  writer.String(project.error.c_str());
+  writer.Key("dry_run");
+  writer.Bool(project.dry_run);
+
+  writer.Key("existing");
+  writer.StartArray();
+  for (const auto& id : project.existing) writer.String(id.c_str());
+  writer.EndArray();
+
+  writer.Key("added");
+  writer.StartObject();
+  for (const auto& [network, ids] : project.added) {
+    writer.Key(network.c_str());
+    writer.StartArray();
+    for (const auto& id : ids) writer.String(id.c_str());
+    writer.EndArray();
+  }
+  writer.EndObject();
+
+  writer.Key("backup_path");
+  writer.String(project.backup_path.c_str());
+  writer.Key("cache");
+  writer.String(ManagerApi::source_name(project.source));
+
+  writer.Key("timings");
+  writer.StartObject();
+  writer.Key("read");
+  writer.Double(project.timings.read);
+  writer.Key("fetch");
+  writer.Double(project.timings.fetch);
+  writer.Key("write");
+  writer.Double(project.timings.write);
+  writer.Key("total");
+  writer.Double(project.timings.total);
+  writer.EndObject();
+
+  writer.EndObject();
+}
+
+}  // namespace
+
+Report::Report(const optional<Shard>& shard)
+{
+  if (shard.has_value()) _shards.push_back(shard.value());
+}
+
+void Report::add(UpdateResult result)
+{
+  _projects.push_back(std::move(result));
+}
+
+ReportSummary Report::summary() const
+{
+  ReportSummary summary;
+
+  for (const auto& project : _projects) {
+    switch (project.status) {
+      case UpdateResult::Status::Updated:
+        summary.updated++;
+        break;
+      case UpdateResult::Status::WouldUpdate:
+        summary.would_update++;
+        break;
+      case UpdateResult::Status::Unchanged:
+        summary.unchanged++;
+        break;
+      case UpdateResult::Status::Failed:
+        summary.failed++;
+        break;
+    }
+
+    if (project.status != UpdateResult::Status::Updated) continue;
+    for (const auto& [network, ids] : project.added) summary.ids_added[network] += ids.size();
+  }
+
+  return summary;
+}
+
+string Report::to_json() const
+{
+  rapidjson::StringBuffer buffer;
+  rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+
+  writer.StartObject();
+
+  writer.Key("version");
+  writer.Int(format_version);
+
+  writer.Key("shards");
+  writer.StartArray();
+  for (const auto& shard : _shards) writer.String(shard.to_string().c_str());
+  writer.EndArray();
+
+  auto totals = summary();
+  writer.Key("summary");
+  writer.StartObject();
+  writer.Key("updated");
+  writer.Uint64(totals.updated);
+  writer.Key("would_update");
+  writer.Uint64(totals.would_update);
+  writer.Key("unchanged");
+  writer.Uint64(totals.unchanged);
+  writer.Key("failed");
+  writer.Uint64(totals.failed);
+  writer.Key("ids_added");
+  writer.StartObject();
+  for (const auto& [network, count] : totals.ids_added) {
+    writer.Key(network.c_str());
+    writer.Uint64(count);
+  }
+  writer.EndObject();
+  writer.EndObject();
+
+  writer.Key("projects");
+  writer.StartArray();
+  for (const auto& project : _projects) write_project(writer, project);
+  writer.EndArray();
+
+  writer.EndObject();
+
+  return string(buffer.GetString(), buffer.GetSize());
+}
+
+string Report::to_json_line(const UpdateResult& project)
+{
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+  write_project(writer, project);
+
+  return string(buffer.GetString(), buffer.GetSize());
+}
+
+void Report::write(const string& path) const
+{
+  // Written aside and renamed, so readers never see a partial report
+  const string temp_path = path + ".tmp";
+  {
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    file << to_json() << '\n';
+    if (!file) throw ExitMessage::NotAFile("Unable to write the report `" + path + "`");
+  }
+  fs::rename(temp_path, path);
+}
+
+Report Report::read(const string& path)
+{
+  auto content = common::read_text_input(path, "report");
+
+  rapidjson::Document document;
+  document.Parse(content.c_str());
+  if (document.HasParseError() or !document.IsObject()) {
+    throw ExitMessage::InvalidArguments("Report `" + path + "` is invalid : not a JSON object");
+  }
+
+  auto is_int = [](const rapidjson::Value& v) { return v.IsInt(); };
+  auto is_string = [](const rapidjson::Value& v) { return v.IsString(); };
+  auto is_array = [](const rapidjson::Value& v) { return v.IsArray(); };
+  auto is_object = [](const rapidjson::Value& v) { return v.IsObject(); };
+  auto is_bool = [](const rapidjson::Value& v) { return v.IsBool(); };
+  auto is_number = [](const rapidjson::Value& v) { return v.IsNumber(); };
+
+  if (member(document, "version", is_int, path).GetInt() != format_version) {
+    throw ExitMessage::InvalidArguments("Report `" + path + "` has an unsupported version");
+  }
+
+  Report report;
+
+  for (const auto& shard : member(document, "shards", is_array, path).GetArray()) {
+    if (!shard.IsString()) throw ExitMessage::InvalidArguments("Report `" + path + "` is invalid : bad `shards`");
+    report._shards.push_back(Shard::parse(shard.GetString()));
+  }
+
+  for (const auto& project : member(document, "projects", is_array, path).GetArray()) {
+    UpdateResult result;
+    result.plist_file_path = member(project, "plist_file_path", is_string, path).GetString();
+    result.status = UpdateResult::status_by_name(member(project, "status", is_string, path).GetString());
+    result.exit_code = member(project, "exit_code", is_int, path).GetInt();
+    result.error = member(project, "error", is_string, path).GetString();
+    result.dry_run = member(project, "dry_run", is_bool, path).GetBool();
+
+    for (const auto& id : member(project, "existing", is_array, path).GetArray()) {
+      if (!id.IsString()) throw ExitMessage::InvalidArguments("Report `" + path + "` is invalid : bad `existing`");
+      result.existing.emplace_back(std::string_view(id.GetString(), id.GetStringLength()));
+    }
+
+    for (const auto& added : member(project, "added", is_object, path).GetObject()) {
+      if (!added.value.IsArray()) throw ExitMessage::InvalidArguments("Report `" + path + "` is invalid : bad `added`");
+
+      auto& ids = result.added[Symbol(std::string_view(added.name.GetString(), added.name.GetStringLength()))];
+      for (const auto& id : added.value.GetArray()) {
+        if (!id.IsString()) throw ExitMessage::InvalidArguments("Report `" + path + "` is invalid : bad `added`");
+        ids.emplace_back(std::string_view(id.GetString(), id.GetStringLength()));
+      }
+    }
+
+    result.backup_path = member(project, "backup_path", is_string, path).GetString();
+    result.source = ManagerApi::source_by_name(member(project, "cache", is_string, path).GetString());
+
+    const auto& timings = member(project, "timings", is_object, path);
+    result.timings.read = member(timings, "read", is_number, path).GetDouble();
+    result.timings.fetch = member(timings, "fetch", is_number, path).GetDouble();
+    result.timings.write = member(timings, "write", is_number, path).GetDouble();
+    result.timings.total = member(timings, "total", is_number, path).GetDouble();
+
+    report._projects.push_back(std::move(result));
+  }
+
+  return report;
+}
+
+Report Report::merge(const vector<Report>& reports)
+{
+  Report merged;
+
+  for (const auto& report : reports) {
+    merged._shards.insert(merged._shards.end(), report._shards.begin(), report._shards.end());
+    merged._projects.insert(merged._projects.end(), report._projects.begin(), report._projects.end());
+  }
+
+  std::sort(merged._shards.begin(), merged._shards.end(), shard_less);
+
+  if (merged._shards.empty()) return merged;
+
+  const int count = merged._shards.front().count;
+  if (merged._shards.back().count != count) {
+    throw ExitMessage::InvalidArguments("Reports of different shardings can't be merged");
+  }
+
+  vector<string> missing;
+  int expected = 1;
+  for (const auto& shard : merged._shards) {
+    if (shard.index < expected) {
+      throw ExitMessage::InvalidArguments("Shard " + shard.to_string() + " is reported more than once");
+    }
+    for (; expected < shard.index; ++expected) missing.push_back(Shard{expected, count}.to_string());
+    expected = shard.index + 1;
+  }
+  for (; expected <= count; ++expected) missing.push_back(Shard{expected, count}.to_string());
+
+  if (!missing.empty()) spdlog::warn("Missing the reports of shards: {}", common::join(missing, ", "));
+
+  return merged;
+}
+
+}  // namespace fyber
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Batch.h"
+#include "Symbol.h"
+#include "Updater.h"
+
+namespace fyber {
+
+using std::map;
+using std::optional;
+using std::string;
+using std::vector;
+
+/// Totals of a report
+struct ReportSummary
+{
+  size_t updated = 0;
+  /// Dry runs that would have updated their plist
+  size_t would_update = 0;
+  size_t unchanged = 0;
+  size_t failed = 0;
+  /// The number of SKAdNetwork IDs added, by network. Dry runs add none
+  map<Symbol, size_t> ids_added;
+};
+
+/// The results of a (possibly sharded) batch run, as a JSON document that can be merged with the reports of the other
+/// shards.
+class Report
+{
+ private:
+  /// The shards covered by the report, sorted. Empty when the run wasn't sharded.
+  vector<Shard> _shards;
+  vector<UpdateResult> _projects;
+
+  inline static const int format_version = 1;
+
+ public:
+  Report() = default;
+  explicit Report(const optional<Shard>& shard);
+
+  void add(UpdateResult result);
+
+  [[nodiscard]] const vector<UpdateResult>& projects() const { return _projects; }
+  [[nodiscard]] const vector<Shard>& shards() const { return _shards; }
+
+  [[nodiscard]] ReportSummary summary() const;
+
+  /// Serialize the report and its summary
+  [[nodiscard]] string to_json() const;
+
+  /// Serialize the result of a single plist on one line, as in JSON Lines
+  static string to_json_line(const UpdateResult& project);
+
+  /// Write the report to [path]
+  void write(const string& path) const;
+
+  /// Load a report written by `write`
+  /// \throws NotAFile or InvalidArguments if [path] isn't a valid report
+  static Report read(const string& path);
+
+  /// Combine the reports of the shards of a single run.
+  /// \throws InvalidArguments if the reports belong to different shardings or repeat a shard
+  static Report merge(const vector<Report>& reports);
+};
+
+}  // namespace fyber
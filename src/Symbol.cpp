@@ -0,0 +1,48 @@
+#include "Symbol.h"
+
+namespace fyber {
+
+Symbol::Symbol(std::string_view text) : Symbol(SymbolTable::global().intern(text)) {}
+
+SymbolTable& SymbolTable::global()
+{
+  static auto* table = new SymbolTable();  // never destroyed, symbols stay valid during static destruction
+  return *table;
+}
+
+Symbol SymbolTable::intern(std::string_view text)
+{
+  if (text.empty()) return Symbol();
+
+  std::lock_guard lock(_mutex);
+
+  auto found = _entries.find(text);
+  if (found == _entries.end()) {
+    // The set's nodes are stable, so the stored view's address identifies the string
+    found = _entries.insert(_arena.copy(text)).first;
+  }
+
+  return Symbol(&*found);
+}
+
+Symbol SymbolTable::intern_static(std::string_view text)
+{
+  if (text.empty()) return Symbol();
+
+  std::lock_guard lock(_mutex);
+  return Symbol(&*_entries.insert(text).first);
+}
+
+size_t SymbolTable::size() const
+{
+  std::lock_guard lock(_mutex);
+  return _entries.size();
+}
+
+size_t SymbolTable::bytes() const
+{
+  std::lock_guard lock(_mutex);
+  return _arena.bytes();
+}
+
+}  // namespace fyber
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+#include "Arena.h"
+
+namespace fyber {
+
+/// A handle to an interned string (a network name or a SKAdNetwork ID). <br/>
+/// Equal strings share a single handle, so equality is a pointer comparison, and each distinct string is stored once
+/// for the whole process.
+class Symbol
+{
+ private:
+  inline static const std::string_view empty_entry{""};
+
+  const std::string_view* _entry;
+
+  friend class SymbolTable;
+  friend struct std::hash<Symbol>;
+  explicit Symbol(const std::string_view* entry) : _entry(entry) {}
+
+ public:
+  /// The empty symbol
+  Symbol() : _entry(&empty_entry) {}
+
+  /// Intern [text] in the process-wide symbol table
+  explicit Symbol(std::string_view text);
+  explicit Symbol(const char* text) : Symbol(std::string_view(text)) {}
+  explicit Symbol(const std::string& text) : Symbol(std::string_view(text)) {}
+
+  [[nodiscard]] std::string_view view() const { return *_entry; }
+
+  /// Null-terminated, valid for the life of the process
+  [[nodiscard]] const char* c_str() const { return _entry->data(); }
+
+  [[nodiscard]] std::string str() const { return std::string(*_entry); }
+
+  [[nodiscard]] bool empty() const { return _entry->empty(); }
+
+  operator std::string_view() const { return *_entry; }
+
+  bool operator==(const Symbol& other) const { return _entry == other._entry; }
+  bool operator!=(const Symbol& other) const { return _entry != other._entry; }
+
+  /// Lexicographic, so ordered containers of symbols keep the order of the equivalent strings
+  bool operator<(const Symbol& other) const { return _entry != other._entry and *_entry < *other._entry; }
+};
+
+inline std::ostream& operator<<(std::ostream& stream, const Symbol& symbol)
+{
+  return stream << symbol.view();
+}
+
+/// The process-wide table of interned strings, backed by a single arena.
+class SymbolTable
+{
+ private:
+  mutable std::mutex _mutex;
+  memory::Arena _arena;
+  std::unordered_set<std::string_view> _entries;
+
+  SymbolTable() = default;
+
+ public:
+  static SymbolTable& global();
+
+  /// Get the symbol of [text], storing it on first use
+  Symbol intern(std::string_view text);
+
+  /// Get the symbol of [text], referencing it on first use rather than storing a copy.
+  /// [text] must be null-terminated and live as long as the process, e.g. a string literal
+  Symbol intern_static(std::string_view text);
+
+  /// Number of distinct strings
+  [[nodiscard]] size_t size() const;
+
+  /// Bytes used by the distinct strings
+  [[nodiscard]] size_t bytes() const;
+};
+
+}  // namespace fyber
+
+template <>
+struct std::hash<fyber::Symbol>
+{
+  size_t operator()(const fyber::Symbol& symbol) const noexcept { return std::hash<const void*>()(symbol._entry); }
+};
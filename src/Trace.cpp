@@ -0,0 +1,88 @@
+#include "Trace.h"
+
+#include <fstream>
+
+#include "exit_message.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+namespace fyber {
+
+namespace {
+
+int64_t microseconds(Trace::Clock::duration duration)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+}  // namespace
+
+Trace::Span::Span(string name) : _recorded(Trace::global().enabled())
+{
+  if (!_recorded) return;
+  _name = std::move(name);
+  _start = Clock::now();
+}
+
+Trace::Span::~Span()
+{
+  if (_recorded) Trace::global().add(_name, _start, Clock::now());
+}
+
+Trace& Trace::global()
+{
+  static Trace trace;
+  return trace;
+}
+
+void Trace::add(const string& name, Clock::time_point start, Clock::time_point end)
+{
+  std::lock_guard lock(_mutex);
+  auto thread = _threads.emplace(std::this_thread::get_id(), _threads.size() + 1).first->second;
+  _events.push_back(Event{name, microseconds(start - _origin), microseconds(end - start), thread});
+}
+
+string Trace::to_json() const
+{
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+  writer.StartObject();
+  writer.Key("traceEvents");
+  writer.StartArray();
+  {
+    std::lock_guard lock(_mutex);
+    for (const auto& event : _events) {
+      // Complete events, a begin and a duration
+      writer.StartObject();
+      writer.Key("name");
+      writer.String(event.name.c_str(), static_cast<rapidjson::SizeType>(event.name.size()));
+      writer.Key("ph");
+      writer.String("X");
+      writer.Key("ts");
+      writer.Int64(event.start);
+      writer.Key("dur");
+      writer.Int64(event.duration);
+      writer.Key("pid");
+      writer.Int(1);
+      writer.Key("tid");
+      writer.Uint64(event.thread);
+      writer.EndObject();
+    }
+  }
+  writer.EndArray();
+  writer.Key("displayTimeUnit");
+  writer.String("ms");
+  writer.EndObject();
+
+  return string(buffer.GetString(), buffer.GetSize());
+}
+
+void Trace::write(const string& path) const
+{
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file << to_json() << '\n';
+  if (!file) throw ExitMessage::NotAFile("Unable to write the trace `" + path + "`");
+}
+
+}  // namespace fyber
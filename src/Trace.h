@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fyber {
+
+using std::string;
+
+/// The stages of a run on a timeline, by thread, showing which of them overlap. <br/>
+/// Written in the trace event format read by `chrome://tracing` and Perfetto (see `trace_file`). Nothing is recorded
+/// until it's enabled.
+class Trace
+{
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /// The time from its construction to its destruction, recorded as a span of the global trace when it's enabled
+  class Span
+  {
+   private:
+    string _name;
+    Clock::time_point _start;
+    bool _recorded;
+
+   public:
+    explicit Span(string name);
+    ~Span();
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+  };
+
+ private:
+  struct Event
+  {
+    string name;
+    /// Microseconds since the trace started
+    int64_t start;
+    int64_t duration;
+    /// Threads are numbered from 1, in the order of their first span
+    size_t thread;
+  };
+
+  std::atomic<bool> _enabled = false;
+  const Clock::time_point _origin = Clock::now();
+
+  mutable std::mutex _mutex;
+  std::vector<Event> _events;
+  std::map<std::thread::id, size_t> _threads;
+
+ public:
+  static Trace& global();
+
+  void enable() { _enabled = true; }
+  [[nodiscard]] bool enabled() const { return _enabled; }
+
+  /// Record the span [name] from [start] to [end], on the calling thread
+  void add(const string& name, Clock::time_point start, Clock::time_point end);
+
+  /// The spans recorded so far, as a trace event document
+  [[nodiscard]] string to_json() const;
+
+  /// \throws NotAFile if [path] can't be written
+  void write(const string& path) const;
+};
+
+}  // namespace fyber
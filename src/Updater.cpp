@@ -0,0 +1,270 @@
+#include "Updater.h"
+
+#include <exception>
+#include <unordered_set>
+
+#include "AllocStats.h"
+#include "Metrics.h"
+#include "PodFile.h"
+#include "Trace.h"
+#include "common.h"
+#include "exit_message.h"
+#include "logging.h"
+#include "spdlog/spdlog.h"
+
+namespace fyber {
+
+//------------------- UpdateResult -----------------------------------------------
+
+const char* UpdateResult::status_name(Status status)
+{
+  switch (status) {
+    case Status::Updated:
+      return "updated";
+    case Status::WouldUpdate:
+      return "would_update";
+    case Status::Unchanged:
+      return "unchanged";
+    case Status::Failed:
+      return "failed";
+  }
+  return "";
+}
+
+UpdateResult::Status UpdateResult::status_by_name(const string& name)
+{
+  if (name == "updated") return Status::Updated;
+  if (name == "would_update") return Status::WouldUpdate;
+  if (name == "unchanged") return Status::Unchanged;
+  if (name == "failed") return Status::Failed;
+
+  throw ExitMessage::InvalidArguments("Unknown update status `" + name + "`");
+}
+
+//------------------- Updater -----------------------------------------------
+
+Updater::Updater(const ManagerApi& manager_api) : _manager_api(manager_api) {}
+
+vector<Symbol> Updater::networks_list_by_podfile(const string& pod_file_path, const optional<string>& pod_target) const
+{
+  auto supported_networks = _manager_api.get_networks();
+
+  auto podfile = [&] {
+    Trace::Span span("parse Podfile");
+    return PodFile(pod_file_path, supported_networks);
+  }();
+
+  if (pod_target.has_value()) {
+    auto networks = podfile.get_target_networks(pod_target.value());
+    if (networks.empty()) {
+      throw ExitMessage::EmptyPodFile("No supported networks found for the target `" + pod_target.value() +
+                                      "` of your Podfile");
+    }
+    return networks;
+  }
+
+  auto networks = podfile.get_used_networks();
+
+  if (networks.empty()) {
+    throw ExitMessage::EmptyPodFile("No supported networks found in your Podfile");
+  }
+
+  return networks;
+}
+
+vector<Symbol> Updater::networks_list_by_options(const vector<Symbol>& networks)
+{
+  if (networks.empty()) {
+    throw ExitMessage::EmptyNetworkList("A non-empty list of networks must be provided");
+  }
+  return networks;
+}
+
+void Updater::merge_network_lists(vector<Symbol>& base_networks, const vector<Symbol>& networks_to_merge)
+{
+  std::unordered_set<Symbol> seen;
+  seen.reserve(base_networks.size() + networks_to_merge.size());
+
+  size_t kept = 0;
+  for (const auto& network : base_networks) {
+    if (seen.insert(network).second) base_networks[kept++] = network;
+  }
+  base_networks.resize(kept);
+
+  for (const auto& network : networks_to_merge) {
+    if (seen.insert(network).second) base_networks.push_back(network);
+  }
+}
+
+vector<Symbol> Updater::resolve_networks(const optional<string>& pod_file_path,
+                                         const optional<vector<Symbol>>& network_list,
+                                         const optional<string>& pod_target) const
+{
+  vector<Symbol> networks;
+
+  if (pod_file_path.has_value()) {
+    networks = networks_list_by_podfile(pod_file_path.value(), pod_target);
+  }
+
+  if (network_list.has_value()) {
+    vector<Symbol> explicit_network_list = networks_list_by_options(network_list.value());
+
+    merge_network_lists(networks, explicit_network_list);
+  }
+
+  return networks;
+}
+
+std::shared_future<vector<Symbol>> Updater::resolve_networks_async(const optional<string>& pod_file_path,
+                                                                   const optional<vector<Symbol>>& network_list,
+                                                                   const optional<string>& pod_target) const
+{
+  // An explicit list alone is resolved at once
+  if (!pod_file_path.has_value()) {
+    std::promise<vector<Symbol>> networks;
+    try {
+      networks.set_value(resolve_networks(pod_file_path, network_list, pod_target));
+    } catch (...) {
+      networks.set_exception(std::current_exception());
+    }
+    return networks.get_future().share();
+  }
+
+  auto networks = std::async(std::launch::async, [this, pod_file_path, network_list, pod_target] {
+    return resolve_networks(pod_file_path, network_list, pod_target);
+  });
+  return networks.share();
+}
+
+bool Updater::compute_diff(Plist& plist, const vector<Symbol>& networks, ResponseSource* source) const
+{
+  memory::PhaseScope phase(memory::Phase::Diff);
+  return plist.set_sk_ad_network_items_for_update(_manager_api.get_sk_ad_networks(networks, source));
+}
+
+void Updater::apply(Plist& plist, bool dry_run, const optional<string>& output)
+{
+  spdlog::info("Updating `{}`", plist.file_path());
+
+  const std::string& raw_new_file = plist.build_plist_SKAdNetworkItems();
+
+  if (dry_run) {
+    spdlog::info("These network IDs will be added: {}", plist.new_sk_ad_network_items_str());
+    SKAD_DEBUG("Printing modified `{}`", plist.file_path());
+    SKAD_DEBUG(raw_new_file);
+  } else if (output.has_value()) {
+    plist.save_as(output.value());
+  } else {
+    plist.update_file(true);
+  }
+}
+
+UpdateResult Updater::update(const string& plist_file_path, const optional<string>& pod_file_path,
+                             const optional<vector<Symbol>>& network_list, bool dry_run, const optional<string>& output,
+                             const optional<string>& pod_target) const
+{
+  try {
+    auto result = update_plist(plist_file_path, pod_file_path, network_list, dry_run, output, pod_target);
+
+    Metrics::global().increment(Metrics::plists, {{"status", UpdateResult::status_name(result.status)}});
+    if (!dry_run) {
+      size_t added = 0;
+      for (const auto& [network, ids] : result.added) added += ids.size();
+      Metrics::global().increment(Metrics::ids_added, {}, static_cast<double>(added));
+    }
+
+    return result;
+  } catch (...) {
+    Metrics::global().increment(Metrics::plists, {{"status", UpdateResult::status_name(UpdateResult::Status::Failed)}});
+    throw;
+  }
+}
+
+UpdateResult Updater::update_plist(const string& plist_file_path, const optional<string>& pod_file_path,
+                                   const optional<vector<Symbol>>& network_list, bool dry_run,
+                                   const optional<string>& output, const optional<string>& pod_target) const
+{
+  if (!pod_file_path.has_value() and !network_list.has_value()) {
+    throw ExitMessage::InvalidArguments(
+        "At least one of the parameters `network_list`, `network_list_file` or `pod_file_path` is required.");
+  }
+
+  // Known before anything is fetched: a fetch started is waited for, even when the plist then fails to parse
+  Plist::check_path(plist_file_path);
+  if (common::is_stream(plist_file_path) and !output.has_value() and !dry_run) {
+    throw ExitMessage::InvalidArguments("`output` is required when the plist is read from a stream");
+  }
+
+  Stopwatch total;
+
+  UpdateResult result;
+  result.plist_file_path = plist_file_path;
+  result.dry_run = dry_run;
+
+  // The IDs only depend on the networks: the networks are resolved and their IDs fetched while the plist is parsed,
+  // the failures of either come out once the plist is parsed
+  Stopwatch fetch_step;
+  auto networks = resolve_networks_async(pod_file_path, network_list, pod_target);
+  auto sk_ad_networks = _manager_api.get_sk_ad_networks_async(networks, &result.source);
+
+  Stopwatch step;
+  auto plist = [&] {
+    Trace::Span span("parse plist");
+    return Plist(plist_file_path);
+  }();
+  result.timings.read = step.elapsed().count();
+
+  const auto& existing = plist.existing_sk_ad_network_items();
+  result.existing.assign(existing.begin(), existing.end());
+
+  spdlog::info("Existing SKAdNetworks: {}", plist.existing_sk_ad_network_items_str());
+
+  spdlog::info("Fetching SKAdNetworks for: {}", common::join(networks.get(), ", "));
+
+  {
+    auto ids = sk_ad_networks.get();
+    result.timings.fetch = fetch_step.elapsed().count();
+
+    Trace::Span span("diff");
+    memory::PhaseScope phase(memory::Phase::Diff);
+    plist.set_sk_ad_network_items_for_update(ids);
+  }
+
+  spdlog::info("New SKAdNetworks: {}", plist.new_sk_ad_network_items_str());
+
+  if (plist.should_update()) {
+    step = Stopwatch();
+    {
+      Trace::Span span("write plist");
+      apply(plist, dry_run, output);
+    }
+    result.timings.write = step.elapsed().count();
+
+    result.status = dry_run ? UpdateResult::Status::WouldUpdate : UpdateResult::Status::Updated;
+    result.added = added_by_network(plist);
+    result.backup_path = plist.backup_path();
+  } else {
+    spdlog::info("Nothing to update. `{}` unchanged.", plist_file_path);
+
+    // Passed through, so the output is there whatever the outcome
+    if (output.has_value() and !dry_run) plist.save_as(output.value());
+  }
+
+  result.timings.total = total.elapsed().count();
+  return result;
+}
+
+map<Symbol, vector<Symbol>> Updater::added_by_network(const Plist& plist)
+{
+  map<Symbol, vector<Symbol>> added;
+
+  for (const auto& [network, ids] : plist.network_items_mapping()) {
+    for (const auto& id : ids) {
+      if (plist.new_sk_ad_network_items().count(id) > 0) added[network].push_back(id);
+    }
+  }
+
+  return added;
+}
+
+}  // namespace fyber
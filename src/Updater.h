@@ -0,0 +1,132 @@
+#pragma once
+#include <future>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "ManagerApi.h"
+#include "Plist.h"
+#include "Symbol.h"
+
+namespace fyber {
+
+using std::map;
+using std::optional;
+using std::string;
+using std::vector;
+
+/// The outcome of updating a single `Info.plist`
+struct UpdateResult
+{
+  enum class Status
+  {
+    Updated,
+    /// A dry run that would have updated the plist
+    WouldUpdate,
+    Unchanged,
+    Failed
+  };
+
+  /// Durations of the steps of an update, in seconds. <br/>
+  /// The networks are resolved and their IDs fetched while the plist is read, so `read` and `fetch` overlap.
+  struct Timings
+  {
+    double read = 0;
+    double fetch = 0;
+    double write = 0;
+    double total = 0;
+  };
+
+  string plist_file_path;
+  Status status = Status::Unchanged;
+  int exit_code = 0;
+  string error;
+  bool dry_run = false;
+  /// The SKAdNetwork IDs the plist had before the update
+  vector<Symbol> existing;
+  /// The added SKAdNetwork IDs (the ones that would be added on a dry run), by the network that introduced them
+  map<Symbol, vector<Symbol>> added;
+  /// Empty unless a backup was written
+  string backup_path;
+  /// Where the SKAdNetwork IDs were served from
+  ResponseSource source = ResponseSource::Server;
+  Timings timings;
+
+  static const char* status_name(Status status);
+  static Status status_by_name(const string& name);
+};
+
+/// Drives the update of a single `Info.plist`: resolving the requested networks, finding the new SKAdNetwork IDs and
+/// applying them. The plist is parsed while the networks are resolved and their IDs fetched, on other threads. <br/>
+/// Its path is checked before anything is fetched, but a plist that fails to parse still waits for the fetch in
+/// flight, up to the `phase_deadline` of the service.
+class Updater
+{
+ private:
+  const ManagerApi& _manager_api;
+
+  UpdateResult update_plist(const string& plist_file_path, const optional<string>& pod_file_path,
+                            const optional<vector<Symbol>>& network_list, bool dry_run, const optional<string>& output,
+                            const optional<string>& pod_target) const;
+
+ public:
+  explicit Updater(const ManagerApi& manager_api);
+
+  /// Get the list of networks to fetch, as defined in the podfile
+  /// \param pod_file_path - path to the podfile
+  /// \param pod_target - when given, only the networks of this target of the podfile
+  /// \return a list of network names
+  /// \throws EmptyPodFile if the pod file (or target) doesn't contain supported network names.
+  /// \throws InvalidPodFile if [pod_target] isn't a target of the podfile
+  [[nodiscard]] vector<Symbol> networks_list_by_podfile(const string& pod_file_path,
+                                                        const optional<string>& pod_target = std::nullopt) const;
+
+  /// Get the list of networks to fetch provided explicitly
+  /// \param networks - network names
+  /// \return a list of network names
+  /// \throws EmptyNetworkList if the provided list is empty
+  static vector<Symbol> networks_list_by_options(const vector<Symbol>& networks);
+
+  /// Merge two network lists uniquely while perserving order, in linear time </br>
+  /// <b> NOTE: </b> This is function is mutating [base_networks], dropping its own duplicates as well
+  /// \param base_networks the list to merge into
+  /// \param networks_to_merge the list that will be merged
+  static void merge_network_lists(vector<Symbol>& base_networks, const vector<Symbol>& networks_to_merge);
+
+  /// Resolve the networks required by a podfile and/or an explicit list of networks.
+  /// The podfile networks come first, followed by the explicit ones which are not already listed.
+  [[nodiscard]] vector<Symbol> resolve_networks(const optional<string>& pod_file_path,
+                                                const optional<vector<Symbol>>& network_list,
+                                                const optional<string>& pod_target = std::nullopt) const;
+
+  /// `resolve_networks` on a thread of its own when there's a podfile to fetch the supported networks for and to parse
+  /// \return the networks, or the failure to resolve them
+  [[nodiscard]] std::shared_future<vector<Symbol>> resolve_networks_async(
+      const optional<string>& pod_file_path, const optional<vector<Symbol>>& network_list,
+      const optional<string>& pod_target = std::nullopt) const;
+
+  /// Fetch the SKAdNetwork IDs of [networks] and set up [plist] for update
+  /// \param source when given, set to where the IDs were served from
+  /// \return whether there's something to update in the actual file
+  bool compute_diff(Plist& plist, const vector<Symbol>& networks, ResponseSource* source = nullptr) const;
+
+  /// Update or Print (on [dry_run]) the Info.Plist file
+  /// \param output when given, the updated plist is written there (`-` for stdout) rather than in place
+  static void apply(Plist& plist, bool dry_run, const optional<string>& output = std::nullopt);
+
+  /// Run the whole update of the plist in [plist_file_path] for the networks of a podfile and/or an explicit list.
+  /// Counted in the run `Metrics`, by status.
+  /// \throws ExitMessage on failure
+  /// \param output when given, the plist is written there (`-` for stdout), updated or not, rather than in place
+  /// \param pod_target when given, only the networks of this target of the podfile are used
+  UpdateResult update(const string& plist_file_path, const optional<string>& pod_file_path,
+                      const optional<vector<Symbol>>& network_list, bool dry_run,
+                      const optional<string>& output = std::nullopt,
+                      const optional<string>& pod_target = std::nullopt) const;
+
+  /// The IDs of [plist] that are new, by the network that introduced them. Set by `compute_diff`
+  static map<Symbol, vector<Symbol>> added_by_network(const Plist& plist);
+};
+
+}  // namespace fyber
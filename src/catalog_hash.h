@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace fyber::catalog {
+
+/// The SKAdNetwork IDs of a network in the catalog compiled into the binary
+struct Entry
+{
+  std::string_view network;
+  const std::string_view* ids;
+  size_t size;
+};
+
+/// FNV-1a of [text], salted with [seed]. <br/>
+/// Shared by `embed_catalog`, which searches for a seed without collisions, and the lookups of the generated table.
+constexpr uint32_t hash(std::string_view text, uint32_t seed)
+{
+  uint32_t hash = 2166136261u ^ seed;
+  for (char c : text) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/// The entry of [network] in a perfect-hash table of [slot_count] (a power of two) slots, or `nullptr`. <br/>
+/// [slots] holds the index of an entry in [entries], or -1 for an empty slot.
+constexpr const Entry* find(std::string_view network, const Entry* entries, const int32_t* slots, size_t slot_count,
+                            uint32_t seed)
+{
+  if (slot_count == 0) return nullptr;
+
+  auto slot = slots[hash(network, seed) & (slot_count - 1)];
+  if (slot < 0 or entries[slot].network != network) return nullptr;
+  return &entries[slot];
+}
+
+}  // namespace fyber::catalog
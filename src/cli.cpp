@@ -1,5 +1,7 @@
 #include "cli.h"
 
+#include <cstring>
+#include <functional>
 #include <utility>
 
 #include "common.h"
@@ -17,13 +19,21 @@ using std::vector;
 //------------------- Options -----------------------------------------------
 
 Options::Options(optional<string> showHelp, optional<string> plistPath, optional<string> podPath,
-                 optional<vector<string>> networkList, bool dryRun, bool showNetworks)
+                 optional<vector<Symbol>> networkList, bool dryRun, bool showNetworks, BatchOptions batchOptions,
+                 CacheOptions cacheOptions, optional<ReportFormat> reportFormat, optional<string> outputPath,
+                 optional<string> podTarget, Limits limitsOptions)
     : show_help(std::move(showHelp)),
       plist_file_path(move(plistPath)),
       pod_file_path(move(podPath)),
       network_list(move(networkList)),
       dry_run(dryRun),
-      show_networks(showNetworks)
+      show_networks(showNetworks),
+      batch(std::move(batchOptions)),
+      cache(std::move(cacheOptions)),
+      report(reportFormat),
+      output(std::move(outputPath)),
+      pod_target(std::move(podTarget)),
+      limits(limitsOptions)
 {}
 
 string Options::to_string() const
@@ -32,9 +42,29 @@ string Options::to_string() const
   stream << "{\nhelp: " << show_help.has_value();
   stream << "\n plist_file_path: " << plist_file_path.value_or("");
   stream << "\n pod_file_path: " << pod_file_path.value_or("");
+  stream << "\n pod_target: " << pod_target.value_or("");
   stream << "\n network_list: " << (network_list.has_value() ? common::join(network_list.value(), ",") : "");
   stream << "\n dry_run: " << dry_run;
   stream << "\n show_networks: " << show_networks;
+  stream << "\n batch_file: " << batch.batch_file.value_or("");
+  stream << "\n discover_dir: " << batch.discover_dir.value_or("");
+  stream << "\n shard: " << (batch.shard.has_value() ? batch.shard->to_string() : "");
+  stream << "\n shard_report: " << batch.shard_report.value_or("");
+  stream << "\n cache_dir: " << cache.cache_dir.value_or("");
+  stream << "\n cache_ttl: " << (cache.cache_ttl_seconds.has_value() ? std::to_string(*cache.cache_ttl_seconds) : "");
+  stream << "\n rate_limits: " << cache.rate_limits.size();
+  stream << "\n compression: " << cache.compression;
+  stream << "\n post_queries: " << cache.post_queries;
+  stream << "\n catalog_sync: " << cache.catalog_sync;
+  stream << "\n limits: " << limits.max_plist_bytes << "/" << limits.max_podfile_bytes << "/"
+         << limits.max_response_bytes << " bytes, depth " << limits.max_xml_depth << ", " << limits.max_ids_per_network
+         << " IDs, " << limits.phase_deadline.count() << "s";
+  stream << "\n embedded_catalog: "
+         << (cache.embedded_catalog == EmbeddedCatalogUse::Always      ? "always"
+             : cache.embedded_catalog == EmbeddedCatalogUse::OnFailure ? "on failure"
+                                                                       : "never");
+  stream << "\n report: " << (report.has_value() ? (report == ReportFormat::Json ? "json" : "jsonl") : "");
+  stream << "\n output: " << output.value_or("");
   stream << "}\n";
   return stream.str();
 }
@@ -47,27 +77,98 @@ Options cli::read_args(int argc, char **argv)
     cxxopts::Options options("skad_updater", "Automatically update your SKAdNetwork Items");
     // clang-format off
     options.add_options()
-        (plist_file_path_Id, "The plist file path", cxxopts::value<string>())
+        (plist_file_path_Id, "The plist file path. Use `-` to read the plist from stdin", cxxopts::value<string>())
         (network_list_Id, "Request for a specific list of networks to update. "
                           "The argument is a comma separated list of network names", cxxopts::value<string>())
+        (network_list_file_Id, "Request for the networks listed in a file, one network name per line. "
+                               "Use `-` to read the list from stdin", cxxopts::value<string>())
         (pod_file_path_Id, "Update all the networks according to a pod file. "
-                      "The argument is the path to the pod file.",cxxopts::value<string>())
+                      "The argument is the path to the pod file, `-` for stdin.",cxxopts::value<string>())
+        (pod_target_Id, "Only use the networks of this target of the pod file, "
+                        "including those of its helpers and enclosing targets", cxxopts::value<string>())
         (dry_run_Id, "Perform a dry-run. Prints out the new `plist` file instead of overwriting.")
         (show_networks_Id, "Show the list of supported network names.")
+        (batch_file_Id, "Update every plist listed in a file, one `plist-file-path[<TAB>pod-file-path]` per line. "
+                        "Use `-` to read the list from stdin", cxxopts::value<string>())
+        (discover_dir_Id, "Update every Info.plist found under a directory, each with the nearest Podfile above it",
+                          cxxopts::value<string>())
+        (shard_Id, "Only process the `i`th of `N` deterministic parts of the plists, in the form `i/N`",
+                   cxxopts::value<string>())
+        (shard_report_Id, "Write a JSON report of the processed plists, to combine with `merge-reports`",
+                          cxxopts::value<string>())
+        (cache_dir_Id, "Share the catalog responses with concurrent runs through this directory. "
+                       "Defaults to `FYBER_SKAD_CACHE_DIR` when set", cxxopts::value<string>())
+        (cache_ttl_Id, "How long cached responses are reused, in seconds (default 300)", cxxopts::value<long>())
+        (offline_Id, "Use the catalog compiled into the binary instead of the service")
+        (fallback_catalog_Id, "Use the catalog compiled into the binary when the service is unavailable or unreachable")
+        (rate_limit_Id, "Limit the requests to the service, as `[host=]<requests-per-second>[/<burst>]`, "
+                        "shared with concurrent runs using the same `cache_dir`", cxxopts::value<vector<string>>())
+        (max_in_flight_Id, "Limit the requests in flight to the service, as `[host=]<requests>`",
+                           cxxopts::value<vector<string>>())
+        (no_compression_Id, "Ask the service for uncompressed responses (gzip or zstd by default)")
+        (post_queries_Id, "Query the IDs of the networks with a POST of their names rather than in the URL, "
+                          "e.g. for long lists")
+        (catalog_sync_Id, "Keep a copy of the whole catalog, in `cache_dir` when given, and sync it with the changes "
+                          "since its version rather than querying the IDs of each list")
+        (max_plist_size_Id, "Fail plists larger than this, as `<n>[K|M|G]` bytes, 0 for no limit (default 64M)",
+                            cxxopts::value<string>())
+        (max_podfile_size_Id, "Fail Podfiles larger than this, as `<n>[K|M|G]` bytes, 0 for no limit (default 16M)",
+                              cxxopts::value<string>())
+        (max_response_size_Id, "Fail service responses larger than this, as `<n>[K|M|G]` bytes, 0 for no limit "
+                               "(default 64M)", cxxopts::value<string>())
+        (max_xml_depth_Id, "Fail plists nesting elements deeper than this, 0 for no limit (default 256)",
+                           cxxopts::value<size_t>())
+        (max_ids_per_network_Id, "Fail when the service returns more IDs for a network, 0 for no limit "
+                                 "(default 10000)", cxxopts::value<size_t>())
+        (phase_deadline_Id, "Fail reading a plist or a Podfile, or waiting for the service, after this many seconds, "
+                            "0 for no limit (default 300)", cxxopts::value<long>())
+        (metrics_file_Id, "Add the metrics of the run to an OpenMetrics textfile, created when missing",
+                          cxxopts::value<string>())
+        (trace_file_Id, "Write the stages of the run, by thread, to this file in the trace event format "
+                        "(`chrome://tracing`, Perfetto)", cxxopts::value<string>())
+        (output_Id, "Write the plist to this path instead of updating it in place, updated or not. "
+                    "Use `-` to write it to stdout", cxxopts::value<string>())
+        (report_Id, "Print a report of the run to stdout instead of the logs, which go to stderr. "
+                    "`json` for a single document, `jsonl` for a line per plist", cxxopts::value<string>())
         ("h," + string(help_Id),"Print usage");
     // clang-format on
 
     auto result = options.parse(argc, argv);
 
+    const bool batch = result.count(batch_file_Id) > 0 or result.count(discover_dir_Id) > 0;
+
     if (!result.count(help_Id) && !result.count(show_networks_Id)) {
 
-      if (result.count(plist_file_path_Id) == 0) {
+      if (result.count(plist_file_path_Id) == 0 and !batch) {
         throw ExitMessage::InvalidArguments("Missing required parameter `plist_file_path`.\n" + options.help());
       }
 
-      if (result.count(network_list_Id) == 0 and result.count(pod_file_path_Id) == 0) {
+      // In batch mode the podfile may come with each plist
+      if (result.count(network_list_Id) == 0 and result.count(network_list_file_Id) == 0 and
+          result.count(pod_file_path_Id) == 0 and !batch) {
         throw ExitMessage::InvalidArguments(
-            "At least one of the parameters `network_list` or `pod_file_path` is required.\n\n" + options.help());
+            "At least one of the parameters `network_list`, `network_list_file` or `pod_file_path` is required.\n\n" +
+            options.help());
+      }
+    }
+
+    auto from_stdin = [&result](const char *id) { return result.count(id) == 1 and result[id].as<string>() == "-"; };
+    if (from_stdin(plist_file_path_Id) + from_stdin(pod_file_path_Id) + from_stdin(network_list_file_Id) +
+            from_stdin(batch_file_Id) >
+        1) {
+      throw ExitMessage::InvalidArguments("Only one of the inputs can be read from stdin");
+    }
+
+    if (result.count(pod_target_Id) == 1 and result.count(pod_file_path_Id) == 0 and !batch) {
+      throw ExitMessage::InvalidArguments("`pod_target` requires a pod file");
+    }
+
+    if (result.count(output_Id) == 1) {
+      if (batch) {
+        throw ExitMessage::InvalidArguments("`output` only applies to a single plist");
+      }
+      if (result[output_Id].as<string>() == "-" and result.count(report_Id) > 0) {
+        throw ExitMessage::InvalidArguments("`report` and `output -` can't both be written to stdout");
       }
     }
 
@@ -82,13 +183,24 @@ Options cli::read_args(int argc, char **argv)
 
 Options cli::buildOptions(const cxxopts::ParseResult &result, const cxxopts::Options &options)
 {
-  optional<vector<string>> maybe_networks = std::nullopt;
+  optional<vector<Symbol>> maybe_networks = std::nullopt;
   optional<string> maybe_pod_file_path = std::nullopt;
   optional<string> maybe_plist_file_path = std::nullopt;
   optional<string> maybe_show_help = std::nullopt;
 
-  if (result.count(network_list_Id) == 1) {
-    maybe_networks = fyber::common::split(result[network_list_Id].as<string>(), ',');
+  if (result.count(network_list_Id) == 1 or result.count(network_list_file_Id) == 1) {
+    vector<Symbol> networks;
+
+    if (result.count(network_list_Id) == 1) {
+      append_networks(result[network_list_Id].as<string>(), ',', networks);
+    }
+
+    if (result.count(network_list_file_Id) == 1) {
+      append_networks(common::read_text_input(result[network_list_file_Id].as<string>(), network_list_file_Id), '\n',
+                      networks);
+    }
+
+    maybe_networks = std::move(networks);
   }
 
   if (result.count(pod_file_path_Id) == 1) {
@@ -103,8 +215,187 @@ Options cli::buildOptions(const cxxopts::ParseResult &result, const cxxopts::Opt
     maybe_show_help = options.help();
   }
 
+  auto maybe_string = [&result](const char *id) -> optional<string> {
+    if (result.count(id) == 1) return result[id].as<string>();
+    return std::nullopt;
+  };
+
+  optional<Shard> maybe_shard = std::nullopt;
+  if (result.count(shard_Id) == 1) {
+    maybe_shard = Shard::parse(result[shard_Id].as<string>());
+  }
+
+  BatchOptions batch{maybe_string(batch_file_Id), maybe_string(discover_dir_Id), maybe_shard,
+                     maybe_string(shard_report_Id)};
+
+  optional<long> maybe_cache_ttl = std::nullopt;
+  if (result.count(cache_ttl_Id) == 1) {
+    maybe_cache_ttl = result[cache_ttl_Id].as<long>();
+    if (maybe_cache_ttl.value() <= 0) throw ExitMessage::InvalidArguments("`cache_ttl` must be positive");
+  }
+
+  auto embedded_catalog = EmbeddedCatalogUse::Never;
+  if (result[offline_Id].as<bool>()) {
+    embedded_catalog = EmbeddedCatalogUse::Always;
+  } else if (result[fallback_catalog_Id].as<bool>()) {
+    embedded_catalog = EmbeddedCatalogUse::OnFailure;
+  }
+
+  CacheOptions cache{maybe_string(cache_dir_Id),
+                     maybe_cache_ttl,
+                     embedded_catalog,
+                     rate_limits(result),
+                     !result[no_compression_Id].as<bool>(),
+                     result[post_queries_Id].as<bool>(),
+                     result[catalog_sync_Id].as<bool>()};
+
+  optional<ReportFormat> maybe_report = std::nullopt;
+  if (result.count(report_Id) == 1) {
+    auto format = result[report_Id].as<string>();
+    if (format == "json") {
+      maybe_report = ReportFormat::Json;
+    } else if (format == "jsonl") {
+      maybe_report = ReportFormat::JsonLines;
+    } else {
+      throw ExitMessage::InvalidArguments("`report` must be `json` or `jsonl`, not `" + format + "`");
+    }
+  }
+
   return Options(maybe_show_help, maybe_plist_file_path, maybe_pod_file_path, maybe_networks,
-                 result[dry_run_Id].as<bool>(), result[show_networks_Id].as<bool>());
+                 result[dry_run_Id].as<bool>(), result[show_networks_Id].as<bool>(), std::move(batch), std::move(cache),
+                 maybe_report, maybe_string(output_Id), maybe_string(pod_target_Id), limits(result));
+}
+
+Limits cli::limits(const cxxopts::ParseResult &result)
+{
+  Limits limits;
+
+  auto size = [&result](const char *id, size_t &limit) {
+    if (result.count(id) == 1) limit = Limits::parse_size(id, result[id].as<string>());
+  };
+  size(max_plist_size_Id, limits.max_plist_bytes);
+  size(max_podfile_size_Id, limits.max_podfile_bytes);
+  size(max_response_size_Id, limits.max_response_bytes);
+
+  if (result.count(max_xml_depth_Id) == 1) limits.max_xml_depth = result[max_xml_depth_Id].as<size_t>();
+  if (result.count(max_ids_per_network_Id) == 1) {
+    limits.max_ids_per_network = result[max_ids_per_network_Id].as<size_t>();
+  }
+
+  if (result.count(phase_deadline_Id) == 1) {
+    auto seconds = result[phase_deadline_Id].as<long>();
+    if (seconds < 0) throw ExitMessage::InvalidArguments("`phase_deadline` can't be negative");
+    limits.phase_deadline = std::chrono::seconds(seconds);
+  }
+
+  return limits;
+}
+
+std::map<string, RateLimit> cli::rate_limits(const cxxopts::ParseResult &result)
+{
+  std::map<string, RateLimit> limits;
+
+  // `[host=]<value>`, the empty host standing for every host
+  auto for_each_host = [&result](const char *id, const std::function<void(const string &, const string &)> &apply) {
+    if (result.count(id) == 0) return;
+    for (const auto &spec : result[id].as<vector<string>>()) {
+      auto eq = spec.find('=');
+      apply(eq == string::npos ? "" : spec.substr(0, eq), eq == string::npos ? spec : spec.substr(eq + 1));
+    }
+  };
+
+  for_each_host(rate_limit_Id, [&limits](const string &host, const string &value) {
+    auto limit = RateLimit::parse(value);
+    limits[host].rate = limit.rate;
+    limits[host].burst = limit.burst;
+  });
+
+  for_each_host(max_in_flight_Id, [&limits](const string &host, const string &value) {
+    if (!common::is_integer(value) or std::stoul(value) == 0) {
+      throw ExitMessage::InvalidArguments("`max_in_flight` must be a positive number of requests, not `" + value + "`");
+    }
+    limits[host].max_in_flight = std::stoul(value);
+  });
+
+  return limits;
+}
+
+optional<string> cli::peek(int argc, char **argv, const char *id)
+{
+  const string flag = string("--") + id;
+
+  for (int i = 1; i < argc; ++i) {
+    if (flag == argv[i] and i + 1 < argc) return string(argv[i + 1]);
+    if (common::starts_with(argv[i], flag + "=")) return string(argv[i] + flag.size() + 1);
+  }
+  return std::nullopt;
+}
+
+optional<string> cli::metrics_file(int argc, char **argv)
+{
+  return peek(argc, argv, metrics_file_Id);
+}
+
+optional<string> cli::trace_file(int argc, char **argv)
+{
+  return peek(argc, argv, trace_file_Id);
+}
+
+bool cli::logs_to_stderr(int argc, char **argv)
+{
+  return peek(argc, argv, report_Id).has_value() or peek(argc, argv, output_Id) == "-";
+}
+
+bool cli::is_merge_reports(int argc, char **argv)
+{
+  return argc > 1 and std::strcmp(argv[1], merge_reports_command) == 0;
+}
+
+MergeReportsOptions cli::read_merge_reports_args(int argc, char **argv)
+{
+  try {
+    cxxopts::Options options(string("skad_updater ") + merge_reports_command,
+                             "Combine the JSON reports of the shards of a run into a single report");
+    // clang-format off
+    options.add_options()
+        (output_Id, "The path of the combined report", cxxopts::value<string>())
+        (reports_Id, "The reports to combine", cxxopts::value<vector<string>>())
+        ("h," + string(help_Id), "Print usage");
+    // clang-format on
+    options.parse_positional({reports_Id});
+    options.positional_help("<report>...");
+
+    // Skip the subcommand
+    int sub_argc = argc - 1;
+    char **sub_argv = argv + 1;
+    auto result = options.parse(sub_argc, sub_argv);
+
+    if (result.count(help_Id)) {
+      return MergeReportsOptions{options.help(), "", {}};
+    }
+
+    if (result.count(output_Id) == 0) {
+      throw ExitMessage::InvalidArguments("Missing required parameter `output`.\n" + options.help());
+    }
+
+    if (result.count(reports_Id) == 0) {
+      throw ExitMessage::InvalidArguments("At least one report is required.\n" + options.help());
+    }
+
+    return MergeReportsOptions{std::nullopt, result[output_Id].as<string>(), result[reports_Id].as<vector<string>>()};
+
+  } catch (ExitMessage &exitMessage) {
+    throw exitMessage;
+  } catch (const std::exception &e) {
+    throw ExitMessage::InvalidArguments(e.what());
+  }
+}
+
+void cli::append_networks(std::string_view text, char delimiter, vector<Symbol> &networks)
+{
+  for (auto network : common::split_view(text, delimiter)) {
+    networks.emplace_back(network);
+  }
 }
 
 }  // namespace fyber
\ No newline at end of file
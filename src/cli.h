@@ -1,12 +1,18 @@
 #pragma once
 
 #include <cxxopts.hpp>
+#include <map>
 #include <optional>
 #include <ostream>
 #include <string>
 #include <variant>
 #include <vector>
 
+#include "Batch.h"
+#include "Limits.h"
+#include "ManagerApi.h"
+#include "RateLimiter.h"
+#include "Symbol.h"
 #include "exit_message.h"
 
 namespace fyber {
@@ -15,37 +21,150 @@ using std::optional;
 using std::string;
 using std::vector;
 
+/// Options of runs over many plists
+struct BatchOptions
+{
+  const optional<string> batch_file;
+  const optional<string> discover_dir;
+  const optional<Shard> shard;
+  const optional<string> shard_report;
+
+  /// Whether the run is over a list of plists rather than a single one
+  [[nodiscard]] bool enabled() const { return batch_file.has_value() or discover_dir.has_value(); }
+};
+
+/// Options of the requests to the catalog: the responses cache shared between processes, the catalog compiled into
+/// the binary, the rate limits and the wire format
+struct CacheOptions
+{
+  const optional<string> cache_dir;
+  const optional<long> cache_ttl_seconds;
+  const EmbeddedCatalogUse embedded_catalog = EmbeddedCatalogUse::Never;
+  /// By host, the empty host for every other host
+  const std::map<string, RateLimit> rate_limits = {};
+  /// Whether responses are asked compressed
+  const bool compression = true;
+  /// Whether `/plist` is queried with a POST rather than in the URL
+  const bool post_queries = false;
+  /// Whether the networks are served from a copy of the whole catalog, synced by changes
+  const bool catalog_sync = false;
+};
+
+/// Formats of the report of a run, written to stdout
+enum class ReportFormat
+{
+  /// A single document with every plist, once the run is over
+  Json,
+  /// A line per plist, as soon as it's processed
+  JsonLines
+};
+
 struct Options
 {
   const optional<string> show_help;
   const optional<string> plist_file_path;
   const optional<string> pod_file_path;
-  const optional<vector<string>> network_list;
+  const optional<vector<Symbol>> network_list;
   const bool dry_run = false;
   const bool show_networks = false;
+  const BatchOptions batch;
+  const CacheOptions cache;
+  const optional<ReportFormat> report;
+  /// Where the plist is written instead of in place, `-` for stdout
+  const optional<string> output;
+  /// The target of the podfile whose networks are used, rather than those of the whole podfile
+  const optional<string> pod_target;
+  const Limits limits;
 
   Options(optional<string> showHelp, optional<string> plistPath, optional<string> podPath,
-          optional<vector<string>> networkList, bool dryRun, bool showNetworks);
+          optional<vector<Symbol>> networkList, bool dryRun, bool showNetworks, BatchOptions batchOptions,
+          CacheOptions cacheOptions, optional<ReportFormat> reportFormat = std::nullopt,
+          optional<string> outputPath = std::nullopt, optional<string> podTarget = std::nullopt,
+          Limits limitsOptions = Limits());
 
   [[nodiscard]] string to_string() const;
 };
 
+/// Options of the `merge-reports` subcommand
+struct MergeReportsOptions
+{
+  const optional<string> show_help;
+  const string output;
+  const vector<string> reports;
+};
+
 /// Facilitate CLI options
 class cli
 {
  private:
   static inline const char* plist_file_path_Id = "plist_file_path";
   static inline const char* network_list_Id = "network_list";
+  static inline const char* network_list_file_Id = "network_list_file";
   static inline const char* pod_file_path_Id = "pod_file_path";
+  static inline const char* pod_target_Id = "pod_target";
   static inline const char* dry_run_Id = "dry_run";
   static inline const char* show_networks_Id = "show_networks";
   static inline const char* help_Id = "help";
+  static inline const char* batch_file_Id = "batch_file";
+  static inline const char* discover_dir_Id = "discover_dir";
+  static inline const char* shard_Id = "shard";
+  static inline const char* shard_report_Id = "shard_report";
+  static inline const char* cache_dir_Id = "cache_dir";
+  static inline const char* cache_ttl_Id = "cache_ttl";
+  static inline const char* offline_Id = "offline";
+  static inline const char* fallback_catalog_Id = "fallback_catalog";
+  static inline const char* rate_limit_Id = "rate_limit";
+  static inline const char* max_in_flight_Id = "max_in_flight";
+  static inline const char* no_compression_Id = "no_compression";
+  static inline const char* post_queries_Id = "post_queries";
+  static inline const char* catalog_sync_Id = "catalog_sync";
+  static inline const char* max_plist_size_Id = "max_plist_size";
+  static inline const char* max_podfile_size_Id = "max_podfile_size";
+  static inline const char* max_response_size_Id = "max_response_size";
+  static inline const char* max_xml_depth_Id = "max_xml_depth";
+  static inline const char* max_ids_per_network_Id = "max_ids_per_network";
+  static inline const char* phase_deadline_Id = "phase_deadline";
+  static inline const char* metrics_file_Id = "metrics_file";
+  static inline const char* trace_file_Id = "trace_file";
+  static inline const char* report_Id = "report";
+  static inline const char* output_Id = "output";
+  static inline const char* reports_Id = "reports";
 
   static Options buildOptions(const cxxopts::ParseResult& result, const cxxopts::Options& options);
 
+  /// The value of the option [id] in the raw arguments, if any
+  static optional<string> peek(int argc, char** argv, const char* id);
+
+  /// The defaults of `Limits`, overridden by the `max_*` and `phase_deadline` arguments
+  static Limits limits(const cxxopts::ParseResult& result);
+
+  /// The limits of the `rate_limit` and `max_in_flight` arguments, by host
+  static std::map<string, RateLimit> rate_limits(const cxxopts::ParseResult& result);
+
+  /// Intern the names in [text], separated by [delimiter], into [networks]
+  static void append_networks(std::string_view text, char delimiter, vector<Symbol>& networks);
+
  public:
+  static inline const char* merge_reports_command = "merge-reports";
+
   /// Reads valid arguments into an `Options` object
   static Options read_args(int argc, char** argv);
+
+  /// The `metrics_file` argument, found without validating the others so that failed runs are counted as well
+  static optional<string> metrics_file(int argc, char** argv);
+
+  /// The `trace_file` argument, found before the other arguments are read so that the whole run is traced
+  static optional<string> trace_file(int argc, char** argv);
+
+  /// Whether stdout is taken by a report or by the plist, found before the other arguments are read so that logs can
+  /// be written to stderr instead
+  static bool logs_to_stderr(int argc, char** argv);
+
+  /// Whether the arguments invoke the `merge-reports` subcommand
+  static bool is_merge_reports(int argc, char** argv);
+
+  /// Reads valid arguments of the `merge-reports` subcommand
+  static MergeReportsOptions read_merge_reports_args(int argc, char** argv);
 };
 
 }  // namespace fyber
@@ -1,11 +1,19 @@
 #pragma once
+#include <cstdint>
 #include <filesystem>
+#include <fstream>
 #include <functional>
+#include <iostream>
+#include <iterator>
 #include <map>
 #include <set>
 #include <string>
+#include <string_view>
+#include <system_error>
 #include <vector>
 
+#include "exit_message.h"
+
 namespace fyber {
 
 struct common
@@ -20,10 +28,10 @@ struct common
   {
     std::string s;
 
-    int i = 0;
+    size_t i = 0;
     for (const auto& piece : col) {
-      i++;
-      s += piece + (i < col.size() ? delimiter : "");
+      if (i++ > 0) s += delimiter;
+      s += std::string_view(piece);
     }
 
     return s;
@@ -33,9 +41,9 @@ struct common
   /// \param text
   /// \param delimiter
   /// \return vector of the original strings parts
-  static std::vector<string> split(const std::string& text, char delimiter)
+  static std::vector<std::string> split(const std::string& text, char delimiter)
   {
-    std::vector<string> v;
+    std::vector<std::string> v;
     std::string token;
     for (char c : text) {
       if (c == delimiter) {
@@ -51,13 +59,43 @@ struct common
     return v;
   }
 
-  /// Flatten a map to get all its values in a single vector.
+  /// Split [text] into views of its parts using a delimiter, without copying. <br/>
+  /// Each part is trimmed of surrounding whitespace and empty parts are skipped.
+  /// \param text
+  /// \param delimiter
+  /// \return views into [text]
+  static std::vector<std::string_view> split_view(std::string_view text, char delimiter)
+  {
+    std::vector<std::string_view> parts;
+
+    while (!text.empty()) {
+      size_t end = text.find(delimiter);
+      auto part = trim_view(text.substr(0, end));
+      if (!part.empty()) parts.push_back(part);
+      if (end == std::string_view::npos) break;
+      text.remove_prefix(end + 1);
+    }
+
+    return parts;
+  }
+
+  /// trim whitespace from both ends of a view
+  static std::string_view trim_view(std::string_view text)
+  {
+    const char* whitespace = " \t\r\n\v\f";
+    size_t begin = text.find_first_not_of(whitespace);
+    if (begin == std::string_view::npos) return {};
+    return text.substr(begin, text.find_last_not_of(whitespace) - begin + 1);
+  }
+
+  /// Flatten a map to get all its values in a single set.
   /// \return
-  static std::set<std::string> get_value_set(const std::map<string, std::vector<std::string>>& keys_values)
+  template <typename K, typename V>
+  static std::set<V> get_value_set(const std::map<K, std::vector<V>>& keys_values)
   {
-    std::set<std::string> map_values;
+    std::set<V> map_values;
 
-    for (auto [k, vs] : keys_values) {
+    for (const auto& [k, vs] : keys_values) {
       for (auto& v : vs) {
         map_values.emplace(v);
       }
@@ -85,13 +123,54 @@ struct common
     return description;
   }
 
+  /// 64-bit FNV-1a hash of [text], the same on every machine and run
+  static uint64_t fnv1a(std::string_view text)
+  {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : text) {
+      hash ^= c;
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  /// Whether [path] can only be read once, from the start: `-` for stdin, pipes and devices (e.g. `/dev/fd/3`)
+  static bool is_stream(const std::string& path)
+  {
+    if (path == "-") return true;
+
+    std::error_code error;
+    auto status = std::filesystem::status(path, error);
+    return !error and (std::filesystem::is_fifo(status) or std::filesystem::is_character_file(status) or
+                       std::filesystem::is_socket(status));
+  }
+
+  /// Read the whole content of the file in [path], of stdin when [path] is `-`, or of a pipe or device
+  /// \param path
+  /// \param parameter the name of the parameter [path] was given by, for errors
+  /// \throws NotAFile if [path] is neither a regular file nor a stream
+  static std::string read_text_input(const std::string& path, const std::string& parameter)
+  {
+    if (path == "-") {
+      return std::string(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+    }
+
+    if (!std::filesystem::is_regular_file(path) and !is_stream(path)) {
+      throw ExitMessage::NotAFile("Provided " + parameter +
+                                  " is invalid : " + file_status_to_string(std::filesystem::status(path)));
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+
   /// Determine if a string [str] starts with another string [term]
-  static bool starts_with(const string& str, const string& term) { return str.rfind(term, 0) == 0; }
+  static bool starts_with(const std::string& str, const std::string& term) { return str.rfind(term, 0) == 0; }
 
   /// Determine if a string [str] is a positive integer
   static bool is_integer(const std::string& str)
   {
-    return !str.empty() and str.find_first_not_of("0123456789") == string::npos;
+    return !str.empty() and str.find_first_not_of("0123456789") == std::string::npos;
   }
 
   /// trim spaces from start
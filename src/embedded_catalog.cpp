@@ -0,0 +1,63 @@
+#include "embedded_catalog.h"
+
+#include "embedded_catalog_data.h"
+
+namespace fyber {
+
+namespace {
+
+using namespace catalog::embedded;
+
+constexpr const catalog::Entry* lookup(std::string_view network)
+{
+  return catalog::find(network, entries, slots, slot_count, seed);
+}
+
+constexpr bool every_network_found()
+{
+  for (size_t i = 0; i < entry_count; ++i) {
+    if (lookup(entries[i].network) != &entries[i]) return false;
+  }
+  return true;
+}
+
+static_assert(every_network_found(), "The embedded catalog doesn't match catalog_hash.h, regenerate it");
+
+}  // namespace
+
+const catalog::Entry* embedded_catalog::find(std::string_view network)
+{
+  return lookup(network);
+}
+
+size_t embedded_catalog::size()
+{
+  return entry_count;
+}
+
+std::vector<Symbol> embedded_catalog::networks()
+{
+  std::vector<Symbol> networks;
+  networks.reserve(entry_count);
+  for (size_t i = 0; i < entry_count; ++i) networks.push_back(SymbolTable::global().intern_static(entries[i].network));
+  return networks;
+}
+
+std::map<Symbol, std::vector<Symbol>> embedded_catalog::sk_ad_networks(const std::vector<Symbol>& networks)
+{
+  std::map<Symbol, std::vector<Symbol>> sk_ad_networks;
+
+  for (const auto& network : networks) {
+    auto& ids = sk_ad_networks[network];
+
+    const auto* entry = lookup(network.view());
+    if (entry == nullptr) continue;
+
+    ids.reserve(entry->size);
+    for (size_t i = 0; i < entry->size; ++i) ids.push_back(SymbolTable::global().intern_static(entry->ids[i]));
+  }
+
+  return sk_ad_networks;
+}
+
+}  // namespace fyber
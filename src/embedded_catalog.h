@@ -0,0 +1,29 @@
+#pragma once
+#include <map>
+#include <string_view>
+#include <vector>
+
+#include "Symbol.h"
+#include "catalog_hash.h"
+
+namespace fyber {
+
+/// The catalog of the service pinned at build time (`catalog/snapshot.json`), compiled into the binary as a
+/// perfect-hash table. Serves the runs that are offline or can't reach the service.
+struct embedded_catalog
+{
+  /// The entry of [network], or `nullptr`. Needs no allocation.
+  static const catalog::Entry* find(std::string_view network);
+
+  /// Number of networks in the catalog
+  static size_t size();
+
+  /// The network names, in the order of the snapshot
+  static std::vector<Symbol> networks();
+
+  /// The SKAdNetwork IDs of [networks], as the `/plist` endpoint would return them: a network missing from the
+  /// catalog has no IDs.
+  static std::map<Symbol, std::vector<Symbol>> sk_ad_networks(const std::vector<Symbol>& networks);
+};
+
+}  // namespace fyber
@@ -23,8 +23,57 @@ struct ExitMessage : std::runtime_error
   static ExitMessage ServerUnavailable(const std::string &message) { return ExitMessage(7, message); };
   static ExitMessage RemoteAPIFailure(const std::string &message) { return ExitMessage(8, message); };
   static ExitMessage NotAFile(const std::string &message) { return ExitMessage(9, message); };
+  static ExitMessage PlistTooLarge(const std::string &message) { return ExitMessage(10, message); };
+  static ExitMessage PodFileTooLarge(const std::string &message) { return ExitMessage(11, message); };
+  static ExitMessage ResponseTooLarge(const std::string &message) { return ExitMessage(12, message); };
+  static ExitMessage XmlTooDeep(const std::string &message) { return ExitMessage(14, message); };
+  static ExitMessage TooManyIds(const std::string &message) { return ExitMessage(15, message); };
+  static ExitMessage DeadlineExceeded(const std::string &message) { return ExitMessage(16, message); };
 
   static ExitMessage Oops(const std::string &message) { return ExitMessage(13, message); };
+
+  /// The name of the exit [code], as the factory that creates it
+  static const char *name(int code)
+  {
+    switch (code) {
+      case 0:
+        return "Success";
+      case 1:
+        return "InvalidArguments";
+      case 2:
+        return "InvalidPlist";
+      case 3:
+        return "InvalidPodFile";
+      case 4:
+        return "EmptyPodFile";
+      case 5:
+        return "EmptyNetworkList";
+      case 6:
+        return "InvalidNetworks";
+      case 7:
+        return "ServerUnavailable";
+      case 8:
+        return "RemoteAPIFailure";
+      case 9:
+        return "NotAFile";
+      case 10:
+        return "PlistTooLarge";
+      case 11:
+        return "PodFileTooLarge";
+      case 12:
+        return "ResponseTooLarge";
+      case 13:
+        return "Oops";
+      case 14:
+        return "XmlTooDeep";
+      case 15:
+        return "TooManyIds";
+      case 16:
+        return "DeadlineExceeded";
+      default:
+        return "Unknown";
+    }
+  }
 };
 
 }  // namespace fyber
\ No newline at end of file
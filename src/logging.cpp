@@ -0,0 +1,71 @@
+#include "logging.h"
+
+#include <iostream>
+#include <memory>
+
+#include "spdlog/async.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+#include "spdlog/sinks/stdout_sinks.h"
+
+namespace fyber {
+
+namespace {
+
+/// Writes the output of the program once the async logger is in use
+std::shared_ptr<spdlog::logger> output_logger;
+
+}  // namespace
+
+void logging::use_logger(bool to_stderr)
+{
+  std::shared_ptr<spdlog::sinks::sink> sink;
+  if (to_stderr) {
+    sink = std::make_shared<spdlog::sinks::stderr_color_sink_mt>();
+  } else {
+    sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+  }
+
+  auto logger = std::make_shared<spdlog::logger>("skad", sink);
+  logger->set_level(spdlog::default_logger_raw()->level());
+  spdlog::set_default_logger(logger);
+}
+
+void logging::use_async_logger()
+{
+  if (output_logger != nullptr) return;
+
+  spdlog::init_thread_pool(queue_size, 1);
+
+  // The sinks keep the pattern and the target of the synchronous logger
+  auto sinks = spdlog::default_logger_raw()->sinks();
+  spdlog::default_logger_raw()->flush();
+
+  // Blocking rather than dropping messages when the queue is full, logs are part of the output
+  auto logger = std::make_shared<spdlog::async_logger>("skad", sinks.begin(), sinks.end(), spdlog::thread_pool(),
+                                                       spdlog::async_overflow_policy::block);
+  logger->set_level(spdlog::default_logger_raw()->level());
+  spdlog::set_default_logger(logger);
+
+  // Not registered, so its level isn't changed along with the logs'
+  output_logger = std::make_shared<spdlog::async_logger>("output", std::make_shared<spdlog::sinks::stdout_sink_mt>(),
+                                                         spdlog::thread_pool(), spdlog::async_overflow_policy::block);
+  output_logger->set_pattern("%v");
+  output_logger->set_level(spdlog::level::trace);
+}
+
+void logging::output(const std::string& text)
+{
+  if (output_logger == nullptr) {
+    std::cout << text << std::endl;
+    return;
+  }
+  output_logger->info("{}", text);
+}
+
+void logging::shutdown()
+{
+  output_logger.reset();
+  spdlog::shutdown();
+}
+
+}  // namespace fyber
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+#include "spdlog/spdlog.h"
+
+/// Log at debug level, only evaluating the arguments when debug logs are enabled. <br/>
+/// Compiled out when built with `SKAD_STRIP_DEBUG_LOG`, the arguments are still type checked.
+#ifdef SKAD_STRIP_DEBUG_LOG
+#define SKAD_DEBUG_ENABLED() false
+#else
+#define SKAD_DEBUG_ENABLED() spdlog::default_logger_raw()->should_log(spdlog::level::debug)
+#endif
+
+#define SKAD_DEBUG(...)                                 \
+  do {                                                  \
+    if (SKAD_DEBUG_ENABLED()) {                         \
+      spdlog::default_logger_raw()->debug(__VA_ARGS__); \
+    }                                                   \
+  } while (false)
+
+namespace fyber {
+
+struct logging
+{
+  /// Whether debug logs are compiled in
+  static constexpr bool debug_compiled =
+#ifdef SKAD_STRIP_DEBUG_LOG
+      false;
+#else
+      true;
+#endif
+
+  /// Whether debug logs are written, to skip building what only they would show
+  static bool debug_enabled()
+  {
+    return SKAD_DEBUG_ENABLED();
+  }
+
+  /// Messages queued to the logging thread before logging blocks
+  static constexpr size_t queue_size = 8192;
+
+  /// Replace the default logger with a synchronous one, without a thread, as most runs log a few lines only
+  /// \param to_stderr log to stderr rather than stdout
+  static void use_logger(bool to_stderr);
+
+  /// Replace the default logger with an asynchronous one writing to the same sinks, from a single background thread,
+  /// for runs logging a lot (e.g. batches). <br/>
+  /// The output of the program (see `output`) then goes through the same thread, so it stays in order with the logs.
+  static void use_async_logger();
+
+  /// Write [text] and a new line to stdout, in order with the logs
+  static void output(const std::string& text);
+
+  /// Write what's queued and stop the logging thread. Nothing should be logged afterwards.
+  static void shutdown();
+};
+
+}  // namespace fyber
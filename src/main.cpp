@@ -1,80 +1,126 @@
-#include <algorithm>
-#include <iostream>
+#include <chrono>
+#include <cstdio>
 
+#include "AllocStats.h"
+#include "Arena.h"
+#include "Batch.h"
 #include "ManagerApi.h"
+#include "Metrics.h"
 #include "Plist.h"
-#include "PodFile.h"
+#include "RateLimiter.h"
+#include "Report.h"
+#include "Trace.h"
+#include "Updater.h"
 #include "cli.h"
 #include "common.h"
 #include "exit_message.h"
+#include "logging.h"
 #include "spdlog/spdlog.h"
 
 void set_log_level();
-std::vector<std::string> networks_list_by_podfile(const fyber::ManagerApi& manager_api, const fyber::Options& options);
-std::vector<std::string> networks_list_by_options(const fyber::Options& options);
-void merge_network_lists(std::vector<std::string>& base_networks, std::vector<std::string>& networks_to_merge);
-void update_network_IDs(const fyber::Options& options, fyber::Plist& plist);
+int run(int argc, char** argv);
+void record_run(int argc, char** argv, int exit_code, std::chrono::duration<double> duration);
+void write_trace(const std::string& path);
+std::string status_counts(const fyber::ReportSummary& summary);
+int run_batch(const fyber::Updater& updater, const fyber::Options& options, fyber::memory::Arena& arena);
+int merge_reports(const fyber::MergeReportsOptions& options);
 
 int main(int argc, char** argv)
 {
+  fyber::Stopwatch stopwatch;
+
+  auto trace_file = fyber::cli::trace_file(argc, argv);
+  if (trace_file.has_value()) fyber::Trace::global().enable();
+
+  int exit_code = run(argc, argv);
+
+  record_run(argc, argv, exit_code, stopwatch.elapsed());
+  if (trace_file.has_value()) write_trace(trace_file.value());
+
+  fyber::logging::shutdown();
+
+  // On stderr, stdout may be the plist or a report
+  if constexpr (fyber::memory::alloc_stats::compiled) {
+    std::fputs(fyber::memory::alloc_stats::report().c_str(), stderr);
+  }
+  return exit_code;
+}
+
+int run(int argc, char** argv)
+{
+  // A report or the plist takes stdout over
+  fyber::logging::use_logger(fyber::cli::logs_to_stderr(argc, argv));
+
   set_log_level();
 
   spdlog::set_pattern("%^*** %v%$");
 
-  const char* server_host_override = std::getenv("FYBER_SKAD_NETWORKS_SERVER_HOST");
-  auto manager_api =
-      fyber::ManagerApi((server_host_override != nullptr) ? server_host_override : "https://network-setup.fyber.com");
+  // Every document of this run is allocated from a single arena, released at once on exit
+  fyber::memory::Arena arena;
+  fyber::memory::ArenaScope arena_scope(arena);
 
   spdlog::info("Welcome to SKAd Updater ( version {} )", skad_updater_VERSION);
 
   try {
 
-    auto options = fyber::cli::read_args(argc, argv);
+    if (fyber::cli::is_merge_reports(argc, argv)) {
+      return merge_reports(fyber::cli::read_merge_reports_args(argc, argv));
+    }
 
-    spdlog::debug("options = {}", options.to_string());
+    auto options = [argc, argv] {
+      fyber::memory::PhaseScope phase(fyber::memory::Phase::Cli);
+      return fyber::cli::read_args(argc, argv);
+    }();
 
-    if (options.show_help.has_value()) {
-      std::cout << options.show_help.value() << std::endl;
-      return 0;
-    }
+    SKAD_DEBUG("options = {}", options.to_string());
+    fyber::Limits::global() = options.limits;
 
-    if (options.show_networks) {
-      auto networks = manager_api.get_networks();
-      std::cout << "Supported network names: " << fyber::common::join(networks, ",") << std::endl;
+    if (options.show_help.has_value()) {
+      fyber::logging::output(options.show_help.value());
       return 0;
     }
 
-    auto plist = fyber::Plist(options.plist_file_path.value());
-
-    spdlog::info("Existing SKAdNetworks: {}", plist.existing_sk_ad_network_items_str());
+    // Only what's left of the run needs the service, curl itself is initialized by the first request
+    const char* server_host_override = std::getenv("FYBER_SKAD_NETWORKS_SERVER_HOST");
+    auto manager_api =
+        fyber::ManagerApi((server_host_override != nullptr) ? server_host_override : "https://network-setup.fyber.com");
+    auto updater = fyber::Updater(manager_api);
 
-    std::vector<std::string> network_list;
+    const char* cache_dir_override = std::getenv("FYBER_SKAD_CACHE_DIR");
+    auto cache_dir = cache_dir_override != nullptr ? std::optional<std::string>(cache_dir_override) : std::nullopt;
+    if (options.cache.cache_dir.has_value()) cache_dir = options.cache.cache_dir;
 
-    if (options.pod_file_path.has_value()) {
-      network_list = networks_list_by_podfile(manager_api, options);
+    if (cache_dir.has_value()) {
+      auto ttl = options.cache.cache_ttl_seconds.value_or(fyber::DiskCache::default_ttl.count());
+      manager_api.use_disk_cache(cache_dir.value(), std::chrono::seconds(ttl));
     }
 
-    if (options.network_list.has_value()) {
-      std::vector<std::string> explicit_network_list = networks_list_by_options(options);
-
-      merge_network_lists(network_list, explicit_network_list);
-    }
+    manager_api.use_embedded_catalog(options.cache.embedded_catalog);
+    manager_api.use_compression(options.cache.compression);
+    manager_api.use_post_queries(options.cache.post_queries);
+    manager_api.use_catalog_sync(options.cache.catalog_sync);
 
-    spdlog::info("Fetching SKAdNetworks for: {}", fyber::common::join(network_list, ", "));
+    for (const auto& [host, limit] : options.cache.rate_limits) fyber::RateLimiter::configure(host, limit);
+    if (cache_dir.has_value() and !options.cache.rate_limits.empty())
+      fyber::RateLimiter::share_through(cache_dir.value());
 
-    plist.set_sk_ad_network_items_for_update(manager_api.get_sk_ad_networks(network_list));
-
-    spdlog::info("New SKAdNetworks: {}", plist.new_sk_ad_network_items_str());
+    if (options.show_networks) {
+      auto networks = manager_api.get_networks();
+      fyber::logging::output("Supported network names: " + fyber::common::join(networks, ","));
+      return 0;
+    }
 
-    if (plist.should_update()) {
-      update_network_IDs(options, plist);
-    } else {
-      spdlog::info("Nothing to update. `{}` unchanged.", options.plist_file_path.value());
+    if (options.batch.enabled() or options.batch.shard.has_value() or options.batch.shard_report.has_value() or
+        options.report.has_value()) {
+      return run_batch(updater, options, arena);
     }
 
+    updater.update(options.plist_file_path.value(), options.pod_file_path, options.network_list, options.dry_run,
+                   options.output, options.pod_target);
+
   } catch (fyber::ExitMessage& err) {
     if (err.code == 0) {
-      std::cout << err.what() << std::endl;
+      fyber::logging::output(err.what());
     } else {
       spdlog::error(err.what());
     }
@@ -87,76 +133,172 @@ int main(int argc, char** argv)
   return 0;
 }
 
-/// Get the list of networks to fetch, as defined in the podfile
-/// \param manager_api - the API to the SKAdNetwork listing server
-/// \param options - cli options
-/// \return a list of network names
-/// \throws EmptyPodFile if the pod file doesn't contain supported network names.
-std::vector<std::string> networks_list_by_podfile(const fyber::ManagerApi& manager_api, const fyber::Options& options)
+/// Set the log level as DEBUG if the environment variable 'FYBER_SKAD_DEBUG_LOG' exists
+void set_log_level()
 {
-  auto supported_networks = manager_api.get_networks();
+  if (getenv("FYBER_SKAD_DEBUG_LOG")) {
+    spdlog::set_level(spdlog::level::debug);
+    if (!fyber::logging::debug_compiled) spdlog::warn("Debug logs are not available in this build");
+  } else {
+    spdlog::set_level(spdlog::level::info);
+  }
+}
 
-  auto podfile = fyber::PodFile(options.pod_file_path.value(), supported_networks);
+/// Count the run in the metrics, and add them to the `metrics_file` when one is given. <br/>
+/// Failing to do so is logged but doesn't change the outcome of the run.
+void record_run(int argc, char** argv, int exit_code, std::chrono::duration<double> duration)
+{
+  auto& metrics = fyber::Metrics::global();
+  metrics.observe(fyber::Metrics::run_seconds, {}, duration);
+  metrics.increment(fyber::Metrics::exits, {{"reason", fyber::ExitMessage::name(exit_code)}});
+
+  if constexpr (fyber::memory::alloc_stats::compiled) {
+    for (auto phase : fyber::memory::alloc_stats::phases()) {
+      auto counts = fyber::memory::alloc_stats::of(phase);
+      const fyber::Metrics::Labels labels = {{"phase", fyber::memory::alloc_stats::phase_name(phase)}};
+      metrics.increment(fyber::Metrics::allocations, labels, static_cast<double>(counts.allocations));
+      metrics.increment(fyber::Metrics::allocated_bytes, labels, static_cast<double>(counts.bytes));
+    }
+  }
 
-  auto networks = podfile.get_used_networks();
+  auto metrics_file = fyber::cli::metrics_file(argc, argv);
+  if (!metrics_file.has_value()) return;
 
-  if (networks.empty()) {
-    throw fyber::ExitMessage::EmptyPodFile("No supported networks found in your Podfile");
+  try {
+    metrics.merge_into_file(metrics_file.value());
+    SKAD_DEBUG("Metrics written to `{}`", metrics_file.value());
+  } catch (const std::exception& e) {
+    spdlog::warn("Unable to write the metrics : {}", e.what());
   }
-
-  return networks;
 }
 
-/// Get the list of networks to fetch provided by the cli options
-/// \param options - cli options
-/// \return a list of network names
-/// \throws EmptyNetworkList if the provided list is empty
-std::vector<std::string> networks_list_by_options(const fyber::Options& options)
+/// Write the spans of the run to [path]. <br/>
+/// Failing to do so is logged but doesn't change the outcome of the run.
+void write_trace(const std::string& path)
 {
-  auto networks = options.network_list.value();
-
-  if (networks.empty()) {
-    throw fyber::ExitMessage::EmptyNetworkList("A non-empty list of networks must be provided");
+  try {
+    fyber::Trace::global().write(path);
+    SKAD_DEBUG("Trace written to `{}`", path);
+  } catch (const std::exception& e) {
+    spdlog::warn("Unable to write the trace : {}", e.what());
   }
-  return networks;
 }
 
-/// Merge two network lists uniquely while perserving order </br>
-/// <b> NOTE: </b> This is function is mutating its paramters
-/// \param base_networks the list to merge into
-/// \param networks_to_merge the list that will be merged
-void merge_network_lists(std::vector<std::string>& base_networks, std::vector<std::string>& networks_to_merge)
+/// The plists of [summary] by status, the dry runs only when there are some
+std::string status_counts(const fyber::ReportSummary& summary)
 {
-  std::remove_copy_if(networks_to_merge.begin(), networks_to_merge.end(), back_inserter(base_networks),
-                      [&base_networks](const std::string& network) {
-                        return base_networks.end() != std::find(base_networks.begin(), base_networks.end(), network);
-                      });
+  std::string counts = std::to_string(summary.updated) + " updated, ";
+  if (summary.would_update > 0) counts += std::to_string(summary.would_update) + " would update, ";
+  return counts + std::to_string(summary.unchanged) + " unchanged, " + std::to_string(summary.failed) + " failed";
 }
 
-/// Update or Print (on `dry_run`) the Info.Plist file
-/// \param options - cli options
-/// \param plist
-void update_network_IDs(const fyber::Options& options, fyber::Plist& plist)
+/// Update every plist of the batch (or of its shard), going on after failures, and report on them. <br/>
+/// The documents of every plist are released from [arena] once it's processed.
+/// \return 0, or the exit code of the first failed plist
+int run_batch(const fyber::Updater& updater, const fyber::Options& options, fyber::memory::Arena& arena)
 {
-  spdlog::info("Updating `{}`", options.plist_file_path.value());
+  std::vector<fyber::Job> jobs;
 
-  std::string raw_new_file = plist.build_plist_SKAdNetworkItems();
+  if (options.plist_file_path.has_value()) {
+    jobs.push_back(fyber::Job{options.plist_file_path.value(), options.pod_file_path});
+  }
 
-  if (options.dry_run) {
-    spdlog::info("These network IDs will be added: {}", plist.new_sk_ad_network_items_str());
-    spdlog::debug("Printing modified `{}`", options.plist_file_path.value());
-    spdlog::debug(raw_new_file);
-  } else {
-    plist.update_file(true);
+  if (options.batch.batch_file.has_value()) {
+    auto listed = fyber::Batch::read_batch_file(options.batch.batch_file.value(), options.pod_file_path);
+    jobs.insert(jobs.end(), listed.begin(), listed.end());
+  }
+
+  if (options.batch.discover_dir.has_value()) {
+    auto discovered = fyber::Batch::discover(options.batch.discover_dir.value(), options.pod_file_path);
+    jobs.insert(jobs.end(), discovered.begin(), discovered.end());
+  }
+
+  if (options.batch.shard.has_value()) {
+    auto total = jobs.size();
+    jobs = fyber::Batch::shard(jobs, options.batch.shard.value());
+    spdlog::info("Shard {} has {} of {} plists", options.batch.shard->to_string(), jobs.size(), total);
+  }
+
+  // Past a single plist the logs add up, they are written from a background thread
+  if (jobs.size() > 1) fyber::logging::use_async_logger();
+
+  fyber::Report report(options.batch.shard);
+  int exit_code = 0;
+
+  auto add_result = [&](fyber::UpdateResult result) {
+    if (options.report == fyber::ReportFormat::JsonLines) {
+      fyber::logging::output(fyber::Report::to_json_line(result));
+    }
+    report.add(std::move(result));
+  };
+
+  fyber::Batch::run(jobs, arena, [&](size_t i, const fyber::Job& job) {
+    spdlog::info("Processing `{}` ({}/{})", job.plist_file_path, i + 1, jobs.size());
+
+    auto fail = [&](const fyber::ExitMessage& err) {
+      spdlog::error(err.what());
+
+      fyber::UpdateResult failure;
+      failure.plist_file_path = job.plist_file_path;
+      failure.status = fyber::UpdateResult::Status::Failed;
+      failure.exit_code = err.code;
+      failure.error = err.what();
+      failure.dry_run = options.dry_run;
+      add_result(failure);
+
+      if (exit_code == 0) exit_code = err.code;
+    };
+
+    try {
+      const auto& pod_target = job.pod_target.has_value() ? job.pod_target : options.pod_target;
+      add_result(updater.update(job.plist_file_path, job.pod_file_path, options.network_list, options.dry_run,
+                                options.output, pod_target));
+    } catch (fyber::ExitMessage& err) {
+      fail(err);
+    } catch (const std::exception& e) {
+      fail(fyber::ExitMessage::Oops(e.what()));
+    }
+  });
+
+  auto summary = report.summary();
+  spdlog::info("Processed {} plists: {}", jobs.size(), status_counts(summary));
+
+  if (options.batch.shard_report.has_value()) {
+    report.write(options.batch.shard_report.value());
+    spdlog::info("Report written to `{}`", options.batch.shard_report.value());
   }
+
+  if (options.report == fyber::ReportFormat::Json) fyber::logging::output(report.to_json());
+
+  return exit_code;
 }
 
-/// Set the log level as DEBUG if the environment variable 'FYBER_SKAD_DEBUG_LOG' exists
-void set_log_level()
+/// Combine the reports of shards into a single report
+/// \return 0, or the exit code of the first failed plist
+int merge_reports(const fyber::MergeReportsOptions& options)
 {
-  if (getenv("FYBER_SKAD_DEBUG_LOG")) {
-    spdlog::set_level(spdlog::level::debug);
-  } else {
-    spdlog::set_level(spdlog::level::info);
+  if (options.show_help.has_value()) {
+    fyber::logging::output(options.show_help.value());
+    return 0;
   }
+
+  std::vector<fyber::Report> reports;
+  for (const auto& path : options.reports) reports.push_back(fyber::Report::read(path));
+
+  auto merged = fyber::Report::merge(reports);
+  merged.write(options.output);
+
+  auto summary = merged.summary();
+  std::vector<std::string> ids_added;
+  for (const auto& [network, count] : summary.ids_added)
+    ids_added.push_back(network.str() + ": " + std::to_string(count));
+
+  spdlog::info("Merged {} reports, {} plists: {}", reports.size(), merged.projects().size(), status_counts(summary));
+  spdlog::info("IDs added: {}", fyber::common::join(ids_added, ", "));
+  spdlog::info("Report written to `{}`", options.output);
+
+  for (const auto& project : merged.projects()) {
+    if (project.status == fyber::UpdateResult::Status::Failed) return project.exit_code;
+  }
+  return 0;
 }
@@ -0,0 +1,251 @@
+#include "skad.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Arena.h"
+#include "ManagerApi.h"
+#include "Plist.h"
+#include "Updater.h"
+#include "common.h"
+#include "exit_message.h"
+
+using std::string;
+using std::vector;
+
+struct skad_context
+{
+  fyber::ManagerApi manager_api;
+  fyber::Updater updater;
+  fyber::memory::Arena arena;
+  bool use_arena = false;
+  size_t open_plists = 0;
+
+  explicit skad_context(string url) : manager_api(std::move(url)), updater(manager_api) {}
+};
+
+struct skad_plist
+{
+  skad_context* context;
+  fyber::Plist plist;
+
+  // Backing storage of the structures handed out through the C API
+  vector<fyber::Symbol> networks;
+  vector<const char*> networks_view;
+  vector<const char*> existing_view;
+  vector<const char*> new_view;
+  vector<vector<const char*>> ids_views;
+  vector<skad_network_ids> network_ids;
+  skad_diff diff{};
+  string xml;
+
+  skad_plist(skad_context* context, string path) : context(context), plist(std::move(path)) { context->open_plists++; }
+  ~skad_plist() { context->open_plists--; }
+};
+
+namespace {
+
+thread_local string last_error;
+
+int fail(const fyber::ExitMessage& err)
+{
+  last_error = err.what();
+  return err.code;
+}
+
+/// Run [block], converting exceptions into return codes: none may cross the C API
+template <typename F>
+int guarded(F&& block)
+{
+  try {
+    block();
+    last_error.clear();
+    return SKAD_OK;
+  } catch (fyber::ExitMessage& err) {
+    return fail(err);
+  } catch (const std::exception& e) {
+    return fail(fyber::ExitMessage::Oops(e.what()));
+  } catch (...) {
+    return fail(fyber::ExitMessage::Oops("Unknown exception"));
+  }
+}
+
+/// Run [block] within the arena of [context] (when enabled), converting exceptions into return codes
+template <typename F>
+int guarded(skad_context* context, F&& block)
+{
+  return guarded([&] {
+    std::optional<fyber::memory::ArenaScope> arena_scope;
+    if (context->use_arena) arena_scope.emplace(context->arena);
+
+    block();
+  });
+}
+
+template <typename C>
+skad_string_list to_list(const C& strings, vector<const char*>& view)
+{
+  view.clear();
+  for (const auto& s : strings) view.push_back(s.c_str());
+  return skad_string_list{view.data(), view.size()};
+}
+
+}  // namespace
+
+extern "C"
+{
+
+  const char* skad_version(void)
+  {
+    return skad_updater_VERSION;
+  }
+
+  const char* skad_last_error(void)
+  {
+    return last_error.c_str();
+  }
+
+  skad_context* skad_context_new(const char* server_url)
+  {
+    skad_context* context = nullptr;
+    guarded([&] {
+      const char* server_host_override = std::getenv("FYBER_SKAD_NETWORKS_SERVER_HOST");
+      string url = server_url != nullptr             ? server_url
+                   : server_host_override != nullptr ? server_host_override
+                                                     : "https://network-setup.fyber.com";
+
+      context = new skad_context(url);
+    });
+    return context;
+  }
+
+  void skad_context_free(skad_context* context)
+  {
+    delete context;
+  }
+
+  int skad_context_use_arena(skad_context* context, int enabled)
+  {
+    if (context == nullptr) return fail(fyber::ExitMessage::InvalidArguments("context is required"));
+
+    context->use_arena = enabled != 0;
+    return SKAD_OK;
+  }
+
+  int skad_context_use_cache_dir(skad_context* context, const char* cache_dir, long ttl_seconds)
+  {
+    if (context == nullptr or cache_dir == nullptr) {
+      return fail(fyber::ExitMessage::InvalidArguments("context and cache_dir are required"));
+    }
+
+    return guarded(context, [&] {
+      auto ttl = ttl_seconds > 0 ? std::chrono::seconds(ttl_seconds) : fyber::DiskCache::default_ttl;
+      context->manager_api.use_disk_cache(cache_dir, ttl);
+    });
+  }
+
+  int skad_context_reset(skad_context* context)
+  {
+    if (context == nullptr) return fail(fyber::ExitMessage::InvalidArguments("context is required"));
+    if (context->open_plists > 0) {
+      return fail(fyber::ExitMessage::InvalidArguments(std::to_string(context->open_plists) +
+                                                       " plists must be freed before resetting the context"));
+    }
+
+    context->arena.reset();
+    return SKAD_OK;
+  }
+
+  int skad_plist_open(skad_context* context, const char* plist_file_path, skad_plist** out_plist)
+  {
+    if (context == nullptr or plist_file_path == nullptr or out_plist == nullptr) {
+      return fail(fyber::ExitMessage::InvalidArguments("context, plist_file_path and out_plist are required"));
+    }
+
+    return guarded(context, [&] { *out_plist = new skad_plist(context, plist_file_path); });
+  }
+
+  void skad_plist_free(skad_plist* plist)
+  {
+    delete plist;
+  }
+
+  int skad_compute_diff(skad_context* context, skad_plist* plist, const char* pod_file_path,
+                        const char* const* networks, size_t networks_count, const skad_diff** out_diff)
+  {
+    if (context == nullptr or plist == nullptr or out_diff == nullptr) {
+      return fail(fyber::ExitMessage::InvalidArguments("context, plist and out_diff are required"));
+    }
+
+    return guarded(context, [&] {
+      std::optional<string> maybe_pod_file_path;
+      if (pod_file_path != nullptr) maybe_pod_file_path = pod_file_path;
+
+      std::optional<vector<fyber::Symbol>> maybe_networks;
+      if (networks_count > 0) {
+        maybe_networks.emplace();
+        for (size_t i = 0; i < networks_count; ++i) {
+          auto network = fyber::common::trim_view(networks[i]);
+          if (!network.empty()) maybe_networks->emplace_back(network);
+        }
+      }
+
+      if (!maybe_pod_file_path.has_value() and !maybe_networks.has_value()) {
+        throw fyber::ExitMessage::InvalidArguments("At least one of pod_file_path or networks is required.");
+      }
+
+      plist->networks = context->updater.resolve_networks(maybe_pod_file_path, maybe_networks);
+      context->updater.compute_diff(plist->plist, plist->networks);
+
+      const auto& mapping = plist->plist.network_items_mapping();
+      plist->ids_views.assign(mapping.size(), {});
+      plist->network_ids.clear();
+
+      size_t i = 0;
+      for (const auto& [network, ids] : mapping) {
+        plist->network_ids.push_back(skad_network_ids{network.c_str(), to_list(ids, plist->ids_views[i++])});
+      }
+
+      plist->diff.networks = to_list(plist->networks, plist->networks_view);
+      plist->diff.existing_ids = to_list(plist->plist.existing_sk_ad_network_items(), plist->existing_view);
+      plist->diff.new_ids = to_list(plist->plist.new_sk_ad_network_items(), plist->new_view);
+      plist->diff.network_ids = plist->network_ids.data();
+      plist->diff.network_ids_count = plist->network_ids.size();
+      plist->diff.should_update = plist->plist.should_update() ? 1 : 0;
+
+      *out_diff = &plist->diff;
+    });
+  }
+
+  int skad_build(skad_plist* plist, const char** out_xml)
+  {
+    if (plist == nullptr or out_xml == nullptr) {
+      return fail(fyber::ExitMessage::InvalidArguments("plist and out_xml are required"));
+    }
+
+    return guarded(plist->context, [&] {
+      plist->xml = plist->plist.build_plist_SKAdNetworkItems();
+      *out_xml = plist->xml.c_str();
+    });
+  }
+
+  int skad_apply(skad_plist* plist, int backup, const char** out_backup_path)
+  {
+    if (plist == nullptr) return fail(fyber::ExitMessage::InvalidArguments("plist is required"));
+
+    return guarded(plist->context, [&] {
+      if (out_backup_path != nullptr) *out_backup_path = nullptr;
+      if (!plist->plist.should_update()) return;
+
+      plist->plist.build_plist_SKAdNetworkItems();
+      plist->plist.update_file(backup != 0);
+
+      if (out_backup_path != nullptr and backup != 0) *out_backup_path = plist->plist.backup_path().c_str();
+    });
+  }
+
+}  // extern "C"
@@ -0,0 +1,100 @@
+#pragma once
+/// libskad - a C API for embedding the SKAd updater in-process.
+///
+/// All functions return `SKAD_OK` (0) on success, or one of the `skad_updater` exit codes on failure, in which case
+/// `skad_last_error()` describes the failure.
+/// Strings and lists handed out by the library are owned by the object they were obtained from, and stay valid until
+/// the next call on that object or until it is freed.
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define SKAD_OK 0
+
+  /// Holds the connection to the SKAdNetwork manager service and the catalog responses received from it.
+  /// Reuse a single context for many plists to avoid repeating requests.
+  typedef struct skad_context skad_context;
+
+  /// A loaded Info.plist file
+  typedef struct skad_plist skad_plist;
+
+  typedef struct skad_string_list
+  {
+    const char* const* items;
+    size_t count;
+  } skad_string_list;
+
+  /// The SKAdNetwork IDs introduced by a single network
+  typedef struct skad_network_ids
+  {
+    const char* network;
+    skad_string_list ids;
+  } skad_network_ids;
+
+  /// The difference between a plist and the SKAdNetwork IDs of the requested networks
+  typedef struct skad_diff
+  {
+    /// The networks the IDs were requested for, in request order
+    skad_string_list networks;
+    /// The SKAdNetwork IDs already in the plist
+    skad_string_list existing_ids;
+    /// The SKAdNetwork IDs that are missing from the plist
+    skad_string_list new_ids;
+    /// The IDs received for each requested network
+    const skad_network_ids* network_ids;
+    size_t network_ids_count;
+    /// Whether `skad_apply` would modify the plist
+    int should_update;
+  } skad_diff;
+
+  /// The version of the library
+  const char* skad_version(void);
+
+  /// The message of the last failure on the calling thread
+  const char* skad_last_error(void);
+
+  /// Create a context for the service at [server_url], or a comma-separated list of its endpoints. When NULL,
+  /// `FYBER_SKAD_NETWORKS_SERVER_HOST` or the default service is used.
+  /// \return NULL if there's no endpoint or the context can't be created, see `skad_last_error`
+  skad_context* skad_context_new(const char* server_url);
+  void skad_context_free(skad_context* context);
+
+  /// Allocate the documents of the plists opened with [context] from a monotonic arena instead of the heap.
+  /// Everything they allocated is released at once by `skad_context_reset`.
+  int skad_context_use_arena(skad_context* context, int enabled);
+
+  /// Share the catalog responses with other processes through the cache in [cache_dir], reusing them for [ttl_seconds]
+  /// (the default TTL when 0). Concurrent processes missing the same response wait for the first one to fetch it.
+  int skad_context_use_cache_dir(skad_context* context, const char* cache_dir, long ttl_seconds);
+
+  /// Release the arena of [context]. Every plist opened with it must have been freed already.
+  int skad_context_reset(skad_context* context);
+
+  /// Load and parse the plist in [plist_file_path]. <br/>
+  /// The file is locked (with an advisory `flock`) until the plist is freed, so concurrent updates by other processes
+  /// wait for it. Opening the same file twice at once blocks.
+  int skad_plist_open(skad_context* context, const char* plist_file_path, skad_plist** out_plist);
+  void skad_plist_free(skad_plist* plist);
+
+  /// Compute which SKAdNetwork IDs are missing from [plist] for the networks used in [pod_file_path] (may be NULL)
+  /// merged with the explicit [networks] (may be NULL when [networks_count] is 0).
+  /// \param out_diff set to a diff owned by [plist]
+  int skad_compute_diff(skad_context* context, skad_plist* plist, const char* pod_file_path,
+                        const char* const* networks, size_t networks_count, const skad_diff** out_diff);
+
+  /// Build the updated plist XML without writing it.
+  /// \param out_xml set to a string owned by [plist]
+  int skad_build(skad_plist* plist, const char** out_xml);
+
+  /// Write the missing IDs computed by `skad_compute_diff` into the plist file.
+  /// \param backup whether to create an indexed `.bak.X` backup of the original file first
+  /// \param out_backup_path set to the backup path (owned by [plist]), or NULL when no backup was made. May be NULL.
+  int skad_apply(skad_plist* plist, int backup, const char** out_backup_path);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,55 @@
+#include "AllocStats.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace fyber::test {
+
+using memory::alloc_stats;
+using memory::Phase;
+using memory::PhaseScope;
+
+TEST(AllocStats, CountsByPhase)
+{
+  if (!alloc_stats::compiled) GTEST_SKIP() << "Built without SKAD_ALLOC_STATS";
+
+  auto serialize_before = alloc_stats::of(Phase::Serialize);
+  auto write_before = alloc_stats::of(Phase::Write);
+  {
+    PhaseScope serialize(Phase::Serialize);
+    std::vector<std::unique_ptr<std::string>> strings;
+    for (int i = 0; i < 10; ++i) strings.push_back(std::make_unique<std::string>(1000, 'x'));
+
+    {
+      PhaseScope write(Phase::Write);
+      alloc_stats::free(alloc_stats::malloc(4096));
+    }
+  }
+
+  auto serialize = alloc_stats::of(Phase::Serialize);
+  // A string and its buffer each, and the growth of the vector
+  ASSERT_GE(serialize.allocations - serialize_before.allocations, 20);
+  ASSERT_GE(serialize.bytes - serialize_before.bytes, 10 * 1000);
+  ASSERT_GE(serialize.peak_live_bytes, 10 * 1000);
+
+  auto write = alloc_stats::of(Phase::Write);
+  ASSERT_EQ(write.allocations - write_before.allocations, 1);
+  ASSERT_GE(write.bytes - write_before.bytes, 4096);
+  ASSERT_GE(alloc_stats::total().peak_live_bytes, write.peak_live_bytes);
+}
+
+TEST(AllocStats, Report)
+{
+  auto report = alloc_stats::report();
+
+  for (auto phase : alloc_stats::phases()) {
+    ASSERT_NE(report.find(alloc_stats::phase_name(phase)), std::string::npos) << report;
+  }
+  ASSERT_NE(report.find("max RSS: "), std::string::npos) << report;
+  ASSERT_GT(alloc_stats::max_rss_bytes(), 0);
+}
+
+}  // namespace fyber::test
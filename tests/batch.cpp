@@ -0,0 +1,130 @@
+#include "Batch.h"
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Arena.h"
+#include "Plist.h"
+#include "exit_message.h"
+#include "gtest/gtest.h"
+
+namespace fyber::test {
+
+namespace fs = std::filesystem;
+using std::string;
+using std::vector;
+
+namespace {
+
+const fs::path resources = fs::current_path().parent_path().parent_path() / "tests" / "resources";
+
+/// The plist paths of the jobs of [shard], relative to [root]
+vector<string> sharded(const vector<Job>& jobs, const Shard& shard, const fs::path& root)
+{
+  vector<string> paths;
+  for (const auto& job : Batch::shard(jobs, shard)) {
+    paths.push_back(fs::path(job.plist_file_path).lexically_relative(root).generic_string());
+  }
+  return paths;
+}
+
+}  // namespace
+
+TEST(Batch, ShardedTheSameUnderAnyRoot)
+{
+  const auto dir = fs::temp_directory_path() / ("skad_batch_" + std::to_string(::getpid()));
+  fs::remove_all(dir);
+
+  // The same checkout in two workspaces
+  const vector<fs::path> roots = {dir / "ci" / "1" / "repo", dir / "runner" / "repo"};
+  for (const auto& root : roots) {
+    fs::create_directories(root);
+    std::ofstream batch_file(root / "plists.list");
+    for (int i = 0; i < 20; ++i) {
+      const auto plist = root / ("App" + std::to_string(i)) / "Info.plist";
+      fs::create_directories(plist.parent_path());
+      std::ofstream(plist) << "<plist/>";
+      batch_file << plist.string() << '\n';
+    }
+  }
+
+  for (const auto& list : {std::function([](const fs::path& root) { return Batch::discover(root.string(), {}); }),
+                           std::function([](const fs::path& root) {
+                             return Batch::read_batch_file((root / "plists.list").string(), {});
+                           })}) {
+    const auto first = list(roots[0]);
+    const auto second = list(roots[1]);
+    ASSERT_EQ(first.size(), 20);
+
+    size_t total = 0;
+    for (int index = 1; index <= 3; ++index) {
+      const Shard shard{index, 3};
+      ASSERT_EQ(sharded(first, shard, roots[0]), sharded(second, shard, roots[1])) << shard.to_string();
+      total += Batch::shard(first, shard).size();
+    }
+    ASSERT_EQ(total, first.size());
+  }
+
+  fs::remove_all(dir);
+}
+
+TEST(Batch, BatchFileColumnsTrimmedOneByOne)
+{
+  const auto dir = fs::temp_directory_path() / ("skad_batch_file_" + std::to_string(::getpid()));
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  const auto batch_file = (dir / "plists.list").string();
+
+  std::ofstream(batch_file) << "# plist\tpodfile\ttarget\n"
+                               "  A/Info.plist \t Podfile \t App\r\n"
+                               "\n"
+                               "B/Info.plist\t\tWidget\n";
+  auto jobs = Batch::read_batch_file(batch_file, "Default/Podfile");
+  ASSERT_EQ(jobs.size(), 2);
+  ASSERT_EQ(jobs[0].plist_file_path, "A/Info.plist");
+  ASSERT_EQ(jobs[0].pod_file_path, "Podfile");
+  ASSERT_EQ(jobs[0].pod_target, "App");
+  ASSERT_EQ(jobs[1].plist_file_path, "B/Info.plist");
+  ASSERT_EQ(jobs[1].pod_file_path, "Default/Podfile");
+  ASSERT_EQ(jobs[1].pod_target, "Widget");
+
+  // The podfile isn't taken for the missing plist
+  std::ofstream(batch_file) << "A/Info.plist\n"
+                               "\tPodfile\tApp\n";
+  ASSERT_THROW(Batch::read_batch_file(batch_file, std::nullopt), ExitMessage);
+
+  fs::remove_all(dir);
+}
+
+TEST(Batch, EveryJobReleasesItsArena)
+{
+  const vector<Job> jobs(50, Job{(resources / "full.Info.plist").string()});
+
+  memory::Arena arena(4 * 1024);
+  vector<size_t> blocks;
+  Batch::run(jobs, arena, [&](size_t index, const Job& job) {
+    ASSERT_EQ(arena.bytes(), 0) << index;
+
+    Plist plist(job.plist_file_path);
+    plist.set_sk_ad_network_items_for_update({{Symbol("AdColony"), {Symbol("added.skadnetwork")}}});
+    plist.build_plist_SKAdNetworkItems();
+
+    ASSERT_GT(arena.bytes(), 0) << index;
+    blocks.push_back(arena.blocks());
+  });
+
+  // Each plist is served from the blocks of the first one, nothing piles up
+  ASSERT_EQ(blocks.size(), jobs.size());
+  ASSERT_GT(blocks.front(), 1);
+  for (auto count : blocks) ASSERT_EQ(count, blocks.front());
+
+  ASSERT_EQ(arena.bytes(), 0);
+  ASSERT_EQ(arena.blocks(), 1);
+}
+
+}  // namespace fyber::test
@@ -0,0 +1,156 @@
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "MockServer.h"
+#include "gtest/gtest.h"
+#include "skad.h"
+
+namespace fyber::test {
+
+namespace {
+
+namespace fs = std::filesystem;
+using std::string;
+using std::vector;
+
+const fs::path resources = fs::current_path().parent_path().parent_path() / "tests" / "resources";
+
+vector<string> to_vector(const skad_string_list& list)
+{
+  return vector<string>(list.items, list.items + list.count);
+}
+
+string read_file(const fs::path& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  std::stringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+
+}  // namespace
+
+class CApi : public ::testing::Test
+{
+ protected:
+  MockServer server;
+  skad_context* context = nullptr;
+  fs::path work_dir;
+
+  void SetUp() override
+  {
+    server.start();
+    context = skad_context_new(server.url().c_str());
+
+    work_dir = fs::temp_directory_path() / ("skad_c_api_" + std::to_string(server.port()));
+    fs::create_directories(work_dir);
+    fs::copy_file(resources / "Info.plist", work_dir / "Info.plist", fs::copy_options::overwrite_existing);
+  }
+
+  void TearDown() override
+  {
+    skad_context_free(context);
+    fs::remove_all(work_dir);
+  }
+};
+
+TEST_F(CApi, ComputeDiffAndApply)
+{
+  skad_plist* plist = nullptr;
+  ASSERT_EQ(skad_plist_open(context, (work_dir / "Info.plist").c_str(), &plist), SKAD_OK);
+
+  const skad_diff* diff = nullptr;
+  ASSERT_EQ(skad_compute_diff(context, plist, (resources / "Podfile").c_str(), nullptr, 0, &diff), SKAD_OK);
+
+  ASSERT_EQ(to_vector(diff->networks), vector<string>({"AdColony", "ChartboostSDK", "Google-Mobile-Ads-SDK"}));
+  ASSERT_EQ(to_vector(diff->existing_ids),
+            vector<string>({"4PFYVQ9L8R.skadnetwork", "V72QYCH5UU.skadnetwork", "YCLNXRL5PM.skadnetwork"}));
+  ASSERT_EQ(to_vector(diff->new_ids), vector<string>({"blskdfjl2e3.skadnetwork", "cstr6suwn9.skadnetwork"}));
+  ASSERT_EQ(diff->network_ids_count, 3);
+  ASSERT_STREQ(diff->network_ids[0].network, "AdColony");
+  ASSERT_EQ(to_vector(diff->network_ids[0].ids), vector<string>({"4PFYVQ9L8R.skadnetwork", "YCLNXRL5PM.skadnetwork"}));
+  ASSERT_EQ(diff->should_update, 1);
+
+  const char* backup_path = nullptr;
+  ASSERT_EQ(skad_apply(plist, 1, &backup_path), SKAD_OK);
+  ASSERT_STREQ(backup_path, (work_dir / "Info.plist.bak.1").c_str());
+  skad_plist_free(plist);
+
+  ASSERT_EQ(skad_plist_open(context, (work_dir / "Info.plist").c_str(), &plist), SKAD_OK);
+  ASSERT_EQ(skad_compute_diff(context, plist, (resources / "Podfile").c_str(), nullptr, 0, &diff), SKAD_OK);
+  ASSERT_EQ(diff->new_ids.count, 0);
+  ASSERT_EQ(diff->should_update, 0);
+  skad_plist_free(plist);
+}
+
+TEST_F(CApi, ContextReusesCatalogResponses)
+{
+  const char* networks[] = {"Applovin"};
+
+  for (int i = 0; i < 3; ++i) {
+    skad_plist* plist = nullptr;
+    const skad_diff* diff = nullptr;
+    ASSERT_EQ(skad_plist_open(context, (work_dir / "Info.plist").c_str(), &plist), SKAD_OK);
+    ASSERT_EQ(skad_compute_diff(context, plist, (resources / "Podfile").c_str(), networks, 1, &diff), SKAD_OK);
+    ASSERT_EQ(to_vector(diff->new_ids),
+              vector<string>({"blskdfjl2e3.skadnetwork", "cstr6suwn9.skadnetwork", "ludvb6z3bs.skadnetwork"}));
+    skad_plist_free(plist);
+  }
+
+  ASSERT_EQ(server.requests("/networks"), 1);
+  ASSERT_EQ(server.requests("/plist"), 1);
+}
+
+TEST_F(CApi, BuildWithoutWriting)
+{
+  const char* networks[] = {"Applovin"};
+  skad_plist* plist = nullptr;
+  const skad_diff* diff = nullptr;
+  const char* xml = nullptr;
+
+  ASSERT_EQ(skad_plist_open(context, (work_dir / "Info.plist").c_str(), &plist), SKAD_OK);
+  ASSERT_EQ(skad_compute_diff(context, plist, nullptr, networks, 1, &diff), SKAD_OK);
+  ASSERT_EQ(skad_build(plist, &xml), SKAD_OK);
+
+  ASSERT_NE(string(xml).find("ludvb6z3bs.skadnetwork"), string::npos);
+  ASSERT_FALSE(fs::exists(work_dir / "Info.plist.bak.1"));
+  skad_plist_free(plist);
+}
+
+TEST_F(CApi, BuildFormatsLikeXcode)
+{
+  const char* networks[] = {"ChartboostSDK"};
+
+  for (const string name : {"simple", "unformatted"}) {
+    skad_plist* plist = nullptr;
+    const skad_diff* diff = nullptr;
+    const char* xml = nullptr;
+
+    ASSERT_EQ(skad_plist_open(context, (resources / (name + ".Info.plist")).c_str(), &plist), SKAD_OK);
+    ASSERT_EQ(skad_compute_diff(context, plist, nullptr, networks, 1, &diff), SKAD_OK);
+    ASSERT_EQ(skad_build(plist, &xml), SKAD_OK);
+
+    ASSERT_EQ(string(xml), read_file(resources / (name + ".xcode.Info.plist"))) << name;
+    skad_plist_free(plist);
+  }
+}
+
+TEST_F(CApi, Errors)
+{
+  skad_plist* plist = nullptr;
+  ASSERT_EQ(skad_plist_open(context, (work_dir / "NotExisting.Info.plist").c_str(), &plist), 9);
+  ASSERT_STREQ(skad_last_error(), "Provided plist_file_path is invalid : -does not exist-");
+
+  const skad_diff* diff = nullptr;
+  ASSERT_EQ(skad_plist_open(context, (work_dir / "Info.plist").c_str(), &plist), SKAD_OK);
+  ASSERT_EQ(skad_compute_diff(context, plist, (resources / "NoNetworksPodfile").c_str(), nullptr, 0, &diff), 4);
+  ASSERT_STREQ(skad_last_error(), "No supported networks found in your Podfile");
+
+  ASSERT_EQ(skad_compute_diff(context, plist, nullptr, nullptr, 0, &diff), 1);
+  skad_plist_free(plist);
+}
+
+}  // namespace fyber::test
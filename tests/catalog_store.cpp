@@ -0,0 +1,140 @@
+#include "CatalogStore.h"
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "Limits.h"
+#include "exit_message.h"
+#include "gtest/gtest.h"
+
+namespace fyber::test {
+
+namespace fs = std::filesystem;
+using std::string;
+using std::vector;
+
+namespace {
+
+const string whole = R"({"version": 3, "networks": {"AdColony": ["4PFYVQ9L8R.skadnetwork", "YCLNXRL5PM.skadnetwork"],)"
+                     R"("Applovin": ["ludvb6z3bs.skadnetwork"], "Unknown_network": []}})";
+
+vector<Symbol> ids(std::initializer_list<const char*> names)
+{
+  vector<Symbol> symbols;
+  for (const char* name : names) symbols.emplace_back(name);
+  return symbols;
+}
+
+}  // namespace
+
+TEST(CatalogStore, ReplacedByAWholeCatalog)
+{
+  CatalogStore store;
+  ASSERT_TRUE(store.empty());
+
+  ASSERT_EQ(store.apply_response(whole), CatalogStore::Update::Replaced);
+  ASSERT_EQ(store.version(), 3);
+  ASSERT_EQ(store.networks(), ids({"AdColony", "Applovin", "Unknown_network"}));
+
+  auto sk_ad_networks = store.sk_ad_networks(ids({"Applovin", "NotInTheCatalog"}));
+  ASSERT_EQ(sk_ad_networks.size(), 2);
+  ASSERT_EQ(sk_ad_networks.at(Symbol("Applovin")), ids({"ludvb6z3bs.skadnetwork"}));
+  ASSERT_TRUE(sk_ad_networks.at(Symbol("NotInTheCatalog")).empty());
+}
+
+TEST(CatalogStore, ChangesAppliedInPlace)
+{
+  CatalogStore store;
+  store.apply_response(whole);
+
+  CatalogStore::Delta delta;
+  ASSERT_EQ(store.apply_response(R"({"version": 5, "since": 3, "added": {"Applovin": ["v9wttpbfk9.skadnetwork"],)"
+                                 R"("ChartboostSDK": ["f38h382jlk.skadnetwork"]},)"
+                                 R"("removed": {"AdColony": ["4PFYVQ9L8R.skadnetwork"]},)"
+                                 R"("removed_networks": ["Unknown_network"]})",
+                                 &delta),
+            CatalogStore::Update::Changed);
+  ASSERT_EQ(delta.size(), 4);
+
+  ASSERT_EQ(store.version(), 5);
+  // New networks come last, as in the service
+  ASSERT_EQ(store.networks(), ids({"AdColony", "Applovin", "ChartboostSDK"}));
+  auto sk_ad_networks = store.sk_ad_networks(store.networks());
+  ASSERT_EQ(sk_ad_networks.at(Symbol("AdColony")), ids({"YCLNXRL5PM.skadnetwork"}));
+  ASSERT_EQ(sk_ad_networks.at(Symbol("Applovin")), ids({"ludvb6z3bs.skadnetwork", "v9wttpbfk9.skadnetwork"}));
+
+  ASSERT_EQ(store.apply_response(R"({"version": 6, "since": 5, "added": {}, "removed": {}})"),
+            CatalogStore::Update::Unchanged);
+  ASSERT_EQ(store.version(), 6);
+
+  // A network added without IDs is a change
+  ASSERT_EQ(store.apply_response(R"({"version": 7, "since": 6, "added": {"Unknown_network": []}})"),
+            CatalogStore::Update::Changed);
+  ASSERT_EQ(store.networks().size(), 4);
+}
+
+TEST(CatalogStore, InvalidChangesLeaveTheStoreUnchanged)
+{
+  CatalogStore store;
+  store.apply_response(whole);
+  const auto before = store.to_json();
+
+  for (const char* invalid :
+       {R"({"version": 5, "since": 4, "added": {"Applovin": ["a"]}})", R"({"version": 2, "since": 3})",
+        R"({"version": 0, "networks": {}})", R"({"version": 5, "since": 3, "added": {"Applovin": "a"}})",
+        R"({"networks": {}})", R"({"version": "5", "since": 3})", "[]", "{"}) {
+    ASSERT_THROW(store.apply_response(invalid), ExitMessage) << invalid;
+    ASSERT_EQ(store.to_json(), before) << invalid;
+  }
+
+  const auto max_ids = Limits::global().max_ids_per_network;
+  Limits::global().max_ids_per_network = 2;
+  ASSERT_THROW(store.apply_response(R"({"version": 4, "since": 3, "added": {"AdColony": ["a"]}})"), ExitMessage);
+  ASSERT_EQ(store.to_json(), before);
+  Limits::global().max_ids_per_network = max_ids;
+}
+
+TEST(CatalogStore, SavedAsACatalogAndAJournal)
+{
+  const auto dir = fs::temp_directory_path() / ("skad_catalog_store_" + std::to_string(::getpid()));
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+
+  ASSERT_TRUE(CatalogStore::load(dir).empty());
+  ASSERT_FALSE(CatalogStore::is_fresh(dir, std::chrono::seconds(60)));
+
+  CatalogStore store;
+  CatalogStore::Delta delta;
+  store.save(dir, store.apply_response(whole, &delta), delta);
+  ASSERT_TRUE(CatalogStore::is_fresh(dir, std::chrono::seconds(60)));
+  ASSERT_EQ(fs::file_size(dir / "catalog.journal"), 0);
+
+  auto update = store.apply_response(R"({"version": 4, "since": 3, "added": {"Applovin": ["a"]}})", &delta);
+  store.save(dir, update, delta);
+  ASSERT_GT(fs::file_size(dir / "catalog.journal"), 0);
+  ASSERT_EQ(CatalogStore::load(dir).to_json(), store.to_json());
+
+  // Folded into the catalog once the journal outgrows it
+  for (uint64_t version = 5; fs::file_size(dir / "catalog.journal") > 0; ++version) {
+    ASSERT_LT(version, 100);
+    update = store.apply_response(
+        R"({"version": )" + std::to_string(version) + R"(, "since": )" + std::to_string(version - 1) + "}", &delta);
+    store.save(dir, update, delta);
+  }
+  ASSERT_EQ(CatalogStore::load(dir).to_json(), store.to_json());
+
+  // Changes are applied as far as they follow each other
+  const auto version = store.version();
+  {
+    std::ofstream journal(dir / "catalog.journal", std::ios::app);
+    journal << "{\n" << CatalogStore::to_json(CatalogStore::Delta{version, version + 1}) << "\n";
+  }
+  ASSERT_EQ(CatalogStore::load(dir).version(), version);
+
+  fs::remove_all(dir);
+}
+
+}  // namespace fyber::test
@@ -0,0 +1,134 @@
+#include "ContentDecoder.h"
+
+#include <zlib.h>
+
+#include <string>
+
+#ifdef SKAD_ZSTD
+#include <zstd.h>
+#endif
+
+#include "exit_message.h"
+#include "gtest/gtest.h"
+
+namespace fyber::test {
+
+using std::string;
+
+namespace {
+
+const string json = R"({"AdColony": ["4PFYVQ9L8R.skadnetwork", "YCLNXRL5PM.skadnetwork"], "Unknown_network": []})";
+
+string gzip(const string& data)
+{
+  z_stream stream{};
+  deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 16 + 15, 9, Z_DEFAULT_STRATEGY);
+
+  string compressed(deflateBound(&stream, static_cast<uLong>(data.size())), '\0');
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.size());
+  stream.next_out = reinterpret_cast<Bytef*>(compressed.data());
+  stream.avail_out = static_cast<uInt>(compressed.size());
+  deflate(&stream, Z_FINISH);
+  compressed.resize(stream.total_out);
+  deflateEnd(&stream);
+  return compressed;
+}
+
+/// Decode [data] fed [chunk] bytes at a time
+string decode(const string& data, size_t chunk, ContentDecoder::Encoding* encoding = nullptr)
+{
+  ContentDecoder decoder(0);
+  string body;
+  for (size_t offset = 0; offset < data.size(); offset += chunk) {
+    EXPECT_TRUE(decoder.feed(std::string_view(data).substr(offset, chunk), body));
+  }
+  decoder.finish(body);
+
+  EXPECT_EQ(decoder.received_bytes(), data.size());
+  if (encoding != nullptr) *encoding = decoder.encoding();
+  return body;
+}
+
+}  // namespace
+
+TEST(ContentDecoder, Identity)
+{
+  ContentDecoder::Encoding encoding;
+  ASSERT_EQ(decode(json, 1, &encoding), json);
+  ASSERT_EQ(encoding, ContentDecoder::Encoding::Identity);
+
+  ASSERT_EQ(decode(json, json.size()), json);
+  ASSERT_EQ(decode("", 1), "");
+  // Shorter than a magic number
+  ASSERT_EQ(decode("{", 1), "{");
+}
+
+TEST(ContentDecoder, Gzip)
+{
+  const string compressed = gzip(json);
+
+  for (size_t chunk : {size_t(1), size_t(3), size_t(64), compressed.size()}) {
+    ContentDecoder::Encoding encoding;
+    ASSERT_EQ(decode(compressed, chunk, &encoding), json) << chunk;
+    ASSERT_EQ(encoding, ContentDecoder::Encoding::Gzip);
+  }
+
+  // Larger than a decoded chunk
+  const string large(1024 * 1024, 'a');
+  ASSERT_EQ(decode(gzip(large), 4096), large);
+}
+
+TEST(ContentDecoder, LimitsTheDecodedSize)
+{
+  // 16K of compressed bytes decoding to 16M
+  const string bomb = gzip(string(16 * 1024 * 1024, '\0'));
+
+  ContentDecoder decoder(1024 * 1024);
+  string body;
+  bool within_limit = true;
+  for (size_t offset = 0; offset < bomb.size() and within_limit; offset += 1024) {
+    within_limit = decoder.feed(std::string_view(bomb).substr(offset, 1024), body);
+  }
+
+  ASSERT_FALSE(within_limit);
+  ASSERT_LT(body.size(), 2 * 1024 * 1024);
+}
+
+TEST(ContentDecoder, CorruptedAndTruncated)
+{
+  const string compressed = gzip(json);
+
+  ContentDecoder truncated(0);
+  string body;
+  ASSERT_TRUE(truncated.feed(std::string_view(compressed).substr(0, compressed.size() / 2), body));
+  ASSERT_THROW(truncated.finish(body), ExitMessage);
+
+  string corrupted = compressed;
+  for (size_t i = 10; i < corrupted.size(); ++i) corrupted[i] = static_cast<char>(0xff);
+  ContentDecoder decoder(0);
+  ASSERT_THROW(decoder.feed(corrupted, body), ExitMessage);
+}
+
+#ifdef SKAD_ZSTD
+TEST(ContentDecoder, Zstd)
+{
+  ASSERT_EQ(string(ContentDecoder::accept_encoding()), "zstd, gzip");
+
+  string compressed(ZSTD_compressBound(json.size()), '\0');
+  compressed.resize(ZSTD_compress(compressed.data(), compressed.size(), json.data(), json.size(), 3));
+
+  for (size_t chunk : {size_t(1), size_t(7), compressed.size()}) {
+    ContentDecoder::Encoding encoding;
+    ASSERT_EQ(decode(compressed, chunk, &encoding), json) << chunk;
+    ASSERT_EQ(encoding, ContentDecoder::Encoding::Zstd);
+  }
+
+  ContentDecoder truncated(0);
+  string body;
+  ASSERT_TRUE(truncated.feed(std::string_view(compressed).substr(0, compressed.size() - 3), body));
+  ASSERT_THROW(truncated.finish(body), ExitMessage);
+}
+#endif
+
+}  // namespace fyber::test
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <array>
 #include <chrono>
 #include <cstdio>
@@ -9,9 +10,14 @@
 #include <memory>
 #include <stdexcept>
 #include <string>
-#include <thread>
+#include <string_view>
+#include <utility>
+#include <vector>
 
+#include "MockServer.h"
+#include "Report.h"
 #include "gtest/gtest.h"
+#include "rapidjson/document.h"
 
 namespace fyber::test {
 
@@ -24,8 +30,6 @@ inline const fs::path resources = base_path / "tests" / "resources";
 
 inline const fs::path bin_path = skad_updater_BIN;
 
-inline const string mockserver_addr = "localhost:5000";
-
 inline const string WelcomeToSkadMsg = string("*** Welcome to SKAd Updater ( version ") + skad_updater_VERSION + " )\n";
 
 std::string exec(const string& command)
@@ -80,28 +84,36 @@ bool log_starts_with(const string& str, const string& term)
   return starts_with(str, WelcomeToSkadMsg + term);
 }
 
-string set_mock_data(const string& data)
+MockServer& mock_server()
 {
-  auto cmd = "curl -X POST \"http://" + mockserver_addr + "/set_data\" -d '" + data +
-             "' -H \"Content-Type: application/json\"";
-  std::cout << "Modifing data with : " << cmd << std::endl;
-  auto res = ltrim(rtrim(exec(cmd)));
+  static MockServer server;
+  return server;
+}
 
-  return res;
+void set_mock_data(const string& data)
+{
+  std::cout << "Modifing data with : " << data << std::endl;
+  mock_server().set_data(data);
 }
 
 void with_mock_data(const string& data, const std::function<void(const string&)>& block)
 {
-  auto cmd = "curl -X GET \"http://" + mockserver_addr + "/get_data\"";
-  auto original_data = ltrim(rtrim(exec(cmd)));
+  auto original_data = mock_server().get_data();
   set_mock_data(data);
   block(data);
   set_mock_data(original_data);
 }
 
+void with_mock_faults(const Faults& faults, const std::function<void()>& block)
+{
+  mock_server().set_faults(faults);
+  block();
+  mock_server().set_faults(Faults());
+}
+
 string run_skad_updater(const string& param)
 {
-  auto cmd = "export FYBER_SKAD_NETWORKS_SERVER_HOST=http://" + mockserver_addr + ";" +
+  auto cmd = "export FYBER_SKAD_NETWORKS_SERVER_HOST=" + mock_server().url() + ";" +
              (bin_path / "skad_updater").string() + " " + param;
   std::cout << "Running: " << cmd << std::endl;
   return exec(cmd);
@@ -112,41 +124,15 @@ class End2End : public ::testing::Test
  protected:
   // Per-test-suite set-up.
   // Called before the first test in this test suite.
-  // Can be omitted if not needed.
   static void SetUpTestSuite()
   {
-    std::system((base_path / "tests" / "servermock" / "run_mock_server.sh &").c_str());
-    for (int i = 0; i < 5; ++i) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-      const string& check_server_status =
-          rtrim(ltrim(exec("curl -LI http://" + mockserver_addr + "/networks -o /dev/null -w '%{http_code}\\n' -s")));
-
-      std::cout << "Mock status = [" << check_server_status << "]" << std::endl;
-
-      if (check_server_status == "200") {
-        std::cout << "Mock Server Ready" << std::endl;
-        return;
-      }
-    }
+    mock_server().start();
+    std::cout << "Mock Server Ready at " << mock_server().url() << std::endl;
   }
 
   // Per-test-suite tear-down.
   // Called after the last test in this test suite.
-  // Can be omitted if not needed.
-  static void TearDownTestSuite()
-  {
-    auto shutdown = exec("curl -X GET \"" + mockserver_addr + "/shutdown\"");
-    std::cout << shutdown << std::endl;
-  }
-
-  //  // You can define per-test set-up logic as usual.
-  //  virtual void SetUp() { ... }
-  //
-  //  // You can define per-test tear-down logic as usual.
-  //  virtual void TearDown() { ... }
-
-  // Some expensive resource shared by all tests.
-  //  static T* shared_resource_;
+  static void TearDownTestSuite() { mock_server().stop(); }
 };
 
 TEST_F(End2End, Help)
@@ -213,6 +199,37 @@ TEST_F(End2End, NetworkListNewNetworks)
                    .c_str());
 }
 
+TEST_F(End2End, NetworkListFileMergedWithNetworkList)
+{
+  auto expected = WelcomeToSkadMsg +
+                  "*** Existing SKAdNetworks: 4PFYVQ9L8R.skadnetwork, V72QYCH5UU.skadnetwork, YCLNXRL5PM.skadnetwork\n"
+                  "*** Fetching SKAdNetworks for: Applovin, AdColony, ChartboostSDK\n"
+                  "*** New SKAdNetworks: blskdfjl2e3.skadnetwork, ludvb6z3bs.skadnetwork\n"
+                  "*** Updating `" +
+                  resources.string() +
+                  "/Info.plist`\n"
+                  "*** These network IDs will be added: blskdfjl2e3.skadnetwork, ludvb6z3bs.skadnetwork\n";
+
+  auto result = run_skad_updater("--plist_file_path " + (resources / "Info.plist").string() +
+                                 " --network_list=' Applovin,AdColony,,Applovin'"
+                                 " --network_list_file=" +
+                                 (resources / "networks.list").string() + " --dry_run");
+  ASSERT_STREQ(result.c_str(), expected.c_str());
+
+  result = run_skad_updater("--plist_file_path " + (resources / "Info.plist").string() +
+                            " --network_list=Applovin,AdColony --network_list_file=- --dry_run < " +
+                            (resources / "networks.list").string());
+  ASSERT_STREQ(result.c_str(), expected.c_str());
+}
+
+TEST_F(End2End, NetworkListFileNotExists)
+{
+  auto result = run_skad_updater("--plist_file_path " + (resources / "Info.plist").string() +
+                                 " --network_list_file=" + (resources / "ImNotExisting").string() + " --dry_run");
+  ASSERT_STREQ(result.c_str(),
+               (WelcomeToSkadMsg + "*** Provided network_list_file is invalid : -does not exist-\n").c_str());
+}
+
 TEST_F(End2End, PodFileNewNetworks)
 {
   auto result = run_skad_updater("--plist_file_path " + (resources / "Info.plist").string() +
@@ -576,6 +593,572 @@ TEST_F(End2End, NoDryRunMultiBackup)
   });
 }
 
+TEST_F(End2End, RequestsIssued)
+{
+  mock_server().reset_requests();
+
+  run_skad_updater("--plist_file_path " + (resources / "Info.plist").string() +
+                   " --pod_file_path=" + (resources / "Podfile").string() + " --dry_run");
+
+  ASSERT_EQ(mock_server().requests("/networks"), 1);
+  ASSERT_EQ(mock_server().requests("/plist"), 1);
+  ASSERT_EQ(mock_server().requests(), 2);
+}
+
+TEST_F(End2End, ServerErrorBurst)
+{
+  Faults faults;
+  faults.error_burst = 1;
+
+  with_mock_faults(faults, [] {
+    auto result = run_skad_updater("--show_networks");
+    ASSERT_STREQ(result.c_str(), (WelcomeToSkadMsg + "*** Connection to '" + mock_server().url() +
+                                  "/networks' failed (HTTP/1.1 503 Service Unavailable) : Injected failure\n")
+                                     .c_str());
+
+    result = run_skad_updater("--show_networks");
+    ASSERT_STREQ(result.c_str(),
+                 (WelcomeToSkadMsg +
+                  "Supported network names: AdColony,Google-Mobile-Ads-SDK,ChartboostSDK,Applovin,Unknown_network\n")
+                     .c_str());
+  });
+}
+
+TEST_F(End2End, DroppedConnection)
+{
+  Faults faults;
+  faults.drop_connections = 1;
+
+  with_mock_faults(faults, [] {
+    auto result = run_skad_updater("--show_networks");
+    EXPECT_PRED2(log_starts_with, result, "*** API failure for '" + mock_server().url() + "/networks': ");
+  });
+}
+
+TEST_F(End2End, InjectedLatencyAndBandwidth)
+{
+  Faults faults;
+  faults.latency = std::chrono::milliseconds(200);
+  faults.bandwidth_bytes_per_sec = 1000;
+
+  with_mock_faults(faults, [] {
+    auto start = std::chrono::steady_clock::now();
+    auto result = run_skad_updater("--show_networks");
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    ASSERT_STREQ(result.c_str(),
+                 (WelcomeToSkadMsg +
+                  "Supported network names: AdColony,Google-Mobile-Ads-SDK,ChartboostSDK,Applovin,Unknown_network\n")
+                     .c_str());
+    // 200ms latency + ~100 bytes at 10 bytes per 10ms slice
+    ASSERT_GE(elapsed, std::chrono::milliseconds(250));
+  });
+}
+
+TEST_F(End2End, ShardedBatchReportsMerge)
+{
+  const auto work_dir = fs::temp_directory_path() / ("skad_batch_" + std::to_string(mock_server().port()));
+  fs::remove_all(work_dir);
+
+  // New IDs, up to date, and no supported networks
+  const std::vector<std::pair<string, string>> apps = {
+      {"app1", "pod 'AdColony'\npod 'ChartboostSDK'\npod 'Google-Mobile-Ads-SDK'\n"},
+      {"app2", "pod 'AdColony'\n"},
+      {"app3", "pod 'NotANetwork'\n"}};
+
+  string batch = "# plist\tpodfile\n";
+  for (const auto& [name, podfile] : apps) {
+    fs::create_directories(work_dir / name);
+    fs::copy_file(resources / "Info.plist", work_dir / name / "Info.plist");
+    std::ofstream(work_dir / name / "Podfile") << podfile;
+    batch += (work_dir / name / "Info.plist").string() + "\t" + (work_dir / name / "Podfile").string() + "\n";
+  }
+  std::ofstream(work_dir / "batch.list") << batch;
+
+  const auto shard1 = (work_dir / "shard1.json").string();
+  const auto shard2 = (work_dir / "shard2.json").string();
+  const auto merged = (work_dir / "merged.json").string();
+
+  run_skad_updater("--batch_file " + (work_dir / "batch.list").string() + " --shard 1/2 --shard_report " + shard1);
+  run_skad_updater("--batch_file " + (work_dir / "batch.list").string() + " --shard 2/2 --shard_report " + shard2);
+
+  auto shard1_report = Report::read(shard1);
+  auto shard2_report = Report::read(shard2);
+  ASSERT_EQ(shard1_report.projects().size() + shard2_report.projects().size(), 3);
+
+  auto result = run_skad_updater("merge-reports --output " + merged + " " + shard2 + " " + shard1);
+  ASSERT_STREQ(result.c_str(), (WelcomeToSkadMsg +
+                                "*** Merged 2 reports, 3 plists: 1 updated, 1 unchanged, 1 failed\n"
+                                "*** IDs added: ChartboostSDK: 1, Google-Mobile-Ads-SDK: 1\n"
+                                "*** Report written to `" +
+                                merged + "`\n")
+                                   .c_str());
+
+  auto report = Report::read(merged);
+  ASSERT_EQ(report.shards().size(), 2);
+  ASSERT_EQ(report.shards()[0].to_string(), "1/2");
+  ASSERT_EQ(report.shards()[1].to_string(), "2/2");
+  ASSERT_EQ(report.projects().size(), 3);
+
+  for (const auto& project : report.projects()) {
+    if (project.status == UpdateResult::Status::Failed) {
+      ASSERT_EQ(project.plist_file_path, (work_dir / "app3" / "Info.plist").string());
+      ASSERT_EQ(project.exit_code, 4);
+    }
+  }
+  ASSERT_NE(read_file(work_dir / "app1" / "Info.plist").find("cstr6suwn9.skadnetwork"), string::npos);
+
+  result = run_skad_updater("merge-reports --output " + merged + " " + shard1 + " " + shard1);
+  ASSERT_STREQ(result.c_str(), (WelcomeToSkadMsg + "*** Shard 1/2 is reported more than once\n").c_str());
+
+  fs::remove_all(work_dir);
+}
+
+TEST_F(End2End, ConcurrentRunsShareCachedResponses)
+{
+  const auto cache_dir = fs::temp_directory_path() / ("skad_cache_" + std::to_string(mock_server().port()));
+  fs::remove_all(cache_dir);
+  mock_server().reset_requests();
+
+  Faults faults;
+  faults.latency = std::chrono::milliseconds(300);
+
+  with_mock_faults(faults, [&] {
+    const auto run = (bin_path / "skad_updater").string() + " --cache_dir " + cache_dir.string() +
+                     " --network_list=Applovin --dry_run --plist_file_path ";
+
+    // Both runs miss the cache at once, the second one waits for the response fetched by the first
+    exec("export FYBER_SKAD_NETWORKS_SERVER_HOST=" + mock_server().url() + "; " + run +
+         (resources / "Info.plist").string() + " > /dev/null & " + run + (resources / "simple.Info.plist").string() +
+         " > /dev/null; wait");
+  });
+
+  ASSERT_EQ(mock_server().requests("/plist"), 1);
+
+  // Reused by later runs too
+  auto result = run_skad_updater("--cache_dir " + cache_dir.string() + " --plist_file_path " +
+                                 (resources / "Info.plist").string() + " --network_list=Applovin --dry_run");
+  ASSERT_PRED2(log_starts_with, result, "Existing SKAdNetworks: ");
+  ASSERT_EQ(mock_server().requests("/plist"), 1);
+
+  fs::remove_all(cache_dir);
+}
+
+TEST_F(End2End, ConcurrentUpdatesOfOnePlistAreSerialized)
+{
+  const auto work_dir = fs::temp_directory_path() / ("skad_lock_" + std::to_string(mock_server().port()));
+  fs::remove_all(work_dir);
+  fs::create_directories(work_dir);
+  fs::copy_file(resources / "empty.Info.plist", work_dir / "Info.plist");
+
+  Faults faults;
+  faults.latency = std::chrono::milliseconds(300);
+
+  with_mock_faults(faults, [&] {
+    const auto run = (bin_path / "skad_updater").string() + " --plist_file_path " + (work_dir / "Info.plist").string();
+
+    exec("export FYBER_SKAD_NETWORKS_SERVER_HOST=" + mock_server().url() + "; " + run +
+         " --network_list=AdColony > /dev/null & " + run + " --network_list=Applovin > /dev/null; wait");
+  });
+
+  // Neither update is lost, and each one made its own backup
+  auto plist = read_file(work_dir / "Info.plist");
+  ASSERT_NE(plist.find("4PFYVQ9L8R.skadnetwork"), string::npos);
+  ASSERT_NE(plist.find("YCLNXRL5PM.skadnetwork"), string::npos);
+  ASSERT_NE(plist.find("ludvb6z3bs.skadnetwork"), string::npos);
+  ASSERT_TRUE(fs::exists(work_dir / "Info.plist.bak.1"));
+  ASSERT_TRUE(fs::exists(work_dir / "Info.plist.bak.2"));
+
+  fs::remove_all(work_dir);
+}
+
+TEST_F(End2End, MetricsFileMergesRuns)
+{
+  const auto metrics_file =
+      fs::temp_directory_path() / ("skad_metrics_" + std::to_string(mock_server().port()) + ".prom");
+  fs::remove(metrics_file);
+
+  run_skad_updater("--metrics_file " + metrics_file.string() + " --plist_file_path " +
+                   (resources / "Info.plist").string() + " --network_list=Applovin --dry_run");
+  run_skad_updater("--metrics_file=" + metrics_file.string() + " --plist_file_path " +
+                   (resources / "nonexistent.Info.plist").string() + " --network_list=Applovin");
+
+  auto metrics = read_file(metrics_file.string());
+
+  ASSERT_NE(metrics.find("skad_updater_run_seconds_count 2\n"), std::string::npos) << metrics;
+  ASSERT_NE(metrics.find("skad_updater_exits_total{reason=\"Success\"} 1\n"), std::string::npos) << metrics;
+  ASSERT_NE(metrics.find("skad_updater_exits_total{reason=\"NotAFile\"} 1\n"), std::string::npos) << metrics;
+  ASSERT_NE(metrics.find("skad_updater_plists_total{status=\"failed\"} 1\n"), std::string::npos) << metrics;
+  ASSERT_NE(metrics.find("skad_updater_http_request_seconds_count{endpoint=\"/plist\"} 1\n"), std::string::npos)
+      << metrics;
+  ASSERT_NE(metrics.find("skad_updater_plist_seconds_count{phase=\"parse\"} 1\n"), std::string::npos) << metrics;
+  ASSERT_EQ(metrics.substr(metrics.size() - 6), "# EOF\n");
+
+  fs::remove(metrics_file);
+}
+
+TEST_F(End2End, ReportOnStdout)
+{
+  auto line = run_skad_updater("--report jsonl --plist_file_path " + (resources / "Info.plist").string() +
+                               " --network_list=Applovin --dry_run");
+
+  rapidjson::Document project;
+  project.Parse(line.c_str());
+  ASSERT_FALSE(project.HasParseError()) << line;
+  ASSERT_EQ(std::count(line.begin(), line.end(), '\n'), 1) << line;
+
+  ASSERT_STREQ(project["plist_file_path"].GetString(), (resources / "Info.plist").c_str());
+  ASSERT_STREQ(project["status"].GetString(), "would_update");
+  ASSERT_EQ(project["exit_code"].GetInt(), 0);
+  ASSERT_TRUE(project["dry_run"].GetBool());
+  ASSERT_EQ(project["existing"].Size(), 3u);
+  ASSERT_EQ(project["added"]["Applovin"].Size(), 1u);
+  ASSERT_STREQ(project["added"]["Applovin"][0u].GetString(), "ludvb6z3bs.skadnetwork");
+  ASSERT_STREQ(project["backup_path"].GetString(), "");
+  ASSERT_STREQ(project["cache"].GetString(), "server");
+  ASSERT_GE(project["timings"]["total"].GetDouble(), project["timings"]["fetch"].GetDouble());
+
+  auto document = run_skad_updater("--report json --network_list=Applovin --plist_file_path " +
+                                   (resources / "nonexistent.Info.plist").string());
+
+  rapidjson::Document report;
+  report.Parse(document.c_str());
+  ASSERT_FALSE(report.HasParseError()) << document;
+  ASSERT_EQ(report["summary"]["failed"].GetInt(), 1);
+  ASSERT_STREQ(report["projects"][0u]["status"].GetString(), "failed");
+  ASSERT_EQ(report["projects"][0u]["exit_code"].GetInt(), 9);
+}
+
+TEST_F(End2End, PlistStreamedFromStdinToStdout)
+{
+  const auto plist_path = (resources / "Info.plist").string();
+  const auto run = "export FYBER_SKAD_NETWORKS_SERVER_HOST=" + mock_server().url() + "; cat " + plist_path + " | " +
+                   (bin_path / "skad_updater").string() + " --plist_file_path - --output - ";
+
+  auto updated = exec(run + "--network_list=Applovin 2> /dev/null");
+  ASSERT_PRED2(starts_with, updated, "<?xml");
+  ASSERT_NE(updated.find("<string>ludvb6z3bs.skadnetwork</string>"), string::npos) << updated;
+  ASSERT_EQ(updated.find("***"), string::npos) << updated;
+
+  // Passed through unchanged when there's nothing to add
+  std::ifstream original(plist_path, std::ios::binary);
+  ASSERT_EQ(exec(run + "--network_list=AdColony 2> /dev/null"),
+            string(std::istreambuf_iterator<char>(original), std::istreambuf_iterator<char>()));
+
+  // Not updated in place, as there's no file
+  auto result = exec(run.substr(0, run.find("--output")) + "--network_list=Applovin");
+  ASSERT_PRED2(log_starts_with, result, "*** `output` is required when the plist is read from a stream");
+}
+
+TEST_F(End2End, PodFileFromPipe)
+{
+  const auto args = " --plist_file_path " + (resources / "Info.plist").string() + " --dry_run";
+
+  auto from_file = run_skad_updater("--pod_file_path " + (resources / "Podfile").string() + args);
+  auto from_pipe = exec("export FYBER_SKAD_NETWORKS_SERVER_HOST=" + mock_server().url() + "; cat " +
+                        (resources / "Podfile").string() + " | " + (bin_path / "skad_updater").string() +
+                        " --pod_file_path -" + args);
+
+  ASSERT_EQ(from_pipe, from_file);
+}
+
+TEST_F(End2End, PodFileTarget)
+{
+  const auto args = "--plist_file_path " + (resources / "Info.plist").string() +
+                    " --pod_file_path=" + (resources / "targets.Podfile").string() + " --dry_run --pod_target ";
+  const auto existing =
+      WelcomeToSkadMsg +
+      "*** Existing SKAdNetworks: 4PFYVQ9L8R.skadnetwork, V72QYCH5UU.skadnetwork, YCLNXRL5PM.skadnetwork\n";
+
+  // Through a helper, and a helper calling another one
+  ASSERT_STREQ(run_skad_updater(args + "Free").c_str(),
+               (existing +
+                "*** Fetching SKAdNetworks for: AdColony, ChartboostSDK\n"
+                "*** New SKAdNetworks: blskdfjl2e3.skadnetwork\n"
+                "*** Updating `" +
+                resources.string() +
+                "/Info.plist`\n"
+                "*** These network IDs will be added: blskdfjl2e3.skadnetwork\n")
+                   .c_str());
+  EXPECT_PRED2(starts_with, run_skad_updater(args + "Paid"),
+               existing + "*** Fetching SKAdNetworks for: AdColony, ChartboostSDK, Google-Mobile-Ads-SDK\n");
+
+  // Named through an `each` loop
+  EXPECT_PRED2(starts_with, run_skad_updater(args + "ToolsTests"),
+               existing + "*** Fetching SKAdNetworks for: Applovin\n");
+
+  // `inherit! :search_paths` doesn't get the pods of the enclosing target
+  ASSERT_STREQ(run_skad_updater(args + "FreeTests").c_str(),
+               (existing + "*** No supported networks found for the target `FreeTests` of your Podfile\n").c_str());
+
+  ASSERT_STREQ(
+      run_skad_updater(args + "Unknown").c_str(),
+      (existing + "*** Target `Unknown` not found in the podfile. Targets: Free, FreeTests, Paid, Tools, ToolsTests\n")
+          .c_str());
+}
+
+TEST_F(End2End, OfflineEmbeddedCatalog)
+{
+  mock_server().reset_requests();
+
+  auto result = run_skad_updater("--show_networks --offline");
+  ASSERT_STREQ(result.c_str(),
+               (WelcomeToSkadMsg + "Supported network names: AdColony,AppLovinSDK,ChartboostSDK,FBAudienceNetwork,"
+                                   "Google-Mobile-Ads-SDK,InMobiSDK,IronSourceSDK,UnityAds,VungleSDK\n")
+                   .c_str());
+
+  result = run_skad_updater("--plist_file_path " + (resources / "Info.plist").string() +
+                            " --network_list Google-Mobile-Ads-SDK,Unknown_network --dry_run --offline");
+  ASSERT_STREQ(result.c_str(),
+               (WelcomeToSkadMsg +
+                "*** Existing SKAdNetworks: 4PFYVQ9L8R.skadnetwork, V72QYCH5UU.skadnetwork, YCLNXRL5PM.skadnetwork\n"
+                "*** Fetching SKAdNetworks for: Google-Mobile-Ads-SDK, Unknown_network\n"
+                "*** New SKAdNetworks: cstr6suwn9.skadnetwork\n"
+                "*** Updating `" +
+                resources.string() +
+                "/Info.plist`\n"
+                "*** These network IDs will be added: cstr6suwn9.skadnetwork\n")
+                   .c_str());
+
+  ASSERT_EQ(mock_server().requests(), 0);
+}
+
+TEST_F(End2End, FallbackToEmbeddedCatalog)
+{
+  Faults faults;
+  faults.error_burst = 1;
+
+  with_mock_faults(faults, [] {
+    auto result = run_skad_updater("--plist_file_path " + (resources / "Info.plist").string() +
+                                   " --network_list Google-Mobile-Ads-SDK --dry_run --fallback_catalog");
+
+    // Logged while the plist is parsed
+    const string fallback = "*** Using the embedded catalog: Connection to '" + mock_server().url() +
+                            "/plist' failed (HTTP/1.1 503 Service Unavailable) : Injected failure\n";
+    auto found = result.find(fallback);
+    ASSERT_NE(found, string::npos) << result;
+    result.erase(found, fallback.size());
+
+    ASSERT_STREQ(result.c_str(),
+                 (WelcomeToSkadMsg +
+                  "*** Existing SKAdNetworks: 4PFYVQ9L8R.skadnetwork, V72QYCH5UU.skadnetwork, YCLNXRL5PM.skadnetwork\n"
+                  "*** Fetching SKAdNetworks for: Google-Mobile-Ads-SDK\n"
+                  "*** New SKAdNetworks: cstr6suwn9.skadnetwork\n"
+                  "*** Updating `" +
+                  resources.string() +
+                  "/Info.plist`\n"
+                  "*** These network IDs will be added: cstr6suwn9.skadnetwork\n")
+                     .c_str());
+  });
+}
+
+TEST_F(End2End, RetryAfterThrottling)
+{
+  Faults faults;
+  faults.error_burst = 2;
+  faults.error_status = 429;
+  faults.retry_after = 1;
+
+  const auto metrics_file =
+      fs::temp_directory_path() / ("skad_throttle_" + std::to_string(mock_server().port()) + ".prom");
+  fs::remove(metrics_file);
+  mock_server().reset_requests();
+
+  with_mock_faults(faults, [&metrics_file] {
+    auto start = std::chrono::steady_clock::now();
+    auto result = run_skad_updater("--show_networks --metrics_file " + metrics_file.string());
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    ASSERT_TRUE(log_starts_with(result, "*** " + mock_server().url() +
+                                            "/networks is throttling (HTTP/1.1 429 Too Many Requests), retrying in "
+                                            "1000ms\n"))
+        << result;
+    ASSERT_NE(result.find("Unknown_network"), string::npos) << result;
+    ASSERT_GE(elapsed, std::chrono::seconds(2));
+    ASSERT_EQ(mock_server().requests("/networks"), 3);
+  });
+
+  auto metrics = read_file(metrics_file.string());
+  ASSERT_NE(metrics.find("skad_updater_http_retries_total 2\n"), string::npos) << metrics;
+  ASSERT_NE(metrics.find("skad_updater_throttle_seconds_count{reason=\"retry_after\"} 2\n"), string::npos) << metrics;
+
+  fs::remove(metrics_file);
+}
+
+TEST_F(End2End, Limits)
+{
+  const auto plist = " --plist_file_path " + (resources / "Info.plist").string();
+  const auto podfile = " --pod_file_path " + (resources / "Podfile").string();
+
+  // The output of the run, and its exit code on the last line
+  auto run = [](const string& param) { return run_skad_updater(param + "; echo \"exit code $?\""); };
+  auto ends_with = [](const string& str, const string& term) {
+    return str.size() >= term.size() and str.compare(str.size() - term.size(), term.size(), term) == 0;
+  };
+
+  auto result = run("--max_plist_size 1K --network_list AdColony --dry_run" + plist);
+  ASSERT_NE(result.find("Info.plist` is larger than 1024 bytes (see `max_plist_size`)"), string::npos) << result;
+  ASSERT_TRUE(ends_with(result, "exit code 10\n")) << result;
+
+  result = run("--max_plist_size 4K --max_podfile_size 100 --dry_run" + plist + podfile);
+  ASSERT_NE(result.find("Podfile` is larger than 100 bytes (see `max_podfile_size`)"), string::npos) << result;
+  ASSERT_TRUE(ends_with(result, "exit code 11\n")) << result;
+
+  result = run("--max_response_size 16 --network_list AdColony --dry_run" + plist);
+  ASSERT_NE(result.find("/plist' is larger than 16 bytes (see `max_response_size`)"), string::npos) << result;
+  ASSERT_TRUE(ends_with(result, "exit code 12\n")) << result;
+
+  result = run("--max_xml_depth 3 --network_list AdColony --dry_run" + plist);
+  ASSERT_NE(result.find("Info.plist` nests elements deeper than 3 levels (see `max_xml_depth`)"), string::npos)
+      << result;
+  ASSERT_TRUE(ends_with(result, "exit code 14\n")) << result;
+
+  result = run("--max_ids_per_network 1 --network_list AdColony --dry_run" + plist);
+  ASSERT_NE(result.find("The service returned 2 IDs for AdColony, more than 1 (see `max_ids_per_network`)"),
+            string::npos)
+      << result;
+  ASSERT_TRUE(ends_with(result, "exit code 15\n")) << result;
+
+  Faults faults;
+  faults.latency = std::chrono::milliseconds(2000);
+  with_mock_faults(faults, [&] {
+    auto start = std::chrono::steady_clock::now();
+    auto result = run("--phase_deadline 1 --network_list AdColony --dry_run" + plist);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    ASSERT_NE(result.find("Deadline exceeded waiting for the service, after 1s (see `phase_deadline`)"), string::npos)
+        << result;
+    ASSERT_TRUE(ends_with(result, "exit code 16\n")) << result;
+    ASSERT_LT(elapsed, std::chrono::milliseconds(1900));
+  });
+
+  // Within the limits
+  result =
+      run("--max_plist_size 4K --max_podfile_size 4K --max_response_size 1K --max_xml_depth 5 "
+          "--max_ids_per_network 2 --phase_deadline 10 --dry_run" +
+          plist + podfile);
+  ASSERT_TRUE(ends_with(result, "exit code 0\n")) << result;
+
+  result = run("--max_plist_size 4X --network_list AdColony" + plist);
+  ASSERT_TRUE(ends_with(result, "exit code 1\n")) << result;
+}
+
+TEST_F(End2End, CompressedResponsesAndPostQueries)
+{
+  const auto metrics_file = fs::temp_directory_path() / ("skad_wire_" + std::to_string(mock_server().port()) + ".prom");
+  fs::remove(metrics_file);
+  const auto query = "--plist_file_path " + (resources / "Info.plist").string() +
+                     " --network_list=Applovin,AdColony,Applovin --dry_run --metrics_file " + metrics_file.string();
+  mock_server().reset_requests();
+
+  auto gzipped = run_skad_updater(query);
+  ASSERT_PRED2(log_starts_with, gzipped, "Existing SKAdNetworks: ");
+  ASSERT_EQ(mock_server().gzipped_responses(), 1);
+
+  // The mock rejects names that aren't sorted and unique
+  ASSERT_EQ(run_skad_updater(query + " --post_queries"), gzipped);
+  ASSERT_EQ(mock_server().requests("/plist"), 2);
+  ASSERT_EQ(mock_server().gzipped_responses(), 2);
+
+  ASSERT_EQ(run_skad_updater(query + " --no_compression"), gzipped);
+  ASSERT_EQ(mock_server().requests("/plist"), 3);
+  ASSERT_EQ(mock_server().gzipped_responses(), 2);
+
+  auto metrics = read_file(metrics_file.string());
+  ASSERT_NE(metrics.find("skad_updater_response_bytes_total{encoding=\"gzip\"} "), string::npos) << metrics;
+  ASSERT_NE(metrics.find("skad_updater_response_bytes_total{encoding=\"identity\"} "), string::npos) << metrics;
+
+  fs::remove(metrics_file);
+}
+
+TEST_F(End2End, CatalogSyncedByChanges)
+{
+  const auto cache_dir = fs::temp_directory_path() / ("skad_catalog_" + std::to_string(mock_server().port()));
+  fs::remove_all(cache_dir);
+  const auto query =
+      "--plist_file_path " + (resources / "Info.plist").string() + " --network_list=Applovin,AdColony --dry_run";
+  const auto synced = query + " --catalog_sync --cache_dir " + cache_dir.string();
+  mock_server().reset_requests();
+
+  // The whole catalog once, then the runs are answered from it
+  auto result = run_skad_updater(synced);
+  ASSERT_EQ(result, run_skad_updater(query));
+  ASSERT_EQ(run_skad_updater(synced), result);
+  ASSERT_EQ(mock_server().requests("/catalog"), 1);
+  ASSERT_EQ(mock_server().requests("/plist"), 1);
+  ASSERT_EQ(fs::file_size(cache_dir / "catalog.journal"), 0);
+
+  with_mock_data(
+      R"({"AdColony": ["4PFYVQ9L8R.skadnetwork", "changed.skadnetwork"], "Applovin": []})", [&](const string&) {
+        // Once stale, only the changes since its version are received and appended
+        fs::last_write_time(cache_dir / "catalog.journal", fs::file_time_type::clock::now() - std::chrono::hours(1));
+
+        auto changed = run_skad_updater(synced);
+        ASSERT_NE(changed, result);
+        ASSERT_EQ(changed, run_skad_updater(query));
+        ASSERT_EQ(mock_server().requests("/catalog"), 2);
+        ASSERT_GT(fs::file_size(cache_dir / "catalog.journal"), 0);
+      });
+
+  fs::remove_all(cache_dir);
+}
+
+TEST_F(End2End, PlistParsedWhileFetching)
+{
+  const auto trace_file = fs::temp_directory_path() / ("skad_trace_" + std::to_string(mock_server().port()) + ".json");
+  fs::remove(trace_file);
+
+  Faults faults;
+  faults.latency = std::chrono::milliseconds(300);
+
+  with_mock_faults(faults, [&trace_file] {
+    // The plist comes as late as the IDs
+    auto result = exec("export FYBER_SKAD_NETWORKS_SERVER_HOST=" + mock_server().url() + "; (sleep 0.3; cat " +
+                       (resources / "Info.plist").string() + ") | " + (bin_path / "skad_updater").string() +
+                       " --plist_file_path - --network_list Applovin --dry_run --trace_file " + trace_file.string());
+    ASSERT_PRED2(log_starts_with, result, "*** Existing SKAdNetworks: ");
+    ASSERT_NE(result.find("*** These network IDs will be added: ludvb6z3bs.skadnetwork\n"), string::npos) << result;
+  });
+
+  auto content = read_file(trace_file);
+  rapidjson::Document trace;
+  trace.Parse(content.c_str());
+  ASSERT_FALSE(trace.HasParseError()) << content;
+
+  auto span = [&trace](const char* name) -> const rapidjson::Value& {
+    for (const auto& event : trace["traceEvents"].GetArray()) {
+      if (std::string_view(event["name"].GetString()) == name) return event;
+    }
+    throw std::invalid_argument(string("No span ") + name);
+  };
+  const auto& parse = span("parse plist");
+  const auto& fetch = span("GET /plist");
+  ASSERT_NE(parse["tid"].GetUint64(), fetch["tid"].GetUint64()) << content;
+  ASSERT_LT(parse["ts"].GetInt64(), fetch["ts"].GetInt64() + fetch["dur"].GetInt64()) << content;
+  ASSERT_LT(fetch["ts"].GetInt64(), parse["ts"].GetInt64() + parse["dur"].GetInt64()) << content;
+  span("write plist");
+
+  fs::remove(trace_file);
+}
+
+TEST_F(End2End, MissingPlistFailsBeforeFetching)
+{
+  Faults faults;
+  faults.latency = std::chrono::seconds(5);
+  mock_server().reset_requests();
+
+  with_mock_faults(faults, [] {
+    auto start = std::chrono::steady_clock::now();
+    auto result = run_skad_updater("--plist_file_path " + (resources / "Missing.plist").string() +
+                                   " --network_list Applovin --dry_run");
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    ASSERT_PRED2(log_starts_with, result, "*** Provided plist_file_path is invalid : ");
+    ASSERT_LT(elapsed, std::chrono::seconds(2));
+    ASSERT_EQ(mock_server().requests(), 0);
+  });
+}
+
 }  // namespace fyber::test
 
 int main(int argc, char** argv)
@@ -0,0 +1,196 @@
+#include "Endpoints.h"
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <future>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ManagerApi.h"
+#include "Metrics.h"
+#include "MockServer.h"
+#include "exit_message.h"
+#include "gtest/gtest.h"
+
+namespace fyber::test {
+
+namespace fs = std::filesystem;
+using std::string;
+using std::vector;
+using namespace std::chrono_literals;
+
+TEST(Endpoints, ParsedInOrder)
+{
+  Endpoints endpoints(" http://a:1/, http://b:2,,http://a:1");
+  ASSERT_EQ(endpoints.urls(), (vector<string>{"http://a:1", "http://b:2"}));
+  ASSERT_EQ(endpoints.primary(), "http://a:1");
+  // Unmeasured, in the order given
+  ASSERT_EQ(endpoints.ranked(), endpoints.urls());
+
+  ASSERT_THROW(Endpoints(""), ExitMessage);
+  ASSERT_THROW(Endpoints(" , "), ExitMessage);
+}
+
+TEST(Endpoints, RankedByLatencyAndHealth)
+{
+  Endpoints endpoints("http://a,http://b,http://c");
+  ASSERT_FALSE(endpoints.measured_within(60s));
+
+  endpoints.record_latency("http://a", 100ms);
+  endpoints.record_latency("http://b", 20ms);
+  ASSERT_EQ(endpoints.ranked(), (vector<string>{"http://b", "http://a", "http://c"}));
+
+  endpoints.record_latency("http://c", 70ms);
+  ASSERT_TRUE(endpoints.measured_within(60s));
+  ASSERT_EQ(endpoints.ranked(), (vector<string>{"http://b", "http://c", "http://a"}));
+
+  // A single slow sample only weighs `smoothing` in the estimate: 0.3 * 150 + 0.7 * 20 < 70
+  endpoints.record_latency("http://b", 150ms);
+  ASSERT_EQ(endpoints.ranked(), (vector<string>{"http://b", "http://c", "http://a"}));
+  endpoints.record_latency("http://b", 150ms);
+  ASSERT_EQ(endpoints.ranked(), (vector<string>{"http://c", "http://b", "http://a"}));
+
+  // Last until it answers again
+  endpoints.record_failure("http://c");
+  std::this_thread::sleep_for(1ms);
+  endpoints.record_failure("http://b");
+  ASSERT_EQ(endpoints.ranked(), (vector<string>{"http://a", "http://c", "http://b"}));
+  endpoints.record_latency("http://c", 50ms);
+  ASSERT_EQ(endpoints.ranked(), (vector<string>{"http://c", "http://a", "http://b"}));
+}
+
+TEST(Endpoints, SharedThroughADirectory)
+{
+  const auto dir = fs::temp_directory_path() / ("skad_endpoints_" + std::to_string(::getpid()));
+  fs::remove_all(dir);
+
+  Endpoints first("http://a,http://b");
+  first.share_through(dir.string());
+  first.record_latency("http://a", 100ms);
+  first.record_latency("http://b", 10ms);
+
+  // Another list sharing an endpoint
+  Endpoints other("http://c,http://a");
+  other.share_through(dir.string());
+  ASSERT_EQ(other.ranked(), (vector<string>{"http://a", "http://c"}));
+  other.record_failure("http://a");
+
+  Endpoints later("http://a,http://b");
+  later.share_through(dir.string());
+  ASSERT_TRUE(later.measured_within(60s));
+  ASSERT_EQ(later.ranked(), (vector<string>{"http://b", "http://a"}));
+
+  fs::remove_all(dir);
+}
+
+/// Endpoints served by mock servers, each with its own latency
+class EndpointsTest : public ::testing::Test
+{
+ protected:
+  MockServer fast;
+  MockServer slow;
+  const vector<Symbol> networks = {Symbol("AdColony")};
+
+  void SetUp() override
+  {
+    fast.start();
+    slow.start();
+
+    Faults faults;
+    faults.latency = 100ms;
+    slow.set_faults(faults);
+  }
+};
+
+TEST_F(EndpointsTest, ProbedAndSentToTheFastest)
+{
+  ManagerApi api(slow.url() + "," + fast.url());
+  ASSERT_EQ(api.get_sk_ad_networks(networks).at(networks[0]).size(), 2);
+
+  // Both are probed at once, the request goes to the fastest
+  ASSERT_EQ(slow.requests("/networks"), 1);
+  ASSERT_EQ(fast.requests("/networks"), 1);
+  ASSERT_EQ(fast.requests("/plist"), 1);
+  ASSERT_EQ(slow.requests("/plist"), 0);
+}
+
+TEST_F(EndpointsTest, ProbesTimeOut)
+{
+  Faults faults;
+  faults.latency = ManagerApi::probe_timeout * 4;
+  slow.set_faults(faults);
+
+  Stopwatch stopwatch;
+  ManagerApi api(slow.url() + "," + fast.url());
+  ASSERT_EQ(api.get_networks().size(), 5);
+
+  ASSERT_LT(stopwatch.elapsed(), faults.latency);
+  ASSERT_EQ(fast.requests("/networks"), 2);
+}
+
+TEST_F(EndpointsTest, FailsOverWithinTheDeadline)
+{
+  const auto dir = fs::temp_directory_path() / ("skad_failover_" + std::to_string(fast.port()));
+  fs::remove_all(dir);
+
+  // The slow one is believed the fastest, so it isn't probed again
+  {
+    Endpoints known(slow.url() + "," + fast.url());
+    known.share_through(dir.string());
+    known.record_latency(slow.url(), 1ms);
+    known.record_latency(fast.url(), 50ms);
+  }
+
+  Faults faults;
+  faults.error_burst = 10;
+  slow.set_faults(faults);
+
+  ManagerApi api(slow.url() + "," + fast.url());
+  api.use_disk_cache(dir.string());
+  ASSERT_EQ(api.get_sk_ad_networks(networks).at(networks[0]).size(), 2);
+
+  ASSERT_EQ(slow.requests("/plist"), 1);
+  ASSERT_EQ(fast.requests("/plist"), 1);
+  ASSERT_EQ(slow.requests("/networks") + fast.requests("/networks"), 0);
+
+  // Ranked last by the next runs
+  Endpoints later(slow.url() + "," + fast.url());
+  later.share_through(dir.string());
+  ASSERT_EQ(later.ranked(), (vector<string>{fast.url(), slow.url()}));
+
+  // Unless every endpoint fails
+  fast.set_faults(faults);
+  ASSERT_THROW(ManagerApi(slow.url() + "," + fast.url()).get_networks(), ExitMessage);
+
+  fs::remove_all(dir);
+}
+
+TEST_F(EndpointsTest, ConcurrentFetchesOverlap)
+{
+  Faults faults;
+  faults.latency = 300ms;
+  fast.set_faults(faults);
+
+  ManagerApi api(fast.url());
+  const vector<vector<Symbol>> requested = {{Symbol("AdColony")}, {Symbol("Applovin")}, {Symbol("AdColony")}};
+
+  Stopwatch stopwatch;
+  vector<std::future<std::map<Symbol, vector<Symbol>>>> fetches;
+  for (const auto& networks : requested) {
+    std::promise<vector<Symbol>> resolved;
+    resolved.set_value(networks);
+    fetches.push_back(api.get_sk_ad_networks_async(resolved.get_future().share()));
+  }
+  for (size_t i = 0; i < fetches.size(); ++i) {
+    ASSERT_FALSE(fetches[i].get().at(requested[i][0]).empty()) << i;
+  }
+
+  // Different networks are fetched at once, the same ones a single time
+  ASSERT_LT(stopwatch.elapsed(), faults.latency * 2);
+  ASSERT_EQ(fast.requests("/plist"), 2);
+}
+
+}  // namespace fyber::test
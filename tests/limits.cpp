@@ -0,0 +1,83 @@
+#include "Limits.h"
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include "exit_message.h"
+#include "gtest/gtest.h"
+
+namespace fyber::test {
+
+using std::string;
+
+TEST(Limits, XmlDepth)
+{
+  ASSERT_EQ(Limits::xml_depth(""), 0);
+  ASSERT_EQ(Limits::xml_depth("<plist/>"), 1);
+  ASSERT_EQ(Limits::xml_depth("<plist><dict><key>a</key><true/></dict></plist>"), 3);
+  ASSERT_EQ(Limits::xml_depth(R"(<?xml version="1.0"?>
+<!DOCTYPE plist PUBLIC "-//Apple//DTD PLIST 1.0//EN" "http://www.apple.com/DTDs/PropertyList-1.0.dtd">
+<plist version="1.0"><dict><!-- <a><b><c> --><string><![CDATA[<a><b><c>]]></string></dict></plist>)"),
+            3);
+  ASSERT_EQ(Limits::xml_depth(R"(<!DOCTYPE a [<!ELEMENT a ANY>]><a b="<c>"><d e='/>'/></a>)"), 2);
+
+  // Unclosed elements still count
+  string deep;
+  for (int i = 0; i < 1000; ++i) deep += "<a>";
+  ASSERT_EQ(Limits::xml_depth(deep), 1000);
+}
+
+TEST(Limits, ParseSize)
+{
+  ASSERT_EQ(Limits::parse_size("size", "0"), 0);
+  ASSERT_EQ(Limits::parse_size("size", "1500"), 1500);
+  ASSERT_EQ(Limits::parse_size("size", "4K"), 4096);
+  ASSERT_EQ(Limits::parse_size("size", "2M"), 2 * 1024 * 1024);
+  ASSERT_EQ(Limits::parse_size("size", "1G"), 1024 * 1024 * 1024);
+  ASSERT_EQ(Limits::parse_size("size", std::to_string(SIZE_MAX / (1024 * 1024 * 1024)) + "G"),
+            SIZE_MAX / (1024 * 1024 * 1024) * (1024 * 1024 * 1024));
+
+  for (const char* invalid : {"", "K", "-1", "1.5M", "4k", "12T", "99999999999999", "999999999999G", "17179869184G"}) {
+    ASSERT_THROW(Limits::parse_size("size", invalid), ExitMessage) << invalid;
+  }
+}
+
+TEST(Limits, BoundedStreambuf)
+{
+  std::istringstream source(string(100, 'x'));
+  BoundedStreambuf exact(source.rdbuf(), 100);
+  ASSERT_EQ(string(std::istreambuf_iterator<char>(&exact), std::istreambuf_iterator<char>()).size(), 100);
+  ASSERT_FALSE(exact.exceeded());
+
+  std::istringstream larger(string(101, 'x'));
+  BoundedStreambuf bounded(larger.rdbuf(), 100);
+  ASSERT_TRUE(string(std::istreambuf_iterator<char>(&bounded), std::istreambuf_iterator<char>()).empty());
+  ASSERT_TRUE(bounded.exceeded());
+
+  std::istringstream unlimited(string(200000, 'x'));
+  Deadline deadline("reading", std::chrono::seconds(0));
+  BoundedStreambuf unbounded(unlimited.rdbuf(), 0, &deadline);
+  ASSERT_EQ(string(std::istreambuf_iterator<char>(&unbounded), std::istreambuf_iterator<char>()).size(), 200000);
+  ASSERT_FALSE(unbounded.exceeded() or unbounded.expired());
+}
+
+TEST(Limits, Deadline)
+{
+  Deadline unlimited("testing", std::chrono::seconds(0));
+  ASSERT_FALSE(unlimited.expired());
+  ASSERT_EQ(unlimited.remaining().count(), 0);
+  ASSERT_NO_THROW(unlimited.check());
+
+  Deadline expired("testing", std::chrono::nanoseconds(1));
+  ASSERT_TRUE(expired.expired());
+  ASSERT_EQ(expired.remaining().count(), 1);
+  try {
+    expired.check();
+    FAIL();
+  } catch (const ExitMessage& exit) {
+    ASSERT_EQ(exit.code, ExitMessage::DeadlineExceeded("").code);
+  }
+}
+
+}  // namespace fyber::test
@@ -0,0 +1,144 @@
+#include <cpr/cpr.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ManagerApi.h"
+#include "Mirror.h"
+#include "MockServer.h"
+#include "exit_message.h"
+#include "gtest/gtest.h"
+
+namespace fyber::test {
+
+using std::string;
+using std::vector;
+
+/// A `Mirror` of the mock server, standing in for the service
+class MirrorTest : public ::testing::Test
+{
+ protected:
+  MockServer upstream;
+  std::unique_ptr<mirror::Mirror> mirror;
+
+  void SetUp() override
+  {
+    upstream.start();
+
+    mirror::MirrorOptions options;
+    options.upstream = upstream.url();
+    mirror = std::make_unique<mirror::Mirror>(options);
+    mirror->start();
+
+    upstream.reset_requests();
+  }
+};
+
+TEST_F(MirrorTest, ServesTheUpstreamCatalog)
+{
+  const vector<Symbol> networks = {Symbol("AdColony"), Symbol("Applovin"), Symbol("Unknown_network"),
+                                   Symbol("NotInTheCatalog")};
+
+  ManagerApi mirrored(mirror->url());
+  auto mirrored_networks = mirrored.get_networks();
+  auto mirrored_ids = mirrored.get_sk_ad_networks(networks);
+  // Served from the response serialized for the previous client
+  ASSERT_EQ(ManagerApi(mirror->url()).get_sk_ad_networks(networks), mirrored_ids);
+
+  ASSERT_EQ(upstream.requests(), 0);
+  ASSERT_EQ(mirror->requests(), 3);
+
+  ManagerApi direct(upstream.url());
+  ASSERT_EQ(mirrored_networks, direct.get_networks());
+  ASSERT_EQ(mirrored_ids, direct.get_sk_ad_networks(networks));
+}
+
+TEST_F(MirrorTest, RefreshesFromUpstream)
+{
+  const vector<Symbol> networks = {Symbol("AdColony")};
+  upstream.set_data(R"({"AdColony": ["refreshed.skadnetwork"]})");
+
+  ASSERT_EQ(ManagerApi(mirror->url()).get_sk_ad_networks(networks).at(networks[0]).size(), 2);
+
+  mirror->refresh();
+
+  ASSERT_EQ(ManagerApi(mirror->url()).get_sk_ad_networks(networks).at(networks[0]),
+            vector<Symbol>{Symbol("refreshed.skadnetwork")});
+  ASSERT_EQ(ManagerApi(mirror->url()).get_networks(), vector<Symbol>{Symbol("AdColony")});
+  ASSERT_EQ(mirror->refreshes(), 2);
+}
+
+TEST_F(MirrorTest, RefreshesByChanges)
+{
+  const vector<Symbol> networks = {Symbol("AdColony"), Symbol("Applovin")};
+  auto before = ManagerApi(mirror->url()).get_sk_ad_networks(networks);
+
+  mirror->refresh();
+  ASSERT_EQ(upstream.requests("/catalog"), 1);
+  ASSERT_EQ(ManagerApi(mirror->url()).get_sk_ad_networks(networks), before);
+
+  upstream.set_data(R"({"AdColony": ["4PFYVQ9L8R.skadnetwork"], "Applovin": ["ludvb6z3bs.skadnetwork"],)"
+                    R"("Unknown_network": [], "NewNetwork": ["new.skadnetwork"]})");
+  mirror->refresh();
+
+  ASSERT_EQ(upstream.requests("/catalog"), 2);
+  ASSERT_EQ(upstream.requests("/networks") + upstream.requests("/plist"), 0);
+  ASSERT_EQ(ManagerApi(mirror->url()).get_sk_ad_networks(networks).at(networks[0]),
+            vector<Symbol>{Symbol("4PFYVQ9L8R.skadnetwork")});
+  ASSERT_EQ(ManagerApi(mirror->url()).get_networks(),
+            (vector<Symbol>{Symbol("AdColony"), Symbol("Applovin"), Symbol("Unknown_network"), Symbol("NewNetwork")}));
+  ASSERT_EQ(mirror->refreshes(), 3);
+}
+
+TEST_F(MirrorTest, KeepsTheCatalogWhenUpstreamFails)
+{
+  Faults faults;
+  faults.error_burst = 1;
+  upstream.set_faults(faults);
+
+  ASSERT_THROW(mirror->refresh(), ExitMessage);
+
+  ASSERT_EQ(ManagerApi(mirror->url()).get_networks().size(), 5);
+  ASSERT_EQ(mirror->refreshes(), 1);
+}
+
+TEST_F(MirrorTest, GzippedOnRequest)
+{
+  auto plain = cpr::Get(cpr::Url{mirror->url() + "/plist"}, cpr::Parameters{{"network_list", "AdColony,Applovin"}});
+  auto gzipped = cpr::Get(cpr::Url{mirror->url() + "/plist"}, cpr::Parameters{{"network_list", "AdColony,Applovin"}},
+                          cpr::Header{{"Accept-Encoding", "gzip, deflate"}});
+
+  ASSERT_EQ(plain.status_code, 200);
+  ASSERT_EQ(
+      plain.text,
+      R"({"AdColony":["4PFYVQ9L8R.skadnetwork","YCLNXRL5PM.skadnetwork"],"Applovin":["ludvb6z3bs.skadnetwork"]})");
+  ASSERT_EQ(plain.header["Content-Encoding"], "");
+
+  ASSERT_EQ(gzipped.status_code, 200);
+  ASSERT_EQ(gzipped.header["Content-Encoding"], "gzip");
+  ASSERT_EQ(gzipped.text, mirror::Mirror::gzip(plain.text));
+}
+
+TEST_F(MirrorTest, PostQueries)
+{
+  const vector<Symbol> networks = {Symbol("Unknown_network"), Symbol("AdColony"), Symbol("AdColony")};
+
+  ManagerApi posting(mirror->url());
+  posting.use_post_queries(true);
+
+  ASSERT_EQ(posting.get_sk_ad_networks(networks), ManagerApi(mirror->url()).get_sk_ad_networks(networks));
+  ASSERT_EQ(
+      cpr::Post(cpr::Url{mirror->url() + "/plist"}, cpr::Body{"AdColony\nApplovin"}).text,
+      R"({"AdColony":["4PFYVQ9L8R.skadnetwork","YCLNXRL5PM.skadnetwork"],"Applovin":["ludvb6z3bs.skadnetwork"]})");
+  ASSERT_EQ(upstream.requests(), 0);
+}
+
+TEST_F(MirrorTest, UnknownRequests)
+{
+  ASSERT_EQ(cpr::Get(cpr::Url{mirror->url() + "/unknown"}).status_code, 404);
+  ASSERT_EQ(cpr::Get(cpr::Url{mirror->url() + "/plist"}).status_code, 400);
+  ASSERT_EQ(cpr::Post(cpr::Url{mirror->url() + "/networks"}).status_code, 405);
+}
+
+}  // namespace fyber::test
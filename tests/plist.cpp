@@ -0,0 +1,50 @@
+#include "Plist.h"
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <string>
+
+#include "exit_message.h"
+#include "gtest/gtest.h"
+
+namespace fyber::test {
+
+namespace fs = std::filesystem;
+using std::string;
+
+namespace {
+
+const fs::path resources = fs::current_path().parent_path().parent_path() / "tests" / "resources";
+
+}  // namespace
+
+TEST(Plist, FailedUpdateThrows)
+{
+  if (!fs::exists("/dev/full")) GTEST_SKIP() << "No /dev/full to fail the writes";
+
+  const auto dir = fs::temp_directory_path() / ("skad_plist_" + std::to_string(::getpid()));
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  const auto path = dir / "Info.plist";
+  fs::copy_file(resources / "Info.plist", path);
+
+  Plist plist(path.string());
+  ASSERT_TRUE(plist.set_sk_ad_network_items_for_update({{Symbol("Applovin"), {Symbol("ludvb6z3bs.skadnetwork")}}}));
+  plist.build_plist_SKAdNetworkItems();
+
+  // A full disk: every write to the plist fails
+  fs::remove(path);
+  fs::create_symlink("/dev/full", path);
+
+  try {
+    plist.update_file(false);
+    FAIL() << "The write didn't fail";
+  } catch (const ExitMessage& error) {
+    ASSERT_EQ(error.code, ExitMessage::NotAFile("").code) << error.what();
+  }
+
+  fs::remove_all(dir);
+}
+
+}  // namespace fyber::test
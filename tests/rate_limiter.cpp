@@ -0,0 +1,97 @@
+#include "RateLimiter.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+#include "exit_message.h"
+#include "gtest/gtest.h"
+
+namespace fyber::test {
+
+namespace fs = std::filesystem;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+TEST(RateLimiter, ParsesLimits)
+{
+  auto limit = RateLimit::parse("2.5");
+  ASSERT_EQ(limit.rate, 2.5);
+  ASSERT_EQ(limit.burst, 2.5);
+
+  limit = RateLimit::parse("10/3");
+  ASSERT_EQ(limit.rate, 10);
+  ASSERT_EQ(limit.burst, 3);
+
+  ASSERT_EQ(RateLimit::parse("0.2").burst, 1);
+
+  for (const char* invalid : {"", "fast", "0", "-1", "5/", "5/0.5", "5/2x"}) {
+    ASSERT_THROW(RateLimit::parse(invalid), ExitMessage) << invalid;
+  }
+}
+
+TEST(RateLimiter, PacesRequests)
+{
+  RateLimit limit;
+  limit.rate = 20;
+  limit.burst = 2;
+  RateLimiter limiter("pacing.test", limit);
+
+  auto start = steady_clock::now();
+  for (int i = 0; i < 6; ++i) limiter.acquire();
+
+  // The burst goes through at once, the 4 others are 50ms apart
+  ASSERT_GE(steady_clock::now() - start, milliseconds(190));
+}
+
+TEST(RateLimiter, CapsRequestsInFlight)
+{
+  RateLimit limit;
+  limit.max_in_flight = 2;
+  RateLimiter limiter("in_flight.test", limit);
+
+  std::atomic<int> in_flight{0};
+  std::atomic<int> most_in_flight{0};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([&] {
+      auto permit = limiter.acquire();
+      int now = ++in_flight;
+      for (int most = most_in_flight; now > most and !most_in_flight.compare_exchange_weak(most, now);) {
+      }
+      std::this_thread::sleep_for(milliseconds(20));
+      --in_flight;
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  ASSERT_EQ(most_in_flight, 2);
+}
+
+TEST(RateLimiter, SharesBackOffThroughDirectory)
+{
+  const auto dir = fs::temp_directory_path() / "skad_rate_limiter_test";
+  fs::remove_all(dir);
+
+  RateLimiter first("shared.test", RateLimit(), dir.string());
+  RateLimiter second("shared.test", RateLimit(), dir.string());
+
+  first.back_off(milliseconds(200));
+
+  auto start = steady_clock::now();
+  second.acquire();
+  ASSERT_GE(steady_clock::now() - start, milliseconds(150));
+
+  fs::remove_all(dir);
+}
+
+TEST(RateLimiter, HostOfUrl)
+{
+  ASSERT_EQ(RateLimiter::host_of("https://skadnetwork.example:8443/plist?network_list=a"), "skadnetwork.example:8443");
+  ASSERT_EQ(RateLimiter::host_of("http://127.0.0.1:8080"), "127.0.0.1:8080");
+  ASSERT_EQ(RateLimiter::host_of("localhost/networks"), "localhost");
+}
+
+}  // namespace fyber::test
@@ -0,0 +1,75 @@
+#include "Report.h"
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace fyber::test {
+
+namespace fs = std::filesystem;
+using std::string;
+using std::vector;
+
+TEST(Report, MergedAsWritten)
+{
+  const auto dir = fs::temp_directory_path() / ("skad_report_" + std::to_string(::getpid()));
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+
+  UpdateResult updated;
+  updated.plist_file_path = "App/Info.plist";
+  updated.status = UpdateResult::Status::Updated;
+  updated.existing = {Symbol("4PFYVQ9L8R.skadnetwork"), Symbol("YCLNXRL5PM.skadnetwork")};
+  updated.added = {{Symbol("Applovin"), {Symbol("ludvb6z3bs.skadnetwork")}}};
+  updated.backup_path = "App/Info.plist.bak.1";
+  updated.source = ResponseSource::DiskCache;
+  updated.timings = {0.0125, 0.25, 0.003, 0.2751};
+
+  UpdateResult dry_run = updated;
+  dry_run.plist_file_path = "Dry/Info.plist";
+  dry_run.status = UpdateResult::Status::WouldUpdate;
+  dry_run.dry_run = true;
+  dry_run.backup_path.clear();
+
+  UpdateResult failed;
+  failed.plist_file_path = "Other/Info.plist";
+  failed.status = UpdateResult::Status::Failed;
+  failed.exit_code = 9;
+  failed.error = "Provided plist_file_path is invalid";
+  failed.source = ResponseSource::Embedded;
+  failed.timings.total = 0.5;
+
+  vector<UpdateResult> projects = {updated, dry_run, failed};
+  vector<Report> read;
+  for (int index = 1; index <= 3; ++index) {
+    Report report(Shard{index, 3});
+    report.add(projects[index - 1]);
+
+    const auto path = (dir / ("shard" + std::to_string(index) + ".json")).string();
+    report.write(path);
+    read.push_back(Report::read(path));
+  }
+
+  auto merged = Report::merge(read);
+  ASSERT_EQ(merged.projects().size(), projects.size());
+  for (size_t i = 0; i < projects.size(); ++i) {
+    ASSERT_EQ(Report::to_json_line(merged.projects()[i]), Report::to_json_line(projects[i]));
+  }
+
+  // The dry run is counted apart, and adds no ID
+  auto summary = merged.summary();
+  ASSERT_EQ(summary.updated, 1);
+  ASSERT_EQ(summary.would_update, 1);
+  ASSERT_EQ(summary.unchanged, 0);
+  ASSERT_EQ(summary.failed, 1);
+  ASSERT_EQ(summary.ids_added, (std::map<Symbol, size_t>{{Symbol("Applovin"), 1}}));
+
+  fs::remove_all(dir);
+}
+
+}  // namespace fyber::test
@@ -0,0 +1,597 @@
+#include "MockServer.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+
+#include "rapidjson/document.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace fyber::test {
+
+const char* MockServer::default_data = R"({"AdColony": ["4PFYVQ9L8R.skadnetwork", "YCLNXRL5PM.skadnetwork"],)"
+                                       R"("Google-Mobile-Ads-SDK": ["cstr6suwn9.skadnetwork"],)"
+                                       R"("ChartboostSDK": ["blskdfjl2e3.skadnetwork"],)"
+                                       R"("Applovin": ["ludvb6z3bs.skadnetwork"],)"
+                                       R"("Unknown_network": []})";
+
+namespace {
+
+constexpr size_t max_request_size = 1 << 20;
+
+const char* reason_phrase(int status)
+{
+  switch (status) {
+    case 200:
+      return "OK";
+    case 400:
+      return "Bad Request";
+    case 404:
+      return "Not Found";
+    case 429:
+      return "Too Many Requests";
+    case 500:
+      return "Internal Server Error";
+    case 502:
+      return "Bad Gateway";
+    case 503:
+      return "Service Unavailable";
+    case 504:
+      return "Gateway Timeout";
+    default:
+      return "Unknown";
+  }
+}
+
+/// The decimal number at the start of [text] (after spaces), up to the end of the line, if it's one
+std::optional<uint64_t> parse_number(const string& text)
+{
+  size_t start = text.find_first_not_of(' ');
+  size_t end = std::min(text.find_first_of(" \r", start), text.size());
+  if (start == string::npos or start == end or end - start > 18) return std::nullopt;
+
+  uint64_t number = 0;
+  for (size_t i = start; i < end; ++i) {
+    if (!std::isdigit(static_cast<unsigned char>(text[i]))) return std::nullopt;
+    number = number * 10 + static_cast<uint64_t>(text[i] - '0');
+  }
+  return number;
+}
+
+bool send_all(int fd, const char* data, size_t size)
+{
+  while (size > 0) {
+    ssize_t sent = ::send(fd, data, size, MSG_NOSIGNAL);
+    if (sent <= 0) return false;
+    data += sent;
+    size -= static_cast<size_t>(sent);
+  }
+  return true;
+}
+
+string url_decode(const string& text)
+{
+  string decoded;
+  decoded.reserve(text.size());
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (text[i] == '%' and i + 2 < text.size() and std::isxdigit(text[i + 1]) and std::isxdigit(text[i + 2])) {
+      decoded += static_cast<char>(std::stoi(text.substr(i + 1, 2), nullptr, 16));
+      i += 2;
+    } else if (text[i] == '+') {
+      decoded += ' ';
+    } else {
+      decoded += text[i];
+    }
+  }
+  return decoded;
+}
+
+/// Get the value of [key] from a url query string
+string query_param(const string& query, const string& key)
+{
+  size_t start = 0;
+  while (start <= query.size()) {
+    size_t end = query.find('&', start);
+    if (end == string::npos) end = query.size();
+
+    const string pair = query.substr(start, end - start);
+    const size_t eq = pair.find('=');
+    if (url_decode(pair.substr(0, eq)) == key) {
+      return eq == string::npos ? "" : url_decode(pair.substr(eq + 1));
+    }
+    start = end + 1;
+  }
+  return "";
+}
+
+/// The `network_list` of a POST to `/plist`: sorted and unique names, one per line
+/// \throws invalid_argument for any other list
+string post_network_list(const string& body)
+{
+  vector<string> names;
+  size_t start = 0;
+  while (start <= body.size()) {
+    size_t end = std::min(body.find('\n', start), body.size());
+    names.push_back(body.substr(start, end - start));
+    start = end + 1;
+  }
+
+  if (std::adjacent_find(names.begin(), names.end(), std::greater_equal<>()) != names.end()) {
+    throw std::invalid_argument("The network names must be sorted and unique");
+  }
+
+  string network_list;
+  for (const auto& name : names) network_list += (network_list.empty() ? "" : ",") + name;
+  return network_list;
+}
+
+/// [data] gzipped
+string gzip(const string& data)
+{
+  z_stream stream{};
+  // 16 + the window bits, for a gzip header rather than a zlib one
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + 15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    throw std::runtime_error("MockServer: unable to initialize gzip");
+  }
+
+  string compressed(deflateBound(&stream, static_cast<uLong>(data.size())), '\0');
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.size());
+  stream.next_out = reinterpret_cast<Bytef*>(compressed.data());
+  stream.avail_out = static_cast<uInt>(compressed.size());
+
+  deflate(&stream, Z_FINISH);
+  compressed.resize(stream.total_out);
+  deflateEnd(&stream);
+  return compressed;
+}
+
+}  // namespace
+
+MockServer::MockServer(const string& data) : _catalog(parse_catalog(data))
+{
+  _history.emplace(_version, _catalog);
+}
+
+MockServer::~MockServer()
+{
+  stop();
+}
+
+void MockServer::start(uint16_t port)
+{
+  if (_running) return;
+
+  _listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (_listen_fd < 0) throw std::runtime_error("MockServer: socket() failed: " + string(std::strerror(errno)));
+
+  int reuse = 1;
+  ::setsockopt(_listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+
+  if (::bind(_listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 or ::listen(_listen_fd, 128) != 0) {
+    const string error = std::strerror(errno);
+    ::close(_listen_fd);
+    _listen_fd = -1;
+    throw std::runtime_error("MockServer: unable to listen on port " + std::to_string(port) + ": " + error);
+  }
+
+  socklen_t len = sizeof(addr);
+  ::getsockname(_listen_fd, reinterpret_cast<sockaddr*>(&addr), &len);
+  _port = ntohs(addr.sin_port);
+
+  _running = true;
+  _accept_thread = std::thread([this] { accept_loop(); });
+}
+
+void MockServer::stop()
+{
+  if (!_running.exchange(false)) return;
+
+  _accept_thread.join();
+  ::close(_listen_fd);
+  _listen_fd = -1;
+
+  // Idle clients would keep their connection blocked in recv() forever
+  std::unique_lock lock(_mutex);
+  for (int fd : _connections) ::shutdown(fd, SHUT_RDWR);
+  _connections_done.wait(lock, [this] { return _connections.empty(); });
+}
+
+string MockServer::address() const
+{
+  return "127.0.0.1:" + std::to_string(_port);
+}
+
+void MockServer::accept_loop()
+{
+  pollfd listener{_listen_fd, POLLIN, 0};
+
+  while (_running) {
+    if (::poll(&listener, 1, 20) <= 0) continue;
+
+    int fd = ::accept(_listen_fd, nullptr, nullptr);
+    if (fd < 0) continue;
+
+#ifdef SO_NOSIGPIPE
+    int no_sigpipe = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &no_sigpipe, sizeof(no_sigpipe));
+#endif
+
+    {
+      std::lock_guard lock(_mutex);
+      _connections.insert(fd);
+    }
+
+    std::thread([this, fd] {
+      handle_connection(fd);
+
+      // Closed under the lock, so that `stop` never shuts down a descriptor reused meanwhile
+      std::lock_guard lock(_mutex);
+      _connections.erase(fd);
+      ::close(fd);
+      _connections_done.notify_all();
+    }).detach();
+  }
+}
+
+void MockServer::handle_connection(int fd)
+{
+  string request;
+  char buffer[4096];
+  size_t header_end = string::npos;
+  size_t content_length = 0;
+  bool accepts_gzip = false;
+
+  while (true) {
+    if (header_end == string::npos) {
+      header_end = request.find("\r\n\r\n");
+      if (header_end != string::npos) {
+        string headers = request.substr(0, header_end);
+        std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+        auto pos = headers.find("content-length:");
+        if (pos != string::npos) {
+          auto length = parse_number(headers.substr(pos + 15, headers.find("\r\n", pos) - pos - 15));
+          if (!length.has_value() or length.value() > max_request_size) {
+            respond(fd, 400, "Invalid Content-Length", Faults());
+            return;
+          }
+          content_length = static_cast<size_t>(length.value());
+        }
+        pos = headers.find("accept-encoding:");
+        accepts_gzip =
+            pos != string::npos and headers.substr(pos, headers.find("\r\n", pos) - pos).find("gzip") != string::npos;
+      }
+    }
+    if (header_end != string::npos and request.size() >= header_end + 4 + content_length) break;
+    if (request.size() > max_request_size) return;
+
+    ssize_t received = ::recv(fd, buffer, sizeof(buffer), 0);
+    if (received <= 0) return;
+    request.append(buffer, static_cast<size_t>(received));
+  }
+
+  const string request_line = request.substr(0, request.find("\r\n"));
+  const size_t method_end = request_line.find(' ');
+  const size_t target_end = request_line.find(' ', method_end + 1);
+  const string method = request_line.substr(0, method_end);
+  const string target = request_line.substr(method_end + 1, target_end - method_end - 1);
+  const string body = request.substr(header_end + 4, content_length);
+
+  Faults faults;
+  bool drop = false;
+  bool fail = false;
+  {
+    std::lock_guard lock(_mutex);
+    _requests[target.substr(0, target.find('?'))]++;
+
+    if (_faults.drop_connections > 0) {
+      _faults.drop_connections--;
+      drop = true;
+    } else if (_faults.error_burst > 0) {
+      _faults.error_burst--;
+      fail = true;
+    }
+    faults = _faults;
+  }
+
+  if (drop) return;
+
+  if (fail) {
+    respond(fd, faults.error_status, "Injected failure", faults);
+    return;
+  }
+
+  int status = 200;
+  string response = route(method, target, body, status);
+
+  const bool gzip = accepts_gzip and status == 200;
+  if (gzip) {
+    std::lock_guard lock(_mutex);
+    _gzipped_responses++;
+  }
+  respond(fd, status, response, faults, gzip);
+}
+
+void MockServer::respond(int fd, int status, const string& plain_body, const Faults& faults, bool gzip) const
+{
+  if (faults.latency.count() > 0) std::this_thread::sleep_for(faults.latency);
+
+  const string body = gzip ? fyber::test::gzip(plain_body) : plain_body;
+
+  string head = "HTTP/1.1 " + std::to_string(status) + " " + reason_phrase(status) +
+                "\r\n"
+                "Content-Type: application/json\r\n";
+  if (status != 200 and faults.retry_after >= 0) head += "Retry-After: " + std::to_string(faults.retry_after) + "\r\n";
+  if (gzip) head += "Content-Encoding: gzip\r\n";
+  head += "Content-Length: " + std::to_string(body.size()) +
+          "\r\n"
+          "Connection: close\r\n\r\n";
+
+  if (!send_all(fd, head.data(), head.size())) return;
+
+  if (faults.bandwidth_bytes_per_sec == 0) {
+    send_all(fd, body.data(), body.size());
+    return;
+  }
+
+  // Send the body in 10ms slices to emulate a constrained link
+  const size_t slice = std::max<size_t>(1, faults.bandwidth_bytes_per_sec / 100);
+  for (size_t offset = 0; offset < body.size(); offset += slice) {
+    if (!send_all(fd, body.data() + offset, std::min(slice, body.size() - offset))) return;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+}
+
+string MockServer::route(const string& method, const string& target, const string& body, int& status)
+{
+  const size_t query_start = target.find('?');
+  const string path = target.substr(0, query_start);
+  const string query = query_start == string::npos ? "" : target.substr(query_start + 1);
+
+  try {
+    if (method == "GET" and path == "/networks") return networks_body();
+    if (method == "GET" and path == "/plist") return plist_body(query_param(query, "network_list"));
+    if (method == "POST" and path == "/plist") return plist_body(post_network_list(body));
+    if (method == "GET" and path == "/catalog") return catalog_body(query_param(query, "since"));
+    if (method == "GET" and path == "/get_data") return get_data();
+    if (method == "POST" and path == "/set_data") {
+      set_data(body);
+      return get_data();
+    }
+  } catch (std::exception& ex) {
+    status = 400;
+    return ex.what();
+  }
+
+  status = 404;
+  return "Not Found";
+}
+
+/// \code {"networks": [AdColony, Google-Mobile-Ads-SDK, AppLovinSDK, ... ]}
+string MockServer::networks_body() const
+{
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+  std::lock_guard lock(_mutex);
+  writer.StartObject();
+  writer.Key("networks");
+  writer.StartArray();
+  for (const auto& [network, ids] : _catalog) writer.String(network.c_str());
+  writer.EndArray();
+  writer.EndObject();
+
+  return buffer.GetString();
+}
+
+/// \code {"AdColony": ["4PFYVQ9L8R.skadnetwork", "YCLNXRL5PM.skadnetwork"], "Unknown_network": []}
+string MockServer::plist_body(const string& network_list) const
+{
+  Catalog requested;
+  {
+    std::lock_guard lock(_mutex);
+    size_t start = 0;
+    while (start <= network_list.size()) {
+      size_t end = std::min(network_list.find(',', start), network_list.size());
+      const string network = network_list.substr(start, end - start);
+
+      auto found = std::find_if(_catalog.begin(), _catalog.end(), [&](const auto& e) { return e.first == network; });
+      requested.emplace_back(network, found == _catalog.end() ? vector<string>() : found->second);
+      start = end + 1;
+    }
+  }
+  return serialize_catalog(requested);
+}
+
+/// The whole catalog, or the changes since a version still in the history:
+///\code
+/// {"version": 3, "networks": {"AdColony": ["4PFYVQ9L8R.skadnetwork"], "Unknown_network": []}}
+/// {"version": 3, "since": 2, "added": {"Applovin": ["ludvb6z3bs.skadnetwork"]}, "removed": {}, "removed_networks": []}
+string MockServer::catalog_body(const string& since) const
+{
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+  auto write_networks = [&writer](const Catalog& catalog) {
+    writer.StartObject();
+    for (const auto& [network, ids] : catalog) {
+      writer.Key(network.c_str());
+      writer.StartArray();
+      for (const auto& id : ids) writer.String(id.c_str());
+      writer.EndArray();
+    }
+    writer.EndObject();
+  };
+
+  std::lock_guard lock(_mutex);
+  writer.StartObject();
+  writer.Key("version");
+  writer.Uint64(_version);
+
+  auto since_version = parse_number(since);
+  if (!since.empty() and !since_version.has_value()) throw std::invalid_argument("Invalid since `" + since + "`");
+  auto previous = since.empty() ? _history.end() : _history.find(since_version.value());
+  if (previous == _history.end()) {
+    writer.Key("networks");
+    write_networks(_catalog);
+    writer.EndObject();
+    return buffer.GetString();
+  }
+
+  auto find = [](const Catalog& catalog, const string& network) {
+    return std::find_if(catalog.begin(), catalog.end(), [&](const auto& entry) { return entry.first == network; });
+  };
+  // IDs of [to] missing from [from]
+  auto missing = [](const vector<string>& to, const vector<string>& from) {
+    vector<string> ids;
+    for (const auto& id : to) {
+      if (std::find(from.begin(), from.end(), id) == from.end()) ids.push_back(id);
+    }
+    return ids;
+  };
+
+  const Catalog& old_catalog = previous->second;
+  Catalog added;
+  Catalog removed;
+  vector<string> removed_networks;
+  for (const auto& [network, ids] : _catalog) {
+    auto old_entry = find(old_catalog, network);
+    const vector<string> old_ids = old_entry == old_catalog.end() ? vector<string>() : old_entry->second;
+
+    auto new_ids = missing(ids, old_ids);
+    // A new network without IDs is still a change
+    if (!new_ids.empty() or old_entry == old_catalog.end()) added.emplace_back(network, new_ids);
+    auto gone_ids = missing(old_ids, ids);
+    if (!gone_ids.empty()) removed.emplace_back(network, gone_ids);
+  }
+  for (const auto& [network, ids] : old_catalog) {
+    if (find(_catalog, network) == _catalog.end()) removed_networks.push_back(network);
+  }
+
+  writer.Key("since");
+  writer.Uint64(previous->first);
+  writer.Key("added");
+  write_networks(added);
+  writer.Key("removed");
+  write_networks(removed);
+  writer.Key("removed_networks");
+  writer.StartArray();
+  for (const auto& network : removed_networks) writer.String(network.c_str());
+  writer.EndArray();
+  writer.EndObject();
+
+  return buffer.GetString();
+}
+
+void MockServer::set_data(const string& data)
+{
+  Catalog catalog = parse_catalog(data);
+
+  std::lock_guard lock(_mutex);
+  _catalog = std::move(catalog);
+  _history.emplace(++_version, _catalog);
+  while (_history.size() > max_history) _history.erase(_history.begin());
+}
+
+uint64_t MockServer::version() const
+{
+  std::lock_guard lock(_mutex);
+  return _version;
+}
+
+string MockServer::get_data() const
+{
+  std::lock_guard lock(_mutex);
+  return serialize_catalog(_catalog);
+}
+
+void MockServer::set_faults(const Faults& faults)
+{
+  std::lock_guard lock(_mutex);
+  _faults = faults;
+}
+
+size_t MockServer::requests(const string& endpoint) const
+{
+  std::lock_guard lock(_mutex);
+  if (!endpoint.empty()) {
+    auto found = _requests.find(endpoint);
+    return found == _requests.end() ? 0 : found->second;
+  }
+
+  size_t total = 0;
+  for (const auto& [path, count] : _requests) total += count;
+  return total;
+}
+
+size_t MockServer::gzipped_responses() const
+{
+  std::lock_guard lock(_mutex);
+  return _gzipped_responses;
+}
+
+void MockServer::reset_requests()
+{
+  std::lock_guard lock(_mutex);
+  _requests.clear();
+  _gzipped_responses = 0;
+}
+
+MockServer::Catalog MockServer::parse_catalog(const string& json)
+{
+  rapidjson::Document doc;
+  doc.Parse(json.c_str());
+
+  if (doc.HasParseError() or !doc.IsObject()) throw std::invalid_argument("MockServer: invalid catalog " + json);
+
+  Catalog catalog;
+  for (auto& network : doc.GetObject()) {
+    if (!network.value.IsArray()) throw std::invalid_argument("MockServer: invalid catalog " + json);
+
+    vector<string> ids;
+    for (auto& id : network.value.GetArray()) {
+      if (!id.IsString()) throw std::invalid_argument("MockServer: invalid catalog " + json);
+      ids.emplace_back(id.GetString());
+    }
+    catalog.emplace_back(network.name.GetString(), ids);
+  }
+  return catalog;
+}
+
+string MockServer::serialize_catalog(const Catalog& catalog)
+{
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+  writer.StartObject();
+  for (const auto& [network, ids] : catalog) {
+    writer.Key(network.c_str());
+    writer.StartArray();
+    for (const auto& id : ids) writer.String(id.c_str());
+    writer.EndArray();
+  }
+  writer.EndObject();
+
+  return buffer.GetString();
+}
+
+}  // namespace fyber::test
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace fyber::test {
+
+using std::string;
+using std::vector;
+
+/// Faults injected by the `MockServer` into its responses.
+struct Faults
+{
+  /// Delay applied before every response is sent
+  std::chrono::milliseconds latency{0};
+  /// Throttle response bodies to this many bytes per second (0 = unlimited)
+  size_t bandwidth_bytes_per_sec = 0;
+  /// Number of upcoming connections that are closed without a response
+  int drop_connections = 0;
+  /// Number of upcoming requests that are answered with [error_status]
+  int error_burst = 0;
+  /// The HTTP status used for [error_burst]
+  int error_status = 503;
+  /// The `Retry-After` seconds sent with [error_status] (none when negative)
+  int retry_after = -1;
+};
+
+/// An in-process HTTP mock of the SKAdNetwork manager service. <br/>
+/// Serves `/networks`, `/plist` (GET, or POST of the sorted and unique names, one per line), `/catalog` (whole, or
+/// `?since=<version>` for the changes since a recent version), `/set_data` and `/get_data` on an ephemeral port of the
+/// loopback interface, gzipped when the request accepts it. Every `set_data` is a new version of the catalog.
+class MockServer
+{
+ private:
+  using Catalog = vector<std::pair<string, vector<string>>>;
+
+  int _listen_fd = -1;
+  uint16_t _port = 0;
+  std::atomic<bool> _running{false};
+  std::thread _accept_thread;
+  /// The client sockets being served, guarded by `_mutex`
+  std::set<int> _connections;
+  std::condition_variable _connections_done;
+
+  /// Versions kept to serve the changes since them
+  static constexpr size_t max_history = 16;
+
+  mutable std::mutex _mutex;
+  Catalog _catalog;
+  uint64_t _version = 1;
+  std::map<uint64_t, Catalog> _history;
+  Faults _faults;
+  std::map<string, size_t> _requests;
+  size_t _gzipped_responses = 0;
+
+  void accept_loop();
+  void handle_connection(int fd);
+  void respond(int fd, int status, const string& body, const Faults& faults, bool gzip = false) const;
+
+  string route(const string& method, const string& target, const string& body, int& status);
+  string networks_body() const;
+  string plist_body(const string& network_list) const;
+  string catalog_body(const string& since) const;
+
+  static Catalog parse_catalog(const string& json);
+  static string serialize_catalog(const Catalog& catalog);
+
+ public:
+  /// The catalog served by default, keyed by network name
+  static const char* default_data;
+
+  /// Create a server for the catalog [data] (a JSON object of network name to a list of IDs)
+  explicit MockServer(const string& data = default_data);
+  ~MockServer();
+
+  MockServer(const MockServer&) = delete;
+  MockServer& operator=(const MockServer&) = delete;
+
+  /// Bind to an ephemeral port (or [port]) and start serving in the background
+  void start(uint16_t port = 0);
+
+  /// Stop serving: the clients still connected are disconnected, and the requests in flight completed
+  void stop();
+
+  /// The bound port. Valid after `start()`
+  [[nodiscard]] uint16_t port() const { return _port; }
+
+  /// `host:port` of the server
+  [[nodiscard]] string address() const;
+
+  /// `http://host:port` of the server
+  [[nodiscard]] string url() const { return "http://" + address(); }
+
+  /// Replace the served catalog with [data] (a JSON object of network name to a list of IDs)
+  void set_data(const string& data);
+
+  /// Get the served catalog as JSON
+  [[nodiscard]] string get_data() const;
+
+  /// The version of the served catalog, 1 until the first `set_data`
+  [[nodiscard]] uint64_t version() const;
+
+  /// Replace the injected faults
+  void set_faults(const Faults& faults);
+
+  /// Number of requests served for [endpoint] (e.g. `/plist`), or for all endpoints when empty
+  [[nodiscard]] size_t requests(const string& endpoint = "") const;
+
+  /// Number of responses sent gzipped
+  [[nodiscard]] size_t gzipped_responses() const;
+
+  /// Reset the request counters
+  void reset_requests();
+};
+
+}  // namespace fyber::test
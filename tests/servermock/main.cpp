@@ -0,0 +1,28 @@
+#include <csignal>
+#include <iostream>
+#include <string>
+
+#include "MockServer.h"
+
+/// Run the mock server standalone, for manual testing against a running `skad_updater`.
+/// \code skad_mock_server [port]
+int main(int argc, char** argv)
+{
+  static fyber::test::MockServer server;
+
+  // Blocked before the server threads are started, which inherit the mask: the signals then only reach `sigwait`
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  server.start(argc > 1 ? static_cast<uint16_t>(std::stoi(argv[1])) : 5000);
+  std::cout << "Mock server listening on " << server.url() << std::endl;
+
+  int signal = 0;
+  sigwait(&signals, &signal);
+
+  server.stop();
+  return 0;
+}
@@ -0,0 +1,37 @@
+#include <set>
+#include <string>
+
+#include "Symbol.h"
+#include "gtest/gtest.h"
+
+namespace fyber::test {
+
+TEST(Symbol, EqualStringsShareASingleEntry)
+{
+  std::string text = "AdColony";
+  Symbol a(text);
+  Symbol b("AdColony");
+
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(a.c_str(), b.c_str());
+  EXPECT_NE(a.c_str(), text.c_str());
+  EXPECT_EQ(a.view(), "AdColony");
+  EXPECT_NE(a, Symbol("ChartboostSDK"));
+
+  const size_t size = SymbolTable::global().size();
+  Symbol c(std::string("AdColony"));
+  EXPECT_EQ(SymbolTable::global().size(), size);
+}
+
+TEST(Symbol, EmptyAndOrdering)
+{
+  EXPECT_TRUE(Symbol().empty());
+  EXPECT_EQ(Symbol(""), Symbol());
+
+  std::set<Symbol> ordered = {Symbol("b.skadnetwork"), Symbol("a.skadnetwork"), Symbol("c.skadnetwork")};
+  std::string joined;
+  for (const auto& symbol : ordered) joined += symbol.view();
+  EXPECT_EQ(joined, "a.skadnetworkb.skadnetworkc.skadnetwork");
+}
+
+}  // namespace fyber::test